@@ -51,6 +51,7 @@
 
 #include "client.h"
 #include "cluster_client.h"
+#include "sharded_client.h"
 #include "config_types.h"
 
 
@@ -99,6 +100,12 @@ bool client::setup_client(benchmark_config *config, abstract_protocol *protocol,
 
         m_obj_gen->set_key_range(min, max);
     }
+    if (config->streams) {
+        char name[64];
+        snprintf(name, sizeof(name), "memtier-%d-%d", (int) getpid(), config->next_client_idx);
+        m_consumer_name = name;
+        m_ack_ids = new keylist(config->stream_count);
+    }
     config->next_client_idx++;
 
     m_keylist = new keylist(m_config->multi_key_get + 1);
@@ -123,7 +130,13 @@ client::client(client_group *group) :
         m_tot_set_ops(0),
         m_tot_wait_ops(0),
         m_scan_cursor("0"),
-        m_scan_iteration_count(0)
+        m_scan_iteration_count(0),
+        m_consumer(false),
+        m_channel_list(NULL),
+        m_ack_ids(NULL),
+        m_overhead(group->get_thread_overhead()),
+        m_group(group),
+        m_connect_tracked(false)
 {
     m_event_base = group->get_event_base();
 
@@ -153,7 +166,13 @@ client::client(struct event_base *event_base, benchmark_config *config, abstract
         m_tot_wait_ops(0),
         m_scan_cursor("0"),
         m_scan_iteration_count(0),
-        m_keylist(NULL)
+        m_keylist(NULL),
+        m_consumer(false),
+        m_channel_list(NULL),
+        m_ack_ids(NULL),
+        m_overhead(NULL),
+        m_group(NULL),
+        m_connect_tracked(false)
 {
     m_event_base = event_base;
 
@@ -182,6 +201,16 @@ client::~client()
         delete m_keylist;
         m_keylist = NULL;
     }
+
+    if (m_channel_list != NULL) {
+        delete m_channel_list;
+        m_channel_list = NULL;
+    }
+
+    if (m_ack_ids != NULL) {
+        delete m_ack_ids;
+        m_ack_ids = NULL;
+    }
 }
 
 bool client::initialized(void)
@@ -209,16 +238,22 @@ void client::disconnect_all(void)
 
 int client::connect(void)
 {
-    struct connect_info addr;
-
     // get primary connection
     shard_connection *sc = MAIN_CONNECTION;
     assert(sc != NULL);
 
+    return connect_conn(sc, m_config->server_addr, m_config->port);
+}
+
+// Connects a connection to a server, or to the UNIX domain socket
+int client::connect_conn(shard_connection *sc, struct server_addr *server, unsigned int port)
+{
+    struct connect_info addr;
+
     // get address information
     if (m_config->unix_socket == NULL) {
-        if (m_config->server_addr->get_connect_info(&addr) != 0) {
-            benchmark_error_log("connect: resolve error: %s\n", m_config->server_addr->get_last_error());
+        if (server->get_connect_info(&addr) != 0) {
+            benchmark_error_log("connect: resolve error: %s\n", server->get_last_error());
             return -1;
         }
 
@@ -233,7 +268,7 @@ int client::connect(void)
         }
 
         char port_str[20];
-        snprintf(port_str, sizeof(port_str) - 1, "%u", m_config->port);
+        snprintf(port_str, sizeof(port_str) - 1, "%u", port);
 
         // save address and port
         sc->set_address_port(address, port_str);
@@ -246,8 +281,36 @@ int client::connect(void)
     return 0;
 }
 
+void client::handle_connect_result(unsigned int conn_id, bool connected, unsigned long long connect_usec)
+{
+    if (connected) {
+        m_stats.update_connect_time(connect_usec);
+    }
+
+    // only the main connection's first attempt counts towards the group's bring-up
+    if (conn_id == 0 && m_connect_tracked) {
+        m_connect_tracked = false;
+        m_group->handle_client_connect_result(connected);
+    }
+}
+
+shared_socket *client::get_shared_socket(const char *server_id)
+{
+    return m_group != NULL ? m_group->get_shared_socket(server_id, this) : NULL;
+}
+
+#ifdef USE_TLS
+tls_session_cache *client::get_tls_session_cache(void)
+{
+    return m_group != NULL ? m_group->get_tls_session_cache() : NULL;
+}
+#endif
+
 bool client::finished(void)
 {
+    // consumers are stopped by the group once producing is over
+    if (m_consumer) return m_end_set;
+
     if (m_config->requests > 0 && m_reqs_processed >= m_config->requests) return true;
     if (m_config->test_time > 0) {
         if (m_config->clients_start > 0) {
@@ -295,13 +358,21 @@ void client::set_end_time()
 
         m_stats.set_end_time(NULL);
         m_end_set = true;
+
+        if (m_consumer) {
+            if (m_config->pubsub_channels) m_stats.update_pubsub_subscriber_done();
+        } else if ((m_config->pubsub_channels || m_config->streams || m_config->queues) && m_group != NULL) {
+            m_group->handle_producer_finished();
+        }
     }
 }
 
 bool client::hold_pipeline(unsigned int conn_id)
 {
-    // don't exceed requests
-    if (m_config->requests) {
+    if (stream_consumer_idle(conn_id)) return true;
+
+    // don't exceed requests, consumers read until the producers are done
+    if (m_config->requests && !m_consumer) {
         if (m_reqs_generated >= m_config->requests) return true;
     }
 
@@ -407,16 +478,20 @@ bool client::create_arbitrary_request(unsigned int command_index, struct timeval
         return true;
     }
 
-    // Normal arbitrary command handling
+    // Normal arbitrary command handling, all the commands of a compound request share one key
+    bool key_generated = false;
     for (unsigned int i = 0; i < cmd.command_args.size(); i++) {
         const command_arg *arg = &cmd.command_args[i];
         if (arg->type == const_type) {
             cmd_size += m_connections[conn_id]->send_arbitrary_command(arg);
         } else if (arg->type == key_type) {
-            unsigned long long key_index;
-            get_key_response res = get_key_for_conn(command_index, conn_id, &key_index);
-            /* If key not available for this connection, we have a bug of sending partial request */
-            assert(res == available_for_conn);
+            if (!key_generated || !cmd.is_compound()) {
+                unsigned long long key_index;
+                get_key_response res = get_key_for_conn(command_index, conn_id, &key_index);
+                /* If key not available for this connection, we have a bug of sending partial request */
+                assert(res == available_for_conn);
+                key_generated = true;
+            }
 
             // when we have static data mixed with the key placeholder
             if (arg->has_key_affixes) {
@@ -470,7 +545,7 @@ bool client::create_arbitrary_request(unsigned int command_index, struct timeval
         }
     }
 
-    m_connections[conn_id]->send_arbitrary_command_end(command_index, &timestamp, cmd_size);
+    m_connections[conn_id]->send_arbitrary_command_end(command_index, &timestamp, cmd_size, cmd.commands_count);
     return true;
 }
 
@@ -525,10 +600,42 @@ bool client::create_set_request(struct timeval &timestamp, unsigned int conn_id)
     get_key_response res = get_key_for_conn(SET_CMD_IDX, conn_id, &key_index);
     if (res == not_available) return false;
 
+    if (m_config->tracking_writes != NULL) m_config->tracking_writes->record(key_index, &timestamp);
+
     if (res == available_for_conn) {
         unsigned int value_len;
         const char *value = m_obj_gen->get_value(key_index, &value_len);
 
+        if (m_config->pubsub_channels) {
+            m_connections[conn_id]->send_publish_command(&timestamp, m_obj_gen->get_key(), m_obj_gen->get_key_len(),
+                                                         value, value_len);
+            return true;
+        }
+        if (m_config->streams) {
+            m_connections[conn_id]->send_xadd_command(&timestamp, m_obj_gen->get_key(), m_obj_gen->get_key_len(),
+                                                      value, value_len);
+            return true;
+        }
+        if (m_config->queues) {
+            m_connections[conn_id]->send_queue_push_command(&timestamp, m_obj_gen->get_key(),
+                                                            m_obj_gen->get_key_len(), value, value_len);
+            return true;
+        }
+        if (m_config->data_type != DATA_TYPE_STRING) {
+            if (m_config->data_type == DATA_TYPE_ZSET) {
+                m_scores.resize(m_config->data_fields);
+                for (unsigned int i = 0; i < m_config->data_fields; i++) {
+                    m_scores[i] = m_config->data_score_pattern[0] == 'R'
+                                      ? m_obj_gen->random_range(0, m_config->data_fields - 1)
+                                      : i;
+                }
+            }
+            m_connections[conn_id]->send_collection_write_command(&timestamp, m_obj_gen->get_key(),
+                                                                  m_obj_gen->get_key_len(), value, value_len,
+                                                                  m_scores.empty() ? NULL : &m_scores[0]);
+            return true;
+        }
+
         m_connections[conn_id]->send_set_command(&timestamp, m_obj_gen->get_key(), m_obj_gen->get_key_len(), value,
                                                  value_len, m_obj_gen->get_expiry(), m_config->data_offset);
     }
@@ -536,6 +643,68 @@ bool client::create_set_request(struct timeval &timestamp, unsigned int conn_id)
     return true;
 }
 
+// Subscribes a connection to every channel it serves: all of them, or in
+// cluster mode the channels whose slot the connection's shard owns.
+bool client::create_subscribe_request(struct timeval &timestamp, unsigned int conn_id)
+{
+    if (m_channel_list == NULL) {
+        m_channel_list = new keylist(m_config->pubsub_channels);
+    }
+
+    m_channel_list->clear();
+    for (unsigned long long i = m_config->key_minimum; i <= m_config->key_maximum; i++) {
+        m_obj_gen->generate_key(i);
+        if (is_key_for_conn(conn_id, m_obj_gen->get_key(), m_obj_gen->get_key_len())) {
+            m_channel_list->add_key(m_obj_gen->get_key(), m_obj_gen->get_key_len());
+        }
+    }
+
+    m_connections[conn_id]->send_subscribe_commands(m_channel_list);
+    return true;
+}
+
+// Creates the consumer group of every stream the connection serves, once.
+// Returns false while the XGROUP CREATE commands are still to be answered.
+bool client::setup_conn_streams(unsigned int conn_id)
+{
+    if (m_conn_streams.size() < m_connections.size()) m_conn_streams.resize(m_connections.size());
+
+    conn_streams &cs = m_conn_streams[conn_id];
+    if (cs.ready) return true;
+
+    cs.ready = true;
+    cs.next = 0;
+    cs.indexes.clear();
+    for (unsigned long long i = m_config->key_minimum; i <= m_config->key_maximum; i++) {
+        m_obj_gen->generate_key(i);
+        if (is_key_for_conn(conn_id, m_obj_gen->get_key(), m_obj_gen->get_key_len())) {
+            cs.indexes.push_back(i);
+            m_connections[conn_id]->send_xgroup_create_command(m_obj_gen->get_key(), m_obj_gen->get_key_len());
+        }
+    }
+
+    return cs.indexes.empty();
+}
+
+// a consumer connection that serves no stream has nothing to read
+bool client::stream_consumer_idle(unsigned int conn_id)
+{
+    return m_consumer && m_config->streams && conn_id < m_conn_streams.size() && m_conn_streams[conn_id].ready &&
+           m_conn_streams[conn_id].indexes.empty();
+}
+
+// Reads the next batch of one of the connection's streams, in turn
+bool client::create_stream_read_request(struct timeval &timestamp, unsigned int conn_id)
+{
+    conn_streams &cs = m_conn_streams[conn_id];
+    if (cs.indexes.empty()) return false;
+
+    m_obj_gen->generate_key(cs.indexes[cs.next++ % cs.indexes.size()]);
+    m_connections[conn_id]->send_xreadgroup_command(&timestamp, m_obj_gen->get_key(), m_obj_gen->get_key_len(),
+                                                    m_consumer_name.c_str());
+    return true;
+}
+
 bool client::create_get_request(struct timeval &timestamp, unsigned int conn_id)
 {
     unsigned long long key_index;
@@ -543,6 +712,20 @@ bool client::create_get_request(struct timeval &timestamp, unsigned int conn_id)
     if (res == not_available) return false;
 
     if (res == available_for_conn) {
+        // queue consumers pop from the queue instead
+        if (m_config->queues) {
+            m_connections[conn_id]->send_queue_pop_command(&timestamp, m_obj_gen->get_key(), m_obj_gen->get_key_len());
+            return true;
+        }
+        // a partial read covers a random window of the fields
+        if (m_config->data_type != DATA_TYPE_STRING) {
+            unsigned int count = m_config->data_read_fields;
+            unsigned int first = count ? m_obj_gen->random_range(0, m_config->data_fields - count) : 0;
+            m_connections[conn_id]->send_collection_read_command(&timestamp, m_obj_gen->get_key(),
+                                                                 m_obj_gen->get_key_len(), first, count);
+            return true;
+        }
+
         m_connections[conn_id]->send_get_command(&timestamp, m_obj_gen->get_key(), m_obj_gen->get_key_len(),
                                                  m_config->data_offset);
     }
@@ -558,9 +741,14 @@ bool client::create_mget_request(struct timeval &timestamp, unsigned int conn_id
 
     m_keylist->clear();
     for (unsigned int i = 0; i < keys_count; i++) {
-        get_key_response res = get_key_for_conn(GET_CMD_IDX, conn_id, &key_index);
-        /* Not supported in cluster mode */
-        assert(res == available_for_conn);
+        if (i > 0 && m_config->key_group_size) {
+            // the other keys come from the hash tag group of the first one
+            m_obj_gen->generate_key(m_obj_gen->get_group_key_index(key_index, i));
+        } else {
+            get_key_response res = get_key_for_conn(GET_CMD_IDX, conn_id, &key_index);
+            /* cluster_client splits the keys by slot itself */
+            assert(res == available_for_conn);
+        }
 
         m_keylist->add_key(m_obj_gen->get_key(), m_obj_gen->get_key_len());
     }
@@ -572,6 +760,19 @@ bool client::create_mget_request(struct timeval &timestamp, unsigned int conn_id
 // This function could use some urgent TLC -- but we need to do it without altering the behavior
 void client::create_request(struct timeval timestamp, unsigned int conn_id)
 {
+    if (m_config->streams && !setup_conn_streams(conn_id)) return;
+
+    if (m_consumer) {
+        if (m_config->pubsub_channels) {
+            create_subscribe_request(timestamp, conn_id);
+        } else if (m_config->queues) {
+            if (create_get_request(timestamp, conn_id)) m_reqs_generated++;
+        } else if (create_stream_read_request(timestamp, conn_id)) {
+            m_reqs_generated++;
+        }
+        return;
+    }
+
     // are we using arbitrary command?
     if (m_config->arbitrary_commands->is_defined()) {
         // SCAN incremental iteration mode: cursor state drives command selection
@@ -652,12 +853,178 @@ int client::prepare(void)
     return 0;
 }
 
+static bool push_kind_is(bulk_el *kind, const char *name)
+{
+    size_t len = strlen(name);
+    return kind->value_len == len && memcmp(kind->value, name, len) == 0;
+}
+
+// Handles out-of-band data: RESP3 pushes, and anything received by a
+// subscribed connection.  Tracking invalidations and pub/sub messages are
+// accounted, other frames such as subscribe confirmations are ignored.
+void client::handle_push(unsigned int conn_id, struct timeval timestamp, protocol_response *response)
+{
+    mbulk_size_el *push = response->get_mbulk_value();
+    if (push == NULL || push->mbulks_elements.empty() || push->mbulks_elements[0]->get_type() != mbulk_element_bulk) {
+        return;
+    }
+
+    bulk_el *kind = push->mbulks_elements[0]->as_bulk();
+    if (push_kind_is(kind, "invalidate") && push->mbulks_elements.size() == 2) {
+        handle_invalidation(timestamp, push->mbulks_elements[1]);
+    } else if ((push_kind_is(kind, "message") || push_kind_is(kind, "smessage")) &&
+               push->mbulks_elements.size() == 3) {
+        handle_pubsub_message(timestamp, push->mbulks_elements[2]);
+    } else {
+        benchmark_debug_log("server %s: ignoring push message.\n", m_connections[conn_id]->get_readable_id());
+    }
+}
+
+// keys is an array of invalidated keys, or null when the server flushed everything
+void client::handle_invalidation(struct timeval timestamp, mbulk_element *keys)
+{
+    if (keys->get_type() != mbulk_element_mbulk_size) {
+        m_stats.update_invalidation_flush();
+        return;
+    }
+
+    unsigned long long now_usec = (unsigned long long) timestamp.tv_sec * 1000000 + timestamp.tv_usec;
+    mbulk_size_el *keys_list = keys->as_mbulk_size();
+    for (unsigned int i = 0; i < keys_list->mbulks_elements.size(); i++) {
+        if (keys_list->mbulks_elements[i]->get_type() != mbulk_element_bulk) continue;
+
+        bulk_el *key = keys_list->mbulks_elements[i]->as_bulk();
+        unsigned long long write_usec =
+            m_config->tracking_writes != NULL ? m_config->tracking_writes->lookup(key->value, key->value_len) : 0;
+        m_stats.update_invalidation(write_usec > 0 && write_usec < now_usec ? now_usec - write_usec : 0);
+    }
+}
+
+// Returns the usec elapsed since a message was sent, see MESSAGE_TIMESTAMP_LEN,
+// or 0 when it carries no valid send time
+static unsigned long long message_latency_usec(struct timeval timestamp, const char *value, unsigned int value_len)
+{
+    unsigned long long sent_usec = 0;
+
+    if (value != NULL && value_len >= MESSAGE_TIMESTAMP_LEN) {
+        char hex[MESSAGE_TIMESTAMP_LEN + 1];
+        memcpy(hex, value, MESSAGE_TIMESTAMP_LEN);
+        hex[MESSAGE_TIMESTAMP_LEN] = '\0';
+        sent_usec = strtoull(hex, NULL, 16);
+    }
+
+    unsigned long long now_usec = (unsigned long long) timestamp.tv_sec * 1000000 + timestamp.tv_usec;
+    return sent_usec > 0 && sent_usec < now_usec ? now_usec - sent_usec : 0;
+}
+
+static unsigned long long message_latency_usec(struct timeval timestamp, mbulk_element *message)
+{
+    if (message->get_type() != mbulk_element_bulk) return 0;
+
+    bulk_el *payload = message->as_bulk();
+    return message_latency_usec(timestamp, payload->value, payload->value_len);
+}
+
+void client::handle_pubsub_message(struct timeval timestamp, mbulk_element *message)
+{
+    m_stats.update_pubsub_message(message_latency_usec(timestamp, message));
+}
+
+// An XREADGROUP reply holds a single stream: [[name, entries]] in RESP2 or
+// {name: entries} in RESP3, null when nothing was read.  Each entry is
+// [id, [field, value]]; the ids read are acknowledged right away.
+void client::handle_stream_entries(unsigned int conn_id, struct timeval timestamp, protocol_response *response)
+{
+    mbulk_size_el *reply = response->get_mbulk_value();
+    if (reply == NULL || reply->mbulks_elements.empty()) return;
+
+    // RESP2 wraps each [name, entries] pair in an array of its own
+    mbulk_size_el *stream = reply;
+    if (stream->mbulks_elements[0]->get_type() == mbulk_element_mbulk_size) {
+        stream = stream->mbulks_elements[0]->as_mbulk_size();
+    }
+    if (stream->mbulks_elements.size() != 2 || stream->mbulks_elements[0]->get_type() != mbulk_element_bulk ||
+        stream->mbulks_elements[1]->get_type() != mbulk_element_mbulk_size) {
+        return;
+    }
+
+    bulk_el *name = stream->mbulks_elements[0]->as_bulk();
+    mbulk_size_el *entries = stream->mbulks_elements[1]->as_mbulk_size();
+
+    m_ack_ids->clear();
+    for (unsigned int i = 0; i < entries->mbulks_elements.size(); i++) {
+        if (entries->mbulks_elements[i]->get_type() != mbulk_element_mbulk_size) continue;
+
+        mbulk_size_el *entry = entries->mbulks_elements[i]->as_mbulk_size();
+        if (entry->mbulks_elements.size() != 2 || entry->mbulks_elements[0]->get_type() != mbulk_element_bulk) {
+            continue;
+        }
+
+        bulk_el *id = entry->mbulks_elements[0]->as_bulk();
+        m_ack_ids->add_key(id->value, id->value_len);
+
+        // deleted entries come back with null fields
+        unsigned long long latency = 0;
+        if (entry->mbulks_elements[1]->get_type() == mbulk_element_mbulk_size) {
+            mbulk_size_el *fields = entry->mbulks_elements[1]->as_mbulk_size();
+            if (fields->mbulks_elements.size() == 2) {
+                latency = message_latency_usec(timestamp, fields->mbulks_elements[1]);
+            }
+        }
+        m_stats.update_stream_read(&timestamp, latency);
+    }
+
+    if (m_ack_ids->get_keys_count() > 0) {
+        m_connections[conn_id]->send_xack_command(&timestamp, name->value, name->value_len, m_ack_ids);
+    }
+}
+
+// A pop replies with [queue, message] for BRPOP and BLPOP, [queue, message,
+// score] for BZPOPMIN, the bare message for BLMOVE, and null when it timed
+// out.  A message moved by BLMOVE is acknowledged right away.  Returns true
+// if a message was popped.
+bool client::handle_queue_message(unsigned int conn_id, struct timeval timestamp, request *request,
+                                  protocol_response *response)
+{
+    const char *value = NULL;
+    unsigned int value_len = 0;
+
+    if (m_config->queue_pop == QUEUE_POP_BLMOVE) {
+        value = response->get_value(&value_len);
+    } else {
+        mbulk_size_el *reply = response->get_mbulk_value();
+        if (reply != NULL && reply->mbulks_elements.size() >= 2 &&
+            reply->mbulks_elements[1]->get_type() == mbulk_element_bulk) {
+            bulk_el *message = reply->mbulks_elements[1]->as_bulk();
+            value = message->value;
+            value_len = message->value_len;
+        }
+    }
+
+    if (value == NULL) {
+        m_stats.update_queue_timeout(&timestamp);
+        return false;
+    }
+
+    m_stats.update_queue_pop(&timestamp, message_latency_usec(timestamp, value, value_len),
+                             ts_diff(request->m_sent_time, timestamp));
+
+    if (m_config->queue_pop == QUEUE_POP_BLMOVE) {
+        queue_request *qr = static_cast<queue_request *>(request);
+        m_connections[conn_id]->send_queue_ack_command(&timestamp, qr->m_queue.c_str(), qr->m_queue.length(), value,
+                                                       value_len);
+    }
+
+    return true;
+}
+
 void client::handle_response(unsigned int conn_id, struct timeval timestamp, request *request,
                              protocol_response *response)
 {
     if (response->is_error()) {
         benchmark_error_log("server %s handle error response: %s\n", m_connections[conn_id]->get_readable_id(),
                             response->get_status());
+        m_stats.update_error_reply(&timestamp);
 
         // On SCAN error, reset cursor to restart iteration
         if (m_config->scan_incremental_iteration && request->m_type == rt_arbitrary) {
@@ -665,8 +1032,32 @@ void client::handle_response(unsigned int conn_id, struct timeval timestamp, req
             m_scan_iteration_count = 0;
         }
     }
+    if (m_config->first_byte_stats && timerisset(&request->m_first_byte_time)) {
+        // stream reads and queue pops are accounted as Gets
+        unsigned int first_byte = ts_diff(request->m_sent_time, request->m_first_byte_time);
+        if (request->m_type == rt_set) {
+            m_stats.update_set_first_byte(first_byte);
+        } else if (request->m_type == rt_get || request->m_type == rt_stream_read || request->m_type == rt_queue_pop) {
+            m_stats.update_get_first_byte(first_byte);
+        } else if (request->m_type == rt_arbitrary) {
+            m_stats.update_arbitrary_first_byte(first_byte, static_cast<arbitrary_request *>(request)->index);
+        }
+    }
+
     switch (request->m_type) {
     case rt_get:
+        if (m_config->data_type != DATA_TYPE_STRING) {
+            // every element is a bulk, HGETALL replies with field and value
+            unsigned int elements = response->get_hits();
+            if (m_config->data_type == DATA_TYPE_HASH && m_config->data_read_fields == 0) elements /= 2;
+            if (!response->is_error()) m_stats.update_collection_read(&timestamp, elements, response->get_total_len());
+
+            // a missing or empty object counts as a miss
+            m_stats.update_get_op(&timestamp, response->get_total_len(), request->m_size,
+                                  ts_diff(request->m_sent_time, timestamp), elements > 0 ? 1 : 0,
+                                  elements > 0 ? 0 : 1);
+            break;
+        }
         m_stats.update_get_op(&timestamp, response->get_total_len(), request->m_size,
                               ts_diff(request->m_sent_time, timestamp), response->get_hits(),
                               request->m_keys - response->get_hits());
@@ -674,13 +1065,61 @@ void client::handle_response(unsigned int conn_id, struct timeval timestamp, req
     case rt_set:
         m_stats.update_set_op(&timestamp, response->get_total_len(), request->m_size,
                               ts_diff(request->m_sent_time, timestamp));
+
+        // PUBLISH replies with the number of subscribers that received the message
+        if (m_config->pubsub_channels && !response->is_error()) {
+            const char *status = response->get_status();
+            m_stats.update_pubsub_publish(status != NULL && status[0] == ':' ? strtoull(status + 1, NULL, 10) : 0);
+        }
+        if (m_config->streams && !response->is_error()) m_stats.update_stream_add(&timestamp);
+
+        // LPUSH replies with the list length, ZADD with the number of members added
+        if (m_config->queues && !response->is_error()) {
+            unsigned long long pushed = 1;
+            if (m_config->queue_pop == QUEUE_POP_BZPOPMIN) {
+                const char *status = response->get_status();
+                pushed = status != NULL && status[0] == ':' ? strtoull(status + 1, NULL, 10) : 0;
+            }
+            m_stats.update_queue_push(&timestamp, pushed);
+        }
+        if (m_config->data_type != DATA_TYPE_STRING && !response->is_error()) {
+            m_stats.update_collection_write(&timestamp, m_config->data_fields);
+        }
+        break;
+    case rt_stream_read: {
+        unsigned long long read_before = m_stats.get_stream_read();
+        if (!response->is_error()) handle_stream_entries(conn_id, timestamp, response);
+        unsigned int entries = m_stats.get_stream_read() - read_before;
+
+        // an empty read counts as a single miss
+        m_stats.update_get_op(&timestamp, response->get_total_len(), request->m_size,
+                              ts_diff(request->m_sent_time, timestamp), entries, entries > 0 ? 0 : 1);
+        break;
+    }
+    case rt_queue_pop: {
+        bool popped = !response->is_error() && handle_queue_message(conn_id, timestamp, request, response);
+
+        // a pop that timed out counts as a miss
+        m_stats.update_get_op(&timestamp, response->get_total_len(), request->m_size,
+                              ts_diff(request->m_sent_time, timestamp), popped ? 1 : 0, popped ? 0 : 1);
+        break;
+    }
+    case rt_queue_ack:
+        break;
+    case rt_stream_ack:
+        // XACK replies with the number of entries acknowledged
+        if (!response->is_error()) {
+            const char *status = response->get_status();
+            m_stats.update_stream_ack(&timestamp, status != NULL && status[0] == ':' ? strtoull(status + 1, NULL, 10)
+                                                                                    : 0);
+        }
         break;
     case rt_wait:
         m_stats.update_wait_op(&timestamp, ts_diff(request->m_sent_time, timestamp));
         break;
     case rt_arbitrary: {
         arbitrary_request *ar = static_cast<arbitrary_request *>(request);
-        m_stats.update_arbitrary_op(&timestamp, response->get_total_len(), request->m_size,
+        m_stats.update_arbitrary_op(&timestamp, response->get_total_len() + ar->m_replies_len, request->m_size,
                                     ts_diff(request->m_sent_time, timestamp), ar->index);
 
         // Extract cursor from SCAN response for incremental iteration
@@ -819,6 +1258,13 @@ client_group::client_group(benchmark_config *config, abstract_protocol *protocol
         m_config(config),
         m_protocol(protocol),
         m_obj_gen(obj_gen),
+        m_overhead(config->thread_stats),
+        m_connect_target(0),
+        m_connect_next(0),
+        m_connects_in_flight(0),
+        m_clients_connected(0),
+        m_producers_running(0),
+        m_all_connected_usec(0),
         m_staircase_timer(NULL),
         m_staircase_active_clients(0)
 {
@@ -843,10 +1289,32 @@ client_group::~client_group(void)
     }
     m_clients.clear();
 
+    for (std::map<std::string, std::vector<shared_socket *> >::iterator i = m_shared_sockets.begin();
+         i != m_shared_sockets.end(); i++) {
+        for (size_t j = 0; j < i->second.size(); j++) {
+            delete i->second[j];
+        }
+    }
+    m_shared_sockets.clear();
+
     if (m_base != NULL) event_base_free(m_base);
     m_base = NULL;
 }
 
+// Client i uses the (i % shared_connections)th socket to every server
+shared_socket *client_group::get_shared_socket(const char *server_id, client *c)
+{
+    if (!m_config->shared_connections) return NULL;
+
+    std::vector<shared_socket *> &sockets = m_shared_sockets[server_id];
+    while (sockets.size() < m_config->shared_connections) {
+        sockets.push_back(new shared_socket(m_protocol));
+    }
+
+    size_t index = std::find(m_clients.begin(), m_clients.end(), c) - m_clients.begin();
+    return sockets[index % sockets.size()];
+}
+
 int client_group::create_clients(int num)
 {
     for (int i = 0; i < num; i++) {
@@ -854,6 +1322,8 @@ int client_group::create_clients(int num)
 
         if (m_config->cluster_mode)
             c = new cluster_client(this);
+        else if (m_config->servers_ring != NULL)
+            c = new sharded_client(this);
         else
             c = new client(this);
 
@@ -864,6 +1334,16 @@ int client_group::create_clients(int num)
             return i;
         }
 
+        if (m_config->pubsub_channels || m_config->streams || m_config->queues) {
+            unsigned int consumers =
+                m_config->pubsub_subscribers + m_config->stream_consumers + m_config->queue_consumers;
+            if (m_clients.size() < consumers) {
+                c->set_consumer(true);
+            } else {
+                m_producers_running++;
+            }
+        }
+
         m_clients.push_back(c);
 
         // Add jitter between connection creation (except for the last connection)
@@ -892,17 +1372,84 @@ int client_group::prepare_count(unsigned int count)
 {
     if (count > m_clients.size()) count = m_clients.size();
 
-    for (unsigned int i = 0; i < count; i++) {
-        int ret = m_clients[i]->prepare();
+    // issue the first wave now, the rest follow from the event loop as
+    // earlier connects complete
+    m_connect_target = count;
+    int ret = connect_pending_clients();
+    if (ret < 0) {
+        return ret;
+    }
+
+    m_staircase_active_clients.store(count, std::memory_order_release);
+    return 0;
+}
+
+int client_group::connect_pending_clients(void)
+{
+    while (m_connect_next < m_connect_target &&
+           (m_config->connect_wave_size == 0 || m_connects_in_flight < m_config->connect_wave_size)) {
+        client *c = m_clients[m_connect_next++];
+
+        c->set_connect_tracked(true);
+        m_connects_in_flight++;
+
+        int ret = c->prepare();
         if (ret < 0) {
+            c->set_connect_tracked(false);
+            m_connects_in_flight--;
             return ret;
         }
     }
 
-    m_staircase_active_clients.store(count, std::memory_order_release);
     return 0;
 }
 
+void client_group::handle_client_connect_result(bool connected)
+{
+    assert(m_connects_in_flight > 0);
+    m_connects_in_flight--;
+
+    if (connected && ++m_clients_connected == m_connect_target) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        m_all_connected_usec.store((unsigned long long) now.tv_sec * 1000000 + now.tv_usec,
+                                   std::memory_order_release);
+    }
+
+    while (connect_pending_clients() < 0) {
+        benchmark_error_log("failed to connect client %u, skipping it.\n", m_connect_next - 1);
+    }
+}
+
+void client_group::handle_producer_finished(void)
+{
+    assert(m_producers_running > 0);
+    if (--m_producers_running > 0) return;
+
+    // give messages already produced some time to be consumed
+    struct timeval drain = {0, CONSUMER_DRAIN_USEC};
+    event_base_once(m_base, -1, EV_TIMEOUT, consumer_drain_cb, (void *) this, &drain);
+}
+
+void client_group::consumer_drain_cb(evutil_socket_t fd, short what, void *arg)
+{
+    (void) fd;
+    (void) what;
+    client_group *cg = (client_group *) arg;
+    cg->finish_consumers();
+}
+
+void client_group::finish_consumers(void)
+{
+    for (std::vector<client *>::iterator i = m_clients.begin(); i != m_clients.end(); i++) {
+        client *c = *i;
+        if (!c->is_consumer()) continue;
+
+        c->set_end_time();
+        c->disconnect_all();
+    }
+}
+
 unsigned int client_group::active_client_count(void)
 {
     if (m_config->clients_start > 0) {
@@ -916,7 +1463,9 @@ void client_group::run(void)
     if (m_config->clients_start > 0) {
         setup_staircase_timer();
     }
+    m_overhead.start();
     event_base_dispatch(m_base);
+    m_overhead.sample_now();
 }
 
 void client_group::staircase_timer_cb(evutil_socket_t fd, short what, void *arg)
@@ -1082,6 +1631,16 @@ unsigned long int client_group::get_total_connection_errors(void)
     return total_errors;
 }
 
+bool client_group::all_clients_finished(void)
+{
+    unsigned int count = active_client_count();
+    for (unsigned int i = 0; i < count; i++) {
+        if (!m_clients[i]->finished()) return false;
+    }
+
+    return true;
+}
+
 void client_group::merge_run_stats(run_stats *target)
 {
     assert(target != NULL);
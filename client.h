@@ -26,6 +26,7 @@
 #include <sys/un.h>
 #include <vector>
 #include <queue>
+#include <map>
 #include <atomic>
 #include <iterator>
 #include <event2/event.h>
@@ -38,6 +39,8 @@
 #include "obj_gen.h"
 #include "memtier_benchmark.h"
 #include "run_stats.h"
+#include "thread_overhead.h"
+#include "tls_session_cache.h"
 
 #define MAIN_CONNECTION m_connections[0]
 
@@ -53,6 +56,10 @@ class object_generator;
 // Stack buffer size for key operations to avoid heap allocation
 #define KEY_BUFFER_STACK_SIZE 512
 
+// How long consumers (subscribers, stream consumers) keep receiving after
+// the last producer is done
+#define CONSUMER_DRAIN_USEC 200000
+
 enum get_key_response
 {
     not_available,
@@ -60,6 +67,10 @@ enum get_key_response
     available_for_other_conn
 };
 
+// (command index, key index) pairs generated by a connection for another one
+typedef std::queue<unsigned long long> key_index_pool;
+#define KEY_INDEX_QUEUE_MAX_SIZE 1000000
+
 class client : public connections_manager
 {
 protected:
@@ -90,6 +101,30 @@ protected:
 
     keylist *m_keylist; // used to construct multi commands
 
+    // pub/sub and streams modes: consumers only receive, all other clients produce
+    bool m_consumer;
+    keylist *m_channel_list; // channels a subscriber connection subscribes to
+
+    // streams mode: the streams each connection serves, whose groups it
+    // creates before its first request
+    struct conn_streams
+    {
+        bool ready;
+        unsigned int next;
+        std::vector<unsigned long long> indexes;
+        conn_streams() : ready(false), next(0) {}
+    };
+    std::vector<conn_streams> m_conn_streams;
+    std::string m_consumer_name;
+    keylist *m_ack_ids; // entry ids to acknowledge
+
+    std::vector<unsigned int> m_scores; // sorted set member scores of the next write
+
+    thread_overhead *m_overhead; // owned by the client group, NULL for standalone clients
+
+    client_group *m_group;   // NULL for standalone clients
+    bool m_connect_tracked;  // first connect outcome still owed to the group's bring-up
+
 public:
     client(client_group *group);
     client(struct event_base *event_base, benchmark_config *config, abstract_protocol *protocol,
@@ -109,6 +144,14 @@ public:
     virtual bool create_set_request(struct timeval &timestamp, unsigned int conn_id);
     virtual bool create_get_request(struct timeval &timestamp, unsigned int conn_id);
     virtual bool create_mget_request(struct timeval &timestamp, unsigned int conn_id);
+    virtual bool create_subscribe_request(struct timeval &timestamp, unsigned int conn_id);
+    virtual bool create_stream_read_request(struct timeval &timestamp, unsigned int conn_id);
+    bool setup_conn_streams(unsigned int conn_id);
+    bool stream_consumer_idle(unsigned int conn_id);
+    virtual bool is_key_for_conn(unsigned int conn_id, const char *key, unsigned int key_len) { return true; }
+
+    void set_consumer(bool consumer) { m_consumer = consumer; }
+    bool is_consumer(void) { return m_consumer; }
 
     // client manager api's
     unsigned long long get_reqs_processed() { return m_reqs_processed; }
@@ -123,6 +166,12 @@ public:
 
     virtual void handle_response(unsigned int conn_id, struct timeval timestamp, request *request,
                                  protocol_response *response);
+    virtual void handle_push(unsigned int conn_id, struct timeval timestamp, protocol_response *response);
+    void handle_invalidation(struct timeval timestamp, mbulk_element *keys);
+    void handle_pubsub_message(struct timeval timestamp, mbulk_element *message);
+    void handle_stream_entries(unsigned int conn_id, struct timeval timestamp, protocol_response *response);
+    bool handle_queue_message(unsigned int conn_id, struct timeval timestamp, request *request,
+                              protocol_response *response);
     virtual bool finished(void);
     virtual bool all_connections_idle(void);
     virtual void set_start_time();
@@ -130,10 +179,20 @@ public:
     virtual void create_request(struct timeval timestamp, unsigned int conn_id);
     virtual bool hold_pipeline(unsigned int conn_id);
     virtual int connect(void);
+    int connect_conn(shard_connection *sc, struct server_addr *server, unsigned int port);
     virtual void disconnect(void);
     virtual void disconnect_all(void);
+    virtual thread_overhead *get_thread_overhead(void) { return m_overhead; }
+    virtual shared_socket *get_shared_socket(const char *server_id);
+#ifdef USE_TLS
+    virtual tls_session_cache *get_tls_session_cache(void);
+#endif
+    virtual void handle_connect_result(unsigned int conn_id, bool connected, unsigned long long connect_usec);
+    virtual void handle_requests_lost(unsigned int conn_id) {}
     //
 
+    void set_connect_tracked(bool tracked) { m_connect_tracked = tracked; }
+
     /* Get current executed arbitrary command */
     const arbitrary_command &get_arbitrary_command(unsigned int command_index)
     {
@@ -230,6 +289,28 @@ protected:
     abstract_protocol *m_protocol;
     object_generator *m_obj_gen;
     std::vector<client *> m_clients;
+    thread_overhead m_overhead;
+#ifdef USE_TLS
+    tls_session_cache m_tls_sessions; // shared by all the thread's connections
+#endif
+
+    // --shared-connections: the sockets to every server the clients share
+    std::map<std::string, std::vector<shared_socket *> > m_shared_sockets;
+
+    // Connection bring-up: clients [0, m_connect_target) are connected in
+    // waves of at most connect_wave_size in-flight connects.
+    unsigned int m_connect_target;
+    unsigned int m_connect_next;
+    unsigned int m_connects_in_flight;
+    unsigned int m_clients_connected;
+
+    // pub/sub and streams modes: consumers keep draining for a while after
+    // the thread's last producer is done
+    unsigned int m_producers_running;
+    static void consumer_drain_cb(evutil_socket_t fd, short what, void *arg);
+    void finish_consumers(void);
+    std::atomic<unsigned long long> m_all_connected_usec; // wall clock, 0 until all are connected
+    int connect_pending_clients(void);
 
     // Client staircase ramp-up
     struct event *m_staircase_timer;
@@ -258,12 +339,25 @@ public:
     abstract_protocol *get_protocol(void) { return m_protocol; }
     object_generator *get_obj_gen(void) { return m_obj_gen; }
     std::vector<client *> &get_clients(void) { return m_clients; }
+    thread_overhead *get_thread_overhead(void) { return &m_overhead; }
+#ifdef USE_TLS
+    tls_session_cache *get_tls_session_cache(void) { return &m_tls_sessions; }
+#endif
+    shared_socket *get_shared_socket(const char *server_id, client *c);
+    void handle_client_connect_result(bool connected);
+    void handle_producer_finished(void);
+    unsigned long long get_all_connected_usec(void) const
+    {
+        return m_all_connected_usec.load(std::memory_order_acquire);
+    }
 
     unsigned long int get_total_bytes(void);
     unsigned long int get_total_ops(void);
     unsigned long int get_total_latency(void);
     unsigned long int get_duration_usec(void);
     unsigned long int get_total_connection_errors(void);
+    bool all_clients_finished(void);
+    thread_overhead_stats get_overhead_stats(unsigned int thread_id) { return m_overhead.get_stats(thread_id); }
 
     void merge_run_stats(run_stats *target);
     void aggregate_inst_histogram(hdr_histogram *target);
@@ -44,12 +44,15 @@
 #include <assert.h>
 #endif
 
+#include <algorithm>
+
 #include "cluster_client.h"
 #include "memtier_benchmark.h"
 #include "obj_gen.h"
 #include "shard_connection.h"
 
-#define KEY_INDEX_QUEUE_MAX_SIZE 1000000
+// keys drawn for a connection before handing one over to another
+#define SLOT_KEY_MAX_TRIES 1024
 
 #define MOVED_MSG_PREFIX "-MOVED"
 #define MOVED_MSG_PREFIX_LEN 6
@@ -78,24 +81,126 @@ static const uint16_t crc16tab[256] = {
     0x1ce0, 0x0cc1, 0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8, 0x6e17, 0x7e36, 0x4e55, 0x5e74,
     0x2e93, 0x3eb2, 0x0ed1, 0x1ef0};
 
+// crc16tab extended for slicing-by-8: crc16_slices[k][b] is the CRC of the
+// byte b followed by k zero bytes, so eight bytes are folded in at once
+static uint16_t crc16_slices[8][256];
+
+static struct crc16_slices_init
+{
+    crc16_slices_init()
+    {
+        for (unsigned int b = 0; b < 256; b++) {
+            crc16_slices[0][b] = crc16tab[b];
+            for (unsigned int k = 1; k < 8; k++) {
+                uint16_t prev = crc16_slices[k - 1][b];
+                crc16_slices[k][b] = (uint16_t) (prev << 8) ^ crc16tab[prev >> 8];
+            }
+        }
+    }
+} crc16_slices_init_instance;
+
 static inline uint16_t crc16(const char *buf, size_t len)
 {
-    size_t counter;
+    const unsigned char *p = (const unsigned char *) buf;
     uint16_t crc = 0;
-    for (counter = 0; counter < len; counter++)
-        crc = (crc << 8) ^ crc16tab[((crc >> 8) ^ *buf++) & 0x00FF];
+
+    for (; len >= 8; len -= 8, p += 8) {
+        crc = crc16_slices[7][(crc >> 8) ^ p[0]] ^ crc16_slices[6][(crc & 0xFF) ^ p[1]] ^ crc16_slices[5][p[2]] ^
+              crc16_slices[4][p[3]] ^ crc16_slices[3][p[4]] ^ crc16_slices[2][p[5]] ^ crc16_slices[1][p[6]] ^
+              crc16_slices[0][p[7]];
+    }
+    while (len--)
+        crc = (crc << 8) ^ crc16tab[((crc >> 8) ^ *p++) & 0x00FF];
     return crc;
 }
 
+// As the cluster does, only the part of the key between the first '{' and
+// the following '}' is hashed when it is not empty
 static uint32_t calc_hslot_crc16_cluster(const char *str, size_t length)
 {
+    const char *tag = (const char *) memchr(str, '{', length);
+    if (tag != NULL) {
+        size_t tag_len = length - (tag - str) - 1;
+        const char *tag_end = (const char *) memchr(tag + 1, '}', tag_len);
+        if (tag_end != NULL && tag_end > tag + 1) {
+            str = tag + 1;
+            length = tag_end - str;
+        }
+    }
+
     uint32_t rv = (uint32_t) crc16(str, length) & MAX_CLUSTER_HSLOT;
     return rv;
 }
 
+slot_key_map::slot_key_map(const key_template *key_names, unsigned long long key_minimum,
+                           unsigned long long key_maximum, bool key_lists) :
+        m_key_minimum(key_minimum), m_key_slots(key_maximum - key_minimum + 1), m_slot_start(MAX_CLUSTER_HSLOT + 2, 0)
+{
+    // keys are named as object_generator::generate_key() does; without hash
+    // tags the index is incremented in place
+    char name[250];
+    char index[32];
+    int name_len = key_names->format(name, sizeof(name), key_minimum);
+    std::string key(name, name_len);
+    size_t prefix_len = key.length() - snprintf(index, sizeof(index), "%llu", key_minimum);
+
+    for (size_t i = 0; i < m_key_slots.size(); i++) {
+        if (key_names->get_group_size()) {
+            name_len = key_names->format(name, sizeof(name), key_minimum + i);
+            key.assign(name, name_len);
+        }
+
+        unsigned int slot = calc_hslot_crc16_cluster(key.c_str(), key.length());
+        m_key_slots[i] = slot;
+        m_slot_start[slot + 1]++;
+
+        if (key_names->get_group_size()) continue;
+
+        size_t pos = key.length();
+        while (pos > prefix_len && key[pos - 1] == '9') key[--pos] = '0';
+        if (pos > prefix_len) {
+            key[pos - 1]++;
+        } else {
+            key[prefix_len] = '1';
+            key += '0';
+        }
+    }
+
+    for (unsigned int slot = 0; slot <= MAX_CLUSTER_HSLOT; slot++) {
+        m_slot_start[slot + 1] += m_slot_start[slot];
+    }
+    if (!key_lists) return;
+
+    // keys of a slot stay in ascending order
+    std::vector<unsigned int> next(m_slot_start.begin(), m_slot_start.end() - 1);
+    m_keys.resize(m_key_slots.size());
+    for (size_t i = 0; i < m_key_slots.size(); i++) {
+        m_keys[next[m_key_slots[i]]++] = i;
+    }
+}
+
+static void cluster_client_refresh_handler(evutil_socket_t fd, short what, void *ctx)
+{
+    cluster_client *c = (cluster_client *) ctx;
+    assert(c != NULL);
+    c->refresh_topology();
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 
-cluster_client::cluster_client(client_group *group) : client(group) {}
+cluster_client::cluster_client(client_group *group) :
+        client(group),
+        m_conn_slots_valid(false),
+        m_slot_keylist(NULL),
+        m_control_conn(NULL),
+        m_refresh_timer(NULL),
+        m_last_key_index(0)
+{
+    if (m_config->multi_key_get) {
+        m_slot_keylist = new keylist(m_config->multi_key_get + 1);
+        m_mget_slots.reserve(m_config->multi_key_get);
+    }
+}
 
 cluster_client::~cluster_client()
 {
@@ -104,10 +209,25 @@ cluster_client::~cluster_client()
         delete key_idx_pool;
     }
     m_key_index_pools.clear();
+
+    if (m_slot_keylist != NULL) {
+        delete m_slot_keylist;
+        m_slot_keylist = NULL;
+    }
+
+    if (m_refresh_timer != NULL) {
+        event_free(m_refresh_timer);
+        m_refresh_timer = NULL;
+    }
+
+    free_scatter_ops();
 }
 
 int cluster_client::connect(void)
 {
+    // a dropped connection reconnects to its own shard
+    if (!m_key_index_pools.empty()) return reconnect();
+
     // get main connection
     shard_connection *sc = MAIN_CONNECTION;
     assert(sc != NULL);
@@ -123,14 +243,51 @@ int cluster_client::connect(void)
     // continue with base class
     client::connect();
 
+    // periodic topology refresh, besides the one on MOVED
+    if (m_config->cluster_refresh_interval && m_refresh_timer == NULL) {
+        struct timeval interval = {(time_t) m_config->cluster_refresh_interval, 0};
+        m_refresh_timer = event_new(m_event_base, -1, EV_PERSIST, cluster_client_refresh_handler, (void *) this);
+        event_add(m_refresh_timer, &interval);
+    }
+
     return 0;
 }
 
+int cluster_client::reconnect(void)
+{
+    int ret = 0;
+
+    for (unsigned int i = 0; i < m_connections.size(); i++) {
+        shard_connection *sc = m_connections[i];
+        if (sc->get_connection_state() != conn_disconnected) continue;
+
+        if (sc == MAIN_CONNECTION) {
+            sc->set_cluster_slots();
+            if (client::connect() != 0) ret = -1;
+        } else {
+            // the connection keeps its address, which connecting replaces
+            std::string address(sc->get_address());
+            std::string port(sc->get_port());
+            if (!connect_shard_connection(sc, &address[0], &port[0])) ret = -1;
+        }
+    }
+
+    return ret;
+}
+
 void cluster_client::disconnect(void)
 {
     unsigned int conn_size = m_connections.size();
     unsigned int i;
 
+    if (m_refresh_timer != NULL) {
+        event_free(m_refresh_timer);
+        m_refresh_timer = NULL;
+    }
+
+    // the run is over, what is still in flight isn't accounted
+    free_scatter_ops();
+
     // disconnect all connections
     for (i = 0; i < m_connections.size(); i++) {
         shard_connection *sc = m_connections[i];
@@ -143,6 +300,23 @@ void cluster_client::disconnect(void)
         m_connections.pop_back();
         delete sc;
     }
+    m_control_conn = NULL;
+
+    // nothing is in flight anymore
+    m_inflight_keys.clear();
+    key_index_pool empty_queue;
+    std::swap(m_moved_keys, empty_queue);
+}
+
+void cluster_client::disconnect_all(void)
+{
+    // the timer would keep the thread's event loop running
+    if (m_refresh_timer != NULL) {
+        event_free(m_refresh_timer);
+        m_refresh_timer = NULL;
+    }
+
+    client::disconnect_all();
 }
 
 shard_connection *cluster_client::create_shard_connection(abstract_protocol *abs_protocol)
@@ -205,6 +379,54 @@ bool cluster_client::connect_shard_connection(shard_connection *sc, char *addres
     return res == 0;
 }
 
+// Returns the connection to a node of a CLUSTER SLOTS range, [address, port, ...],
+// creating it if needed.  close_sc marks the previous connections still in use.
+shard_connection *cluster_client::get_node_connection(mbulk_size_el *node, std::vector<bool> &close_sc)
+{
+    // hostname/ip
+    bulk_el *mbulk_addr_el = node->mbulks_elements[0]->as_bulk();
+    char *addr = (char *) malloc(mbulk_addr_el->value_len + 1);
+    memcpy(addr, mbulk_addr_el->value, mbulk_addr_el->value_len);
+    addr[mbulk_addr_el->value_len] = '\0';
+
+    // port
+    bulk_el *mbulk_port_el = node->mbulks_elements[1]->as_bulk();
+    char *port = (char *) malloc(mbulk_port_el->value_len + 1);
+    memcpy(port, mbulk_port_el->value + 1, mbulk_port_el->value_len);
+    port[mbulk_port_el->value_len] = '\0';
+
+    // check if connection already exist
+    shard_connection *sc = NULL;
+
+    for (unsigned int j = 0; j < m_connections.size(); j++) {
+        if (m_connections[j] == m_control_conn) continue;
+        if (strcmp(addr, m_connections[j]->get_address()) == 0 && strcmp(port, m_connections[j]->get_port()) == 0) {
+            sc = m_connections[j];
+
+            // mark not to close this connection
+            if (j < close_sc.size()) close_sc[j] = false;
+
+            // if connection disconnected, try to reconnect
+            if (sc->get_connection_state() == conn_disconnected) {
+                connect_shard_connection(sc, addr, port);
+            }
+
+            break;
+        }
+    }
+
+    // if connection doesn't exist, add it
+    if (sc == NULL) {
+        sc = create_shard_connection(MAIN_CONNECTION->get_protocol());
+        connect_shard_connection(sc, addr, port);
+    }
+
+    free(addr);
+    free(port);
+
+    return sc;
+}
+
 void cluster_client::handle_cluster_slots(protocol_response *r)
 {
     /*
@@ -214,6 +436,12 @@ void cluster_client::handle_cluster_slots(protocol_response *r)
     unsigned long prev_connections_size = m_connections.size();
     std::vector<bool> close_sc(prev_connections_size, true);
 
+    // the new mapping is built aside and swapped in at once
+    std::vector<slot_range> slot_ranges;
+    std::vector<unsigned int> slot_to_shard(m_slot_to_shard, m_slot_to_shard + MAX_CLUSTER_HSLOT + 1);
+    std::vector<unsigned short> slot_to_range(MAX_CLUSTER_HSLOT + 1, 0);
+    std::vector<bool> replica_conns(m_connections.size(), false);
+
     // run over response and create connections
     for (unsigned int i = 0; i < r->get_mbulk_value()->mbulks_elements.size(); i++) {
         // create connection
@@ -222,59 +450,311 @@ void cluster_client::handle_cluster_slots(protocol_response *r)
         int min_slot = strtol(shard->mbulks_elements[0]->as_bulk()->value + 1, NULL, 10);
         int max_slot = strtol(shard->mbulks_elements[1]->as_bulk()->value + 1, NULL, 10);
 
-        // hostname/ip
-        bulk_el *mbulk_addr_el = shard->mbulks_elements[2]->as_mbulk_size()->mbulks_elements[0]->as_bulk();
-        char *addr = (char *) malloc(mbulk_addr_el->value_len + 1);
-        memcpy(addr, mbulk_addr_el->value, mbulk_addr_el->value_len);
-        addr[mbulk_addr_el->value_len] = '\0';
-
-        // port
-        bulk_el *mbulk_port_el = shard->mbulks_elements[2]->as_mbulk_size()->mbulks_elements[1]->as_bulk();
-        char *port = (char *) malloc(mbulk_port_el->value_len + 1);
-        memcpy(port, mbulk_port_el->value + 1, mbulk_port_el->value_len);
-        port[mbulk_port_el->value_len] = '\0';
-
-        // check if connection already exist
-        shard_connection *sc = NULL;
-        unsigned int j;
-
-        for (j = 0; j < m_connections.size(); j++) {
-            if (strcmp(addr, m_connections[j]->get_address()) == 0 && strcmp(port, m_connections[j]->get_port()) == 0) {
-                sc = m_connections[j];
+        // the primary comes first, followed by its replicas
+        shard_connection *sc = get_node_connection(shard->mbulks_elements[2]->as_mbulk_size(), close_sc);
 
-                // mark not to close this connection
-                if (j < prev_connections_size) close_sc[j] = false;
-
-                // if connection disconnected, try to reconnect
-                if (sc->get_connection_state() == conn_disconnected) {
-                    connect_shard_connection(sc, addr, port);
-                }
-
-                break;
+        slot_range range;
+        range.primary = sc->get_id();
+        if (m_config->read_from != READ_FROM_PRIMARY) {
+            for (unsigned int k = 3; k < shard->mbulks_elements.size(); k++) {
+                shard_connection *replica = get_node_connection(shard->mbulks_elements[k]->as_mbulk_size(), close_sc);
+                range.replicas.push_back(replica->get_id());
             }
         }
 
-        // if connection doesn't exist, add it
-        if (sc == NULL) {
-            sc = create_shard_connection(MAIN_CONNECTION->get_protocol());
-            connect_shard_connection(sc, addr, port);
+        replica_conns.resize(m_connections.size(), false);
+        for (unsigned int k = 0; k < range.replicas.size(); k++) {
+            replica_conns[range.replicas[k]] = true;
         }
 
         // update range
         for (int j = min_slot; j <= max_slot; j++) {
-            m_slot_to_shard[j] = sc->get_id();
+            slot_to_shard[j] = sc->get_id();
+            slot_to_range[j] = slot_ranges.size();
         }
+        slot_ranges.push_back(range);
+    }
 
-        free(addr);
-        free(port);
+    // a slot served by another primary than before, for the availability timeline
+    if (!m_slot_ranges.empty() && !std::equal(slot_to_shard.begin(), slot_to_shard.end(), m_slot_to_shard)) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        m_stats.update_topology_change(&now);
     }
 
+    std::copy(slot_to_shard.begin(), slot_to_shard.end(), m_slot_to_shard);
+    std::copy(slot_to_range.begin(), slot_to_range.end(), m_slot_to_range);
+    m_slot_ranges.swap(slot_ranges);
+    m_replica_conns.swap(replica_conns);
+    m_conn_slots_valid = false;
+
     // check if some connections left with no slots, and need to be closed
     for (unsigned int i = 0; i < prev_connections_size; i++) {
+        if (m_connections[i] == m_control_conn) continue;
         if ((close_sc[i] == true) && (m_connections[i]->get_connection_state() != conn_disconnected)) {
             m_connections[i]->disconnect();
         }
     }
+
+    requeue_moved_keys();
+}
+
+// Hands the keys of the requests to send again to the connections now
+// owning their slots.
+void cluster_client::requeue_moved_keys(void)
+{
+    while (!m_moved_keys.empty()) {
+        unsigned int command_index = m_moved_keys.front();
+        m_moved_keys.pop();
+        unsigned long long key_index = m_moved_keys.front();
+        m_moved_keys.pop();
+
+        unsigned int hslot;
+        if (m_config->slot_keys != NULL && m_config->slot_keys->has_key(key_index)) {
+            hslot = m_config->slot_keys->get_slot(key_index);
+        } else {
+            m_obj_gen->generate_key(key_index);
+            hslot = calc_hslot_crc16_cluster(m_obj_gen->get_key(), m_obj_gen->get_key_len());
+        }
+
+        unsigned int conn_id = command_index == GET_CMD_IDX ? get_read_conn(hslot) : m_slot_to_shard[hslot];
+        m_key_index_pools[conn_id]->push(command_index);
+        m_key_index_pools[conn_id]->push(key_index);
+    }
+
+    for (unsigned int i = 0; i < m_connections.size(); i++) {
+        if (!m_key_index_pools[i]->empty() && m_connections[i]->get_pending_resp() == 0) {
+            m_connections[i]->wake_up();
+        }
+    }
+}
+
+// The connection refreshing the topology, created on first use towards
+// the configured server, so no connection carrying requests has to wait
+// for CLUSTER SLOTS.
+shard_connection *cluster_client::get_control_conn(void)
+{
+    if (m_control_conn == NULL) {
+        shard_connection *main_sc = MAIN_CONNECTION;
+        if (main_sc->get_address() == NULL || main_sc->get_port() == NULL) return NULL;
+
+        std::string address = main_sc->get_address();
+        std::string port = main_sc->get_port();
+
+        m_control_conn = create_shard_connection(main_sc->get_protocol());
+        connect_shard_connection(m_control_conn, &address[0], &port[0]);
+        m_control_conn->set_cluster_slots();
+    }
+
+    return m_control_conn;
+}
+
+// Sends CLUSTER SLOTS on the control connection, unless a refresh is
+// already pending.  Returns false if there is no control connection to
+// use, for the caller to refresh on its own connection.
+bool cluster_client::refresh_topology(void)
+{
+    shard_connection *sc = get_control_conn();
+    if (sc == NULL || sc->get_connection_state() == conn_disconnected) return false;
+
+    if (sc->get_cluster_slots_state() == setup_done) {
+        sc->set_cluster_slots();
+        sc->wake_up();
+    }
+
+    return true;
+}
+
+// The connection a Get of the slot goes to, as set by --read-from.  Sets go
+// to the primary, in m_slot_to_shard.
+unsigned int cluster_client::get_read_conn(unsigned int hslot)
+{
+    if (m_config->read_from == READ_FROM_PRIMARY || m_slot_ranges.empty()) return m_slot_to_shard[hslot];
+
+    slot_range &range = m_slot_ranges[m_slot_to_range[hslot]];
+    if (range.replicas.empty()) return range.primary;
+
+    unsigned int conn_id = range.primary;
+    switch (m_config->read_from) {
+    case READ_FROM_REPLICA:
+        conn_id = range.replicas[range.next++ % range.replicas.size()];
+        break;
+    case READ_FROM_ROUND_ROBIN: {
+        unsigned int i = range.next++ % (range.replicas.size() + 1);
+        conn_id = i == 0 ? range.primary : range.replicas[i - 1];
+        break;
+    }
+    case READ_FROM_NEAREST: {
+        // a node not measured yet (0) is tried first
+        double best = get_conn_latency(range.primary);
+        for (unsigned int i = 0; i < range.replicas.size() && best > 0; i++) {
+            double latency = get_conn_latency(range.replicas[i]);
+            if (latency < best) {
+                best = latency;
+                conn_id = range.replicas[i];
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    // a replica that went away leaves its reads to the primary
+    if (m_connections[conn_id]->get_connection_state() == conn_disconnected) return range.primary;
+
+    return conn_id;
+}
+
+// Whether the connection serves the slot's Sets, or its Gets as set by
+// --read-from.
+bool cluster_client::serves_slot(unsigned int conn_id, unsigned int hslot, bool read)
+{
+    if (!read || m_config->read_from == READ_FROM_PRIMARY || m_slot_ranges.empty()) {
+        return m_slot_to_shard[hslot] == conn_id;
+    }
+    if (m_config->read_from == READ_FROM_NEAREST) return get_read_conn(hslot) == conn_id;
+
+    const slot_range &range = m_slot_ranges[m_slot_to_range[hslot]];
+    if (range.primary == conn_id) return range.replicas.empty() || m_config->read_from == READ_FROM_ROUND_ROBIN;
+
+    return std::find(range.replicas.begin(), range.replicas.end(), conn_id) != range.replicas.end();
+}
+
+static void add_conn_slot(std::vector<unsigned short> &slots, std::vector<unsigned long long> &key_ends,
+                          unsigned int slot, unsigned int keys)
+{
+    key_ends.push_back((key_ends.empty() ? 0 : key_ends.back()) + keys);
+    slots.push_back(slot);
+}
+
+void cluster_client::build_conn_slots(void)
+{
+    m_write_slots.assign(m_connections.size(), conn_slots());
+    m_read_slots.assign(m_connections.size(), conn_slots());
+
+    for (unsigned int slot = 0; slot <= MAX_CLUSTER_HSLOT; slot++) {
+        unsigned int keys = m_config->slot_keys->get_slot_size(slot);
+        if (keys == 0) continue;
+
+        conn_slots &primary = m_write_slots[m_slot_to_shard[slot]];
+        add_conn_slot(primary.slots, primary.key_ends, slot, keys);
+
+        // any node of the range may be the nearest one
+        std::vector<unsigned int> readers;
+        if (m_config->read_from == READ_FROM_PRIMARY || m_slot_ranges.empty()) {
+            readers.push_back(m_slot_to_shard[slot]);
+        } else {
+            const slot_range &range = m_slot_ranges[m_slot_to_range[slot]];
+            if (range.replicas.empty() || m_config->read_from != READ_FROM_REPLICA) readers.push_back(range.primary);
+            readers.insert(readers.end(), range.replicas.begin(), range.replicas.end());
+        }
+        for (unsigned int i = 0; i < readers.size(); i++) {
+            conn_slots &reader = m_read_slots[readers[i]];
+            add_conn_slot(reader.slots, reader.key_ends, slot, keys);
+        }
+    }
+
+    m_conn_slots_valid = true;
+}
+
+cluster_client::seq_cursor &cluster_client::get_seq_cursor(unsigned int conn_id, int iter)
+{
+    if (m_seq_cursors.size() <= conn_id) m_seq_cursors.resize(m_connections.size());
+    std::vector<seq_cursor> &cursors = m_seq_cursors[conn_id];
+    if (cursors.size() <= (size_t) iter) cursors.resize(iter + 1);
+
+    return cursors[iter];
+}
+
+// The connection with keys left in the earliest pass, this one unless it
+// is ahead of another, so a pass writes every key once whatever the pace
+// of the connections.
+unsigned int cluster_client::get_lagging_conn(unsigned int conn_id, int iter, bool read)
+{
+    const std::vector<conn_slots> &all = read ? m_read_slots : m_write_slots;
+
+    unsigned int lagging = conn_id;
+    unsigned int pass = get_seq_cursor(conn_id, iter).pass;
+    for (unsigned int i = 0; i < all.size(); i++) {
+        if (!all[i].slots.empty() && get_seq_cursor(i, iter).pass < pass) {
+            lagging = i;
+            pass = get_seq_cursor(i, iter).pass;
+        }
+    }
+
+    return lagging;
+}
+
+// The slot of the key just generated, looked up when the key range is mapped
+unsigned int cluster_client::get_key_slot(unsigned long long key_index)
+{
+    if (m_config->slot_keys != NULL && m_config->slot_keys->has_key(key_index)) {
+        return m_config->slot_keys->get_slot(key_index);
+    }
+
+    return calc_hslot_crc16_cluster(m_obj_gen->get_key(), m_obj_gen->get_key_len());
+}
+
+// Draws a key of the slots the connection serves, keeping the key pattern:
+// random keys are picked among its own, gaussian and zipfian ones are drawn
+// until one is its own, and sequential ones continue from its last key,
+// or from the lagging connection's, to which that key is handed over.
+// Returns false if none was found, for the key to be handed over instead.
+bool cluster_client::draw_slot_key(int iter, unsigned int conn_id, bool read, unsigned long long *key_index)
+{
+    const slot_key_map *slot_keys = m_config->slot_keys;
+
+    if (!m_conn_slots_valid) build_conn_slots();
+    if (conn_id >= m_write_slots.size()) return false;
+
+    const conn_slots &own = read ? m_read_slots[conn_id] : m_write_slots[conn_id];
+    if (own.slots.empty()) return false;
+
+    unsigned long long key_min = m_obj_gen->get_key_min();
+    unsigned long long key_max = m_obj_gen->get_key_max();
+    if (!slot_keys->has_key(key_min) || !slot_keys->has_key(key_max)) return false;
+
+    // over the whole range, its keys are all known
+    if (iter == OBJECT_GENERATOR_KEY_RANDOM && key_min == slot_keys->get_key_minimum() &&
+        key_max == slot_keys->get_key_maximum()) {
+        unsigned long long pos = m_obj_gen->random_range(0, own.key_ends.back() - 1);
+        size_t i = std::upper_bound(own.key_ends.begin(), own.key_ends.end(), pos) - own.key_ends.begin();
+        *key_index = slot_keys->get_slot_key(own.slots[i], pos - (i > 0 ? own.key_ends[i - 1] : 0));
+        return true;
+    }
+
+    if (iter < 0) {
+        for (unsigned int tries = 0; tries < SLOT_KEY_MAX_TRIES; tries++) {
+            unsigned long long key = m_obj_gen->get_key_index(iter);
+            if (serves_slot(conn_id, slot_keys->get_slot(key), read)) {
+                *key_index = key;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    unsigned int seq_conn = get_lagging_conn(conn_id, iter, read);
+    for (unsigned int tries = 0; tries < SLOT_KEY_MAX_TRIES; tries++) {
+        seq_cursor &cursor = get_seq_cursor(seq_conn, iter);
+        if (cursor.next < key_min || cursor.next > key_max) cursor.next = key_min;
+
+        unsigned long long key = cursor.next++;
+        if (key == key_max) {
+            cursor.next = key_min;
+            cursor.pass++;
+        }
+
+        if (serves_slot(seq_conn, slot_keys->get_slot(key), read)) {
+            *key_index = key;
+            return true;
+        }
+
+        if (cursor.next == key_min) seq_conn = get_lagging_conn(conn_id, iter, read);
+    }
+
+    return false;
 }
 
 bool cluster_client::hold_pipeline(unsigned int conn_id)
@@ -283,8 +763,18 @@ bool cluster_client::hold_pipeline(unsigned int conn_id)
         return true;
     }
 
-    /* Don't exceed requests. */
-    if (m_config->requests) {
+    // the control connection carries CLUSTER SLOTS only
+    if (m_connections[conn_id] == m_control_conn) return true;
+
+    if (stream_consumer_idle(conn_id)) return true;
+
+    // multi-key gets scattered over the other shards count in the pipeline too
+    if (m_config->multi_key_get && conn_id < m_scatter_owned.size() &&
+        m_scatter_owned[conn_id] >= m_config->pipeline)
+        return true;
+
+    /* Don't exceed requests, consumers read until the producers are done. */
+    if (m_config->requests && !m_consumer) {
         if (m_key_index_pools[conn_id]->empty() && m_reqs_generated >= m_config->requests) {
             return true;
         }
@@ -302,23 +792,38 @@ get_key_response cluster_client::get_key_for_conn(unsigned int command_index, un
         m_obj_gen->generate_key(*key_index);
 
         m_key_index_pools[conn_id]->pop();
+        m_last_key_index = *key_index;
         return available_for_conn;
     }
 
-    // generate key
-    client::get_key_for_conn(command_index, conn_id, key_index);
+    // reads may go to a replica, unless the commands are arbitrary
+    bool read = command_index == GET_CMD_IDX && !m_config->arbitrary_commands->is_defined();
+
+    // generate key, from this connection's own slots when the key range is mapped
+    unsigned int hslot;
+    int iter = m_config->arbitrary_commands->is_defined() ? arbitrary_obj_iter_type(command_index)
+                                                          : obj_iter_type(m_config, command_index);
+    if (m_config->slot_keys != NULL && m_config->slot_keys->has_key_lists() &&
+        draw_slot_key(iter, conn_id, read, key_index)) {
+        m_obj_gen->generate_key(*key_index);
+    } else {
+        client::get_key_for_conn(command_index, conn_id, key_index);
+    }
+    hslot = get_key_slot(*key_index);
 
-    unsigned int hslot = calc_hslot_crc16_cluster(m_obj_gen->get_key(), m_obj_gen->get_key_len());
+    unsigned int target_conn_id = conn_id;
+    if (!serves_slot(conn_id, hslot, read)) target_conn_id = read ? get_read_conn(hslot) : m_slot_to_shard[hslot];
 
     // check if the key match for this connection
-    if (m_slot_to_shard[hslot] == conn_id) {
+    if (target_conn_id == conn_id) {
         benchmark_debug_log("%s generated key=[%.*s] for itself\n", m_connections[conn_id]->get_readable_id(),
                             m_obj_gen->get_key_len(), m_obj_gen->get_key());
+        m_last_key_index = *key_index;
         return available_for_conn;
     }
 
     // handle key for other connection
-    unsigned int other_conn_id = m_slot_to_shard[hslot];
+    unsigned int other_conn_id = target_conn_id;
 
     // in case we generated key for connection that is disconnected, 'slot to shard' map may need to be updated
     if (m_connections[other_conn_id]->get_connection_state() == conn_disconnected) {
@@ -372,8 +877,92 @@ bool cluster_client::create_arbitrary_request(unsigned int command_index, struct
     return true;
 }
 
+// Sharded channels and streams are served by the shard owning their slot
+bool cluster_client::is_key_for_conn(unsigned int conn_id, const char *key, unsigned int key_len)
+{
+    return m_slot_to_shard[calc_hslot_crc16_cluster(key, key_len)] == conn_id;
+}
+
+// A multi-key command must stay within one hash slot, so the batch is split
+// into one MGET per slot, each sent directly to the shard owning that slot.
+bool cluster_client::create_mget_request(struct timeval &timestamp, unsigned int conn_id)
+{
+    unsigned long long key_index;
+    unsigned long long group_key_index;
+    unsigned int keys_count = m_config->ratio.b - m_get_ratio_count;
+    if ((int) keys_count > m_config->multi_key_get) keys_count = m_config->multi_key_get;
+
+    m_keylist->clear();
+    m_mget_slots.clear();
+    m_scatter_conns.clear();
+    for (unsigned int i = 0; i < keys_count; i++) {
+        if (i > 0 && m_config->key_group_size) {
+            group_key_index = m_obj_gen->get_group_key_index(key_index, i);
+            m_obj_gen->generate_key(group_key_index);
+        } else {
+            client::get_key_for_conn(GET_CMD_IDX, conn_id, &key_index);
+            group_key_index = key_index;
+        }
+        m_keylist->add_key(m_obj_gen->get_key(), m_obj_gen->get_key_len());
+        m_mget_slots.push_back(std::make_pair(get_key_slot(group_key_index), i));
+    }
+    std::sort(m_mget_slots.begin(), m_mget_slots.end());
+
+    scatter_op *op = NULL;
+    size_t i = 0;
+    while (i < m_mget_slots.size()) {
+        unsigned int hslot = m_mget_slots[i].first;
+
+        m_slot_keylist->clear();
+        for (; i < m_mget_slots.size() && m_mget_slots[i].first == hslot; i++) {
+            const char *key;
+            unsigned int key_len;
+
+            key = m_keylist->get_key(m_mget_slots[i].second, &key_len);
+            m_slot_keylist->add_key(key, key_len);
+        }
+
+        unsigned int target_conn_id = get_read_conn(hslot);
+
+        // same as for single keys: a disconnected owner means the slots map may be stale
+        if (m_connections[target_conn_id]->get_connection_state() == conn_disconnected) {
+            m_connections[conn_id]->set_cluster_slots();
+            continue;
+        }
+        if (m_connections[target_conn_id]->get_cluster_slots_state() != setup_done) continue;
+
+        bool idle = m_connections[target_conn_id]->get_pending_resp() == 0;
+        m_connections[target_conn_id]->send_mget_command(&timestamp, m_slot_keylist);
+        if (idle && target_conn_id != conn_id) m_connections[target_conn_id]->resume_io();
+
+        if (op == NULL) {
+            op = new scatter_op();
+            op->owner = conn_id;
+            op->sent_time = timestamp;
+        }
+        if (target_conn_id >= m_scatter_parts.size()) m_scatter_parts.resize(m_connections.size());
+        m_scatter_parts[target_conn_id].push(std::make_pair(m_connections[target_conn_id]->get_last_request(), op));
+        op->parts_left++;
+        m_scatter_conns.push_back(target_conn_id);
+    }
+
+    if (op == NULL) return false;
+
+    std::sort(m_scatter_conns.begin(), m_scatter_conns.end());
+    op->width = std::unique(m_scatter_conns.begin(), m_scatter_conns.end()) - m_scatter_conns.begin();
+
+    if (conn_id >= m_scatter_owned.size()) m_scatter_owned.resize(m_connections.size(), 0);
+    m_scatter_owned[conn_id]++;
+
+    // the caller accounts for one request, whatever the number of parts
+    return true;
+}
+
 void cluster_client::create_request(struct timeval timestamp, unsigned int conn_id)
 {
+    /* Entries may be added to a stream only once its group exists. */
+    if (m_config->streams && !setup_conn_streams(conn_id)) return;
+
     /* If pool is empty continue with base class */
     if (m_key_index_pools[conn_id]->empty()) {
         client::create_request(timestamp, conn_id);
@@ -397,15 +986,90 @@ void cluster_client::create_request(struct timeval timestamp, unsigned int conn_
     assert(m_key_index_pools[conn_id]->size() == pool_size - 2);
 }
 
+bool cluster_client::create_set_request(struct timeval &timestamp, unsigned int conn_id)
+{
+    int pending = m_connections[conn_id]->get_pending_resp();
+    bool res = client::create_set_request(timestamp, conn_id);
+    track_request(conn_id, SET_CMD_IDX, pending);
+
+    return res;
+}
+
+bool cluster_client::create_get_request(struct timeval &timestamp, unsigned int conn_id)
+{
+    int pending = m_connections[conn_id]->get_pending_resp();
+    bool res = client::create_get_request(timestamp, conn_id);
+    track_request(conn_id, GET_CMD_IDX, pending);
+
+    return res;
+}
+
+// Remembers the key of a plain SET/GET just sent by the connection, to send
+// it again if it gets -MOVED.  Other request types are not retried.
+void cluster_client::track_request(unsigned int conn_id, unsigned int command_index, int pending_before)
+{
+    if (m_connections[conn_id]->get_pending_resp() != pending_before + 1) return;
+    if (m_config->data_type != DATA_TYPE_STRING || m_config->pubsub_channels || m_config->streams ||
+        m_config->queues || m_config->multi_key_get)
+        return;
+
+    if (conn_id >= m_inflight_keys.size()) m_inflight_keys.resize(m_connections.size());
+
+    inflight_key key = {m_connections[conn_id]->get_last_request(), command_index, m_last_key_index};
+    m_inflight_keys[conn_id].push(key);
+}
+
+// Pops the tracked key of the connection's oldest request, replies coming
+// back in order.  Returns false if the request was not tracked.
+bool cluster_client::pop_inflight_key(unsigned int conn_id, request *request, inflight_key *key)
+{
+    if (conn_id >= m_inflight_keys.size() || m_inflight_keys[conn_id].empty()) return false;
+    if (m_inflight_keys[conn_id].front().req != request) return false;
+
+    *key = m_inflight_keys[conn_id].front();
+    m_inflight_keys[conn_id].pop();
+    return true;
+}
+
+void cluster_client::handle_connect_result(unsigned int conn_id, bool connected, unsigned long long connect_usec)
+{
+    // requests in flight were lost with the previous connection, send them again
+    if (connected && conn_id < m_inflight_keys.size() && !m_inflight_keys[conn_id].empty()) {
+        while (!m_inflight_keys[conn_id].empty()) {
+            m_moved_keys.push(m_inflight_keys[conn_id].front().command_index);
+            m_moved_keys.push(m_inflight_keys[conn_id].front().key_index);
+            m_inflight_keys[conn_id].pop();
+            m_stats.update_request_retried();
+        }
+        requeue_moved_keys();
+    }
+
+    client::handle_connect_result(conn_id, connected, connect_usec);
+}
+
+shard_stats *cluster_client::get_shard_stats(unsigned int conn_id)
+{
+    if (conn_id >= m_shard_stats.size()) m_shard_stats.resize(m_connections.size(), NULL);
+    if (m_shard_stats[conn_id] == NULL) {
+        m_shard_stats[conn_id] = m_stats.get_shard_stats(m_connections[conn_id]->get_readable_id());
+    }
+    m_shard_stats[conn_id]->m_replica = conn_id < m_replica_conns.size() && m_replica_conns[conn_id];
+
+    return m_shard_stats[conn_id];
+}
+
 // In case of -MOVED response, we sends CLUSTER SLOTS command to get the new topology
 void cluster_client::handle_moved(unsigned int conn_id, struct timeval timestamp, request *request,
                                   protocol_response *response)
 {
+    get_shard_stats(conn_id)->update_moved_op(response->get_total_len() + request->m_size,
+                                              ts_diff(request->m_sent_time, timestamp));
+
     // update stats
-    if (request->m_type == rt_get) {
+    if (request->m_type == rt_get || request->m_type == rt_stream_read || request->m_type == rt_queue_pop) {
         m_stats.update_moved_get_op(&timestamp, response->get_total_len(), request->m_size,
                                     ts_diff(request->m_sent_time, timestamp));
-    } else if (request->m_type == rt_set) {
+    } else if (request->m_type == rt_set || request->m_type == rt_stream_ack || request->m_type == rt_queue_ack) {
         m_stats.update_moved_set_op(&timestamp, response->get_total_len(), request->m_size,
                                     ts_diff(request->m_sent_time, timestamp));
     } else if (request->m_type == rt_arbitrary) {
@@ -416,12 +1080,32 @@ void cluster_client::handle_moved(unsigned int conn_id, struct timeval timestamp
         assert(0);
     }
 
-    // connection already issued 'cluster slots' command, wait for slots mapping to be updated
-    if (m_connections[conn_id]->get_cluster_slots_state() != setup_done) return;
+    refresh_moved_slots(conn_id);
+}
 
-    // queue may stored uncorrected mapping indexes, empty them
+// Requests the topology again after a -MOVED reply on the connection
+void cluster_client::refresh_moved_slots(unsigned int conn_id)
+{
+    // queue may stored uncorrected mapping indexes, hand them over again
+    // once the slots mapping is updated
+    key_index_pool *key_idx_pool = m_key_index_pools[conn_id];
+    while (key_idx_pool->size() >= 2) {
+        m_moved_keys.push(key_idx_pool->front());
+        key_idx_pool->pop();
+        m_moved_keys.push(key_idx_pool->front());
+        key_idx_pool->pop();
+    }
     key_index_pool empty_queue;
-    std::swap(*m_key_index_pools[conn_id], empty_queue);
+    std::swap(*key_idx_pool, empty_queue);
+
+    // the streams are reassigned to the connections on their next request
+    m_conn_streams.clear();
+
+    // the control connection refreshes the topology, this one keeps sending
+    if (refresh_topology()) return;
+
+    // connection already issued 'cluster slots' command, wait for slots mapping to be updated
+    if (m_connections[conn_id]->get_cluster_slots_state() != setup_done) return;
 
     // set connection to send 'CLUSTER SLOTS' command
     m_connections[conn_id]->set_cluster_slots();
@@ -431,11 +1115,14 @@ void cluster_client::handle_moved(unsigned int conn_id, struct timeval timestamp
 void cluster_client::handle_ask(unsigned int conn_id, struct timeval timestamp, request *request,
                                 protocol_response *response)
 {
+    get_shard_stats(conn_id)->update_ask_op(response->get_total_len() + request->m_size,
+                                            ts_diff(request->m_sent_time, timestamp));
+
     // update stats
-    if (request->m_type == rt_get) {
+    if (request->m_type == rt_get || request->m_type == rt_stream_read || request->m_type == rt_queue_pop) {
         m_stats.update_ask_get_op(&timestamp, response->get_total_len(), request->m_size,
                                   ts_diff(request->m_sent_time, timestamp));
-    } else if (request->m_type == rt_set) {
+    } else if (request->m_type == rt_set || request->m_type == rt_stream_ack || request->m_type == rt_queue_ack) {
         m_stats.update_ask_set_op(&timestamp, response->get_total_len(), request->m_size,
                                   ts_diff(request->m_sent_time, timestamp));
     } else if (request->m_type == rt_arbitrary) {
@@ -447,15 +1134,155 @@ void cluster_client::handle_ask(unsigned int conn_id, struct timeval timestamp,
     }
 }
 
+// Accounts the reply to one part of a scattered multi-key get: to its shard
+// right away, and to the totals once the last part replied, with the
+// latency of the slowest part.
+void cluster_client::handle_scatter_part(unsigned int conn_id, struct timeval timestamp, request *request,
+                                         protocol_response *response, scatter_op *op)
+{
+    unsigned int latency = ts_diff(request->m_sent_time, timestamp);
+    unsigned int bytes = response->get_total_len() + request->m_size;
+    unsigned int hits = 0;
+
+    if (response->is_error() && strncmp(response->get_status(), MOVED_MSG_PREFIX, MOVED_MSG_PREFIX_LEN) == 0) {
+        get_shard_stats(conn_id)->update_moved_op(bytes, latency);
+        refresh_moved_slots(conn_id);
+        op->moved = true;
+    } else if (response->is_error() && strncmp(response->get_status(), ASK_MSG_PREFIX, ASK_MSG_PREFIX_LEN) == 0) {
+        get_shard_stats(conn_id)->update_ask_op(bytes, latency);
+        op->ask = true;
+    } else {
+        if (response->is_error()) {
+            benchmark_error_log("server %s handle error response: %s\n", m_connections[conn_id]->get_readable_id(),
+                                response->get_status());
+            m_stats.update_error_reply(&timestamp);
+        }
+        update_conn_latency(conn_id, latency);
+        hits = std::min(response->get_hits(), request->m_keys);
+        get_shard_stats(conn_id)->update_op(bytes, latency, hits, request->m_keys - hits);
+    }
+
+    op->keys += request->m_keys;
+    op->hits += hits;
+    op->bytes_rx += response->get_total_len();
+    op->bytes_tx += request->m_size;
+
+    // the request is processed once, with its last part
+    if (--op->parts_left > 0) {
+        m_reqs_processed--;
+        return;
+    }
+
+    // a request that lost a part is accounted as an error by end_scatter_op()
+    if (!op->failed) {
+        latency = ts_diff(op->sent_time, timestamp);
+        if (op->moved) {
+            m_stats.update_moved_get_op(&timestamp, op->bytes_rx, op->bytes_tx, latency);
+        } else if (op->ask) {
+            m_stats.update_ask_get_op(&timestamp, op->bytes_rx, op->bytes_tx, latency);
+        } else {
+            m_stats.update_get_op(&timestamp, op->bytes_rx, op->bytes_tx, latency, op->hits, op->keys - op->hits);
+        }
+        m_stats.update_fanout_op(op->width, op->keys, latency);
+    }
+
+    end_scatter_op(conn_id, timestamp, op);
+}
+
+// The request is done once its last part replied or was lost; a request that
+// lost a part counts as a failed one, whichever part it was.
+void cluster_client::end_scatter_op(unsigned int conn_id, struct timeval timestamp, scatter_op *op)
+{
+    unsigned int owner = op->owner;
+
+    if (op->failed) m_stats.update_error_reply(&timestamp);
+    m_scatter_owned[owner]--;
+    delete op;
+
+    // the connection may have stopped sending, waiting for its requests
+    if (owner != conn_id && m_connections[owner]->get_pending_resp() == 0) m_connections[owner]->wake_up();
+}
+
+// The parts sent on the connection won't get a reply, as it dropped or was
+// closed.  The requests they belong to fail, and are processed once their
+// last part is done, as if it replied.
+void cluster_client::clear_scatter_parts(unsigned int conn_id)
+{
+    if (conn_id >= m_scatter_parts.size()) return;
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    while (!m_scatter_parts[conn_id].empty()) {
+        scatter_op *op = m_scatter_parts[conn_id].front().second;
+        m_scatter_parts[conn_id].pop();
+
+        op->failed = true;
+        if (--op->parts_left > 0) continue;
+
+        m_reqs_processed++;
+        end_scatter_op(conn_id, now, op);
+    }
+}
+
+void cluster_client::free_scatter_ops(void)
+{
+    for (unsigned int i = 0; i < m_scatter_parts.size(); i++) {
+        while (!m_scatter_parts[i].empty()) {
+            scatter_op *op = m_scatter_parts[i].front().second;
+            m_scatter_parts[i].pop();
+            if (--op->parts_left == 0) {
+                m_scatter_owned[op->owner]--;
+                delete op;
+            }
+        }
+    }
+}
+
+void cluster_client::handle_requests_lost(unsigned int conn_id)
+{
+    clear_scatter_parts(conn_id);
+}
+
+void cluster_client::update_conn_latency(unsigned int conn_id, unsigned int latency)
+{
+    // smoothed reply latency of the connection, for READ_FROM_NEAREST
+    if (m_config->read_from != READ_FROM_NEAREST) return;
+
+    if (conn_id >= m_conn_latency.size()) m_conn_latency.resize(m_connections.size(), 0);
+    double &smoothed = m_conn_latency[conn_id];
+    smoothed = smoothed == 0 ? latency : 0.9 * smoothed + 0.1 * latency;
+}
+
 void cluster_client::handle_response(unsigned int conn_id, struct timeval timestamp, request *request,
                                      protocol_response *response)
 {
+    // a part of a multi-key get
+    if (conn_id < m_scatter_parts.size() && !m_scatter_parts[conn_id].empty() &&
+        m_scatter_parts[conn_id].front().first == request) {
+        scatter_op *op = m_scatter_parts[conn_id].front().second;
+        m_scatter_parts[conn_id].pop();
+        handle_scatter_part(conn_id, timestamp, request, response, op);
+        return;
+    }
+
+    inflight_key key;
+    bool tracked = pop_inflight_key(conn_id, request, &key);
+
     if (response->is_error()) {
         benchmark_debug_log("server %s handle response: %s\n", m_connections[conn_id]->get_readable_id(),
                             response->get_status());
         // handle "-MOVED"
         if (strncmp(response->get_status(), MOVED_MSG_PREFIX, MOVED_MSG_PREFIX_LEN) == 0) {
             handle_moved(conn_id, timestamp, request, response);
+
+            // sent again to the new owner, the request is not done yet
+            if (tracked) {
+                m_moved_keys.push(key.command_index);
+                m_moved_keys.push(key.key_index);
+                m_reqs_processed--;
+                m_stats.update_request_retried();
+            }
             return;
         }
 
@@ -466,6 +1293,21 @@ void cluster_client::handle_response(unsigned int conn_id, struct timeval timest
         }
     }
 
+    update_conn_latency(conn_id, ts_diff(request->m_sent_time, timestamp));
+
+    // the requests accounted in the ops, GET hits as in the totals
+    if (request->m_type == rt_get || request->m_type == rt_set || request->m_type == rt_arbitrary ||
+        request->m_type == rt_stream_read || request->m_type == rt_queue_pop) {
+        unsigned int hits = 0;
+        unsigned int misses = 0;
+        if (request->m_type == rt_get) {
+            hits = std::min(response->get_hits(), request->m_keys);
+            misses = request->m_keys - hits;
+        }
+        get_shard_stats(conn_id)->update_op(response->get_total_len() + request->m_size,
+                                            ts_diff(request->m_sent_time, timestamp), hits, misses);
+    }
+
     // continue with base class
     client::handle_response(conn_id, timestamp, request, response);
 }
@@ -20,26 +20,167 @@
 #define MEMTIER_BENCHMARK_CLUSTER_CLIENT_H
 
 #include <set>
+#include <utility>
 #include "client.h"
 
-typedef std::queue<unsigned long long> key_index_pool;
-
 // forward decleration
 class shard_connection;
 
+// The hash slot of every key of the configured range and, with key lists,
+// the key indexes of every slot, grouped by slot.  Built once and shared
+// read-only by all the threads.
+class slot_key_map
+{
+public:
+    slot_key_map(const key_template *key_names, unsigned long long key_minimum, unsigned long long key_maximum,
+                 bool key_lists);
+
+    unsigned long long get_key_minimum() const { return m_key_minimum; }
+    unsigned long long get_key_maximum() const { return m_key_minimum + m_key_slots.size() - 1; }
+    unsigned int get_slot(unsigned long long key_index) const { return m_key_slots[key_index - m_key_minimum]; }
+    unsigned int get_slots() const { return m_slot_start.size() - 1; }
+    unsigned int get_slot_size(unsigned int slot) const { return m_slot_start[slot + 1] - m_slot_start[slot]; }
+    unsigned long long get_slot_key(unsigned int slot, unsigned int i) const
+    {
+        return m_key_minimum + m_keys[m_slot_start[slot] + i];
+    }
+    bool has_key(unsigned long long key_index) const
+    {
+        return key_index >= m_key_minimum && key_index - m_key_minimum < m_key_slots.size();
+    }
+    bool has_key_lists() const { return !m_keys.empty(); }
+
+    // memory a key takes, with and without key lists
+    static const unsigned int key_lists_bytes = sizeof(unsigned short) + sizeof(unsigned int);
+    static const unsigned int key_slot_bytes = sizeof(unsigned short);
+
+protected:
+    unsigned long long m_key_minimum;
+    std::vector<unsigned short> m_key_slots; // slot of every key
+    std::vector<unsigned int> m_slot_start;  // first of the slot's keys in m_keys
+    std::vector<unsigned int> m_keys;        // keys, relative to m_key_minimum
+};
+
 class cluster_client : public client
 {
 protected:
     std::vector<key_index_pool *> m_key_index_pools;
     unsigned int m_slot_to_shard[16384];
 
+    // slot ranges of the last CLUSTER SLOTS reply, whose replicas serve
+    // reads with --read-from
+    struct slot_range
+    {
+        unsigned int primary;
+        std::vector<unsigned int> replicas;
+        unsigned int next; // round-robin position
+        slot_range() : primary(0), next(0) {}
+    };
+    std::vector<slot_range> m_slot_ranges;
+    unsigned short m_slot_to_range[16384];
+    std::vector<bool> m_replica_conns; // connections to a replica
+    std::vector<double> m_conn_latency; // smoothed reply latency (usec) of each connection
+
+    // the slots served by every connection, with the running count of
+    // their keys, for drawing keys from slot_key_map; rebuilt after
+    // CLUSTER SLOTS
+    struct conn_slots
+    {
+        std::vector<unsigned short> slots;
+        std::vector<unsigned long long> key_ends;
+    };
+    std::vector<conn_slots> m_write_slots;
+    std::vector<conn_slots> m_read_slots;
+    bool m_conn_slots_valid;
+    // every connection walks its own keys of each sequential iterator
+    struct seq_cursor
+    {
+        unsigned long long next;
+        unsigned int pass; // walks over the key range done
+        seq_cursor() : next(0), pass(0) {}
+    };
+    std::vector<std::vector<seq_cursor> > m_seq_cursors;
+
+    // multi-key get: (slot, key index) of every key in m_keylist, and the
+    // keys of the slot currently being sent
+    std::vector<std::pair<unsigned int, unsigned int> > m_mget_slots;
+    keylist *m_slot_keylist;
+
+    // a multi-key get scattered as one MGET per slot, done and accounted as
+    // a single request once every part replied; the parts waiting for a
+    // reply are queued per connection, in the order they were sent, and
+    // every connection keeps up to --pipeline requests of its own in flight
+    struct scatter_op
+    {
+        unsigned int owner; // connection that created it
+        struct timeval sent_time;
+        unsigned int parts_left;
+        unsigned int width; // nodes the parts went to
+        unsigned int keys;
+        unsigned int hits;
+        unsigned int bytes_rx;
+        unsigned int bytes_tx;
+        bool moved;
+        bool ask;
+        bool failed; // a part was lost with its connection
+    };
+    std::vector<std::queue<std::pair<request *, scatter_op *> > > m_scatter_parts;
+    std::vector<unsigned int> m_scatter_owned;
+    std::vector<unsigned int> m_scatter_conns;
+
+    // per shard stats of every connection, looked up on its first reply
+    std::vector<shard_stats *> m_shard_stats;
+
+    // topology refresh: CLUSTER SLOTS goes out on a connection of its own,
+    // so the data connections keep their pipelines meanwhile
+    shard_connection *m_control_conn;
+    struct event *m_refresh_timer;
+
+    // (command, key index) of the SET/GET requests still waiting for a
+    // reply, per connection, and of the ones to send again to their new
+    // owner after a MOVED reply or a reconnect
+    struct inflight_key
+    {
+        request *req;
+        unsigned int command_index;
+        unsigned long long key_index;
+    };
+    std::vector<std::queue<inflight_key> > m_inflight_keys;
+    key_index_pool m_moved_keys;
+    unsigned long long m_last_key_index; // key of the last get_key_for_conn()
+
     virtual int connect(void);
+    int reconnect(void);
     virtual void disconnect(void);
 
     shard_connection *create_shard_connection(abstract_protocol *abs_protocol);
     bool connect_shard_connection(shard_connection *sc, char *address, char *port);
+    shard_connection *get_node_connection(mbulk_size_el *node, std::vector<bool> &close_sc);
+    unsigned int get_read_conn(unsigned int hslot);
+    bool serves_slot(unsigned int conn_id, unsigned int hslot, bool read);
+    void build_conn_slots(void);
+    seq_cursor &get_seq_cursor(unsigned int conn_id, int iter);
+    unsigned int get_lagging_conn(unsigned int conn_id, int iter, bool read);
+    bool draw_slot_key(int iter, unsigned int conn_id, bool read, unsigned long long *key_index);
+    unsigned int get_key_slot(unsigned long long key_index);
+    double get_conn_latency(unsigned int conn_id)
+    {
+        return conn_id < m_conn_latency.size() ? m_conn_latency[conn_id] : 0;
+    }
     void handle_moved(unsigned int conn_id, struct timeval timestamp, request *request, protocol_response *response);
+    void refresh_moved_slots(unsigned int conn_id);
+    void handle_scatter_part(unsigned int conn_id, struct timeval timestamp, request *request,
+                             protocol_response *response, scatter_op *op);
+    void clear_scatter_parts(unsigned int conn_id);
+    void free_scatter_ops(void);
+    void end_scatter_op(unsigned int conn_id, struct timeval timestamp, scatter_op *op);
+    void update_conn_latency(unsigned int conn_id, unsigned int latency);
     void handle_ask(unsigned int conn_id, struct timeval timestamp, request *request, protocol_response *response);
+    shard_stats *get_shard_stats(unsigned int conn_id);
+    shard_connection *get_control_conn(void);
+    void requeue_moved_keys(void);
+    void track_request(unsigned int conn_id, unsigned int command_index, int pending_before);
+    bool pop_inflight_key(unsigned int conn_id, request *request, inflight_key *key);
 
 public:
     cluster_client(client_group *group);
@@ -48,9 +189,17 @@ public:
     virtual get_key_response get_key_for_conn(unsigned int command_index, unsigned int conn_id,
                                               unsigned long long *key_index);
     virtual bool create_arbitrary_request(unsigned int command_index, struct timeval &timestamp, unsigned int conn_id);
+    virtual bool create_mget_request(struct timeval &timestamp, unsigned int conn_id);
+    virtual bool create_set_request(struct timeval &timestamp, unsigned int conn_id);
+    virtual bool create_get_request(struct timeval &timestamp, unsigned int conn_id);
+    virtual bool is_key_for_conn(unsigned int conn_id, const char *key, unsigned int key_len);
 
     // client manager api's
     virtual void handle_cluster_slots(protocol_response *r);
+    virtual void handle_connect_result(unsigned int conn_id, bool connected, unsigned long long connect_usec);
+    virtual void handle_requests_lost(unsigned int conn_id);
+    virtual void disconnect_all(void);
+    bool refresh_topology(void);
     virtual void create_request(struct timeval timestamp, unsigned int conn_id);
     virtual bool hold_pipeline(unsigned int conn_id);
     virtual void handle_response(unsigned int conn_id, struct timeval timestamp, request *request,
@@ -33,6 +33,8 @@
 #include <sys/socket.h>
 #endif
 #include <netdb.h>
+#include <ifaddrs.h>
+#include <arpa/inet.h>
 
 #include <string>
 #include <iostream>
@@ -212,12 +214,13 @@ const char *config_weight_list::print(char *buf, int buf_len)
 }
 
 
-server_addr::server_addr(const char *hostname, int port, int resolution) :
+server_addr::server_addr(const char *hostname, int port, int resolution, bool resolve_on_connect) :
         m_hostname(hostname),
         m_port(port),
         m_server_addr(NULL),
         m_used_addr(NULL),
         m_resolution(resolution),
+        m_resolve_on_connect(resolve_on_connect),
         m_last_error(0)
 {
     int error = resolve();
@@ -256,7 +259,11 @@ int server_addr::get_connect_info(struct connect_info *ci)
 {
     pthread_mutex_lock(&m_mutex);
     if (m_used_addr) m_used_addr = m_used_addr->ai_next;
-    if (!m_used_addr) {
+    if (!m_used_addr && m_server_addr && !m_resolve_on_connect) {
+        // addresses resolved once up front are reused round-robin, so
+        // bringing up many connections costs no further lookups
+        m_used_addr = m_server_addr;
+    } else if (!m_used_addr) {
         if (m_server_addr) {
             freeaddrinfo(m_server_addr);
             m_server_addr = NULL;
@@ -286,6 +293,165 @@ const char *server_addr::get_last_error(void) const
     return gai_strerror(m_last_error);
 }
 
+source_addr_pool::source_addr_pool(const char *list) : m_next(0)
+{
+    std::string str(list);
+    size_t pos = 0;
+
+    while (pos <= str.length()) {
+        size_t end = str.find(',', pos);
+        if (end == std::string::npos) end = str.length();
+
+        std::string name = str.substr(pos, end - pos);
+        if (name.empty()) throw std::runtime_error("empty source address");
+        add_address(name.c_str());
+
+        pos = end + 1;
+    }
+}
+
+void source_addr_pool::add_address(const char *name)
+{
+    struct sockaddr_storage addr;
+
+    memset(&addr, 0, sizeof(addr));
+    struct sockaddr_in *sin = (struct sockaddr_in *) &addr;
+    struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &addr;
+    if (inet_pton(AF_INET, name, &sin->sin_addr) == 1) {
+        sin->sin_family = AF_INET;
+        m_addrs.push_back(addr);
+        return;
+    }
+    if (inet_pton(AF_INET6, name, &sin6->sin6_addr) == 1) {
+        sin6->sin6_family = AF_INET6;
+        m_addrs.push_back(addr);
+        return;
+    }
+
+    // not an address, so take all addresses of the interface by that name
+    struct ifaddrs *ifaddr;
+    if (getifaddrs(&ifaddr) != 0) throw std::runtime_error(std::string("getifaddrs: ") + strerror(errno));
+
+    bool found = false;
+    for (struct ifaddrs *ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr == NULL || strcmp(ifa->ifa_name, name) != 0) continue;
+        if (ifa->ifa_addr->sa_family == AF_INET) {
+            memset(&addr, 0, sizeof(addr));
+            memcpy(&addr, ifa->ifa_addr, sizeof(struct sockaddr_in));
+        } else if (ifa->ifa_addr->sa_family == AF_INET6) {
+            memset(&addr, 0, sizeof(addr));
+            memcpy(&addr, ifa->ifa_addr, sizeof(struct sockaddr_in6));
+        } else {
+            continue;
+        }
+        m_addrs.push_back(addr);
+        found = true;
+    }
+    freeifaddrs(ifaddr);
+
+    if (!found) throw std::runtime_error(std::string("not an address or interface with an address: ") + name);
+}
+
+// Picks the next address of the requested family, shared by all threads.
+bool source_addr_pool::get_next(int family, struct sockaddr_storage *addr, socklen_t *addrlen)
+{
+    for (size_t i = 0; i < m_addrs.size(); i++) {
+        const struct sockaddr_storage &a = m_addrs[m_next.fetch_add(1, std::memory_order_relaxed) % m_addrs.size()];
+        if (a.ss_family != family) continue;
+
+        *addr = a;
+        *addrlen = family == AF_INET ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
+        return true;
+    }
+
+    return false;
+}
+
+#define KEY_TAG_SEGMENT "{tag}"
+
+key_template::key_template(const char *key_prefix, unsigned int group_size) :
+        m_head(key_prefix ? key_prefix : ""), m_group_size(group_size)
+{
+    if (!m_group_size) return;
+
+    size_t pos = m_head.find(KEY_TAG_SEGMENT);
+    if (pos != std::string::npos) {
+        m_tail = m_head.substr(pos + strlen(KEY_TAG_SEGMENT));
+        m_head.erase(pos);
+    }
+}
+
+int key_template::format(char *buf, size_t size, unsigned long long key_index) const
+{
+    if (!m_group_size) return snprintf(buf, size, "%s%llu", m_head.c_str(), key_index);
+
+    return snprintf(buf, size, "%s{%llu}%s%llu", m_head.c_str(), key_index / m_group_size, m_tail.c_str(),
+                    key_index);
+}
+
+// parses the digits at *pos, advancing it past them
+static bool parse_key_number(const char *key, unsigned int key_len, unsigned int *pos, unsigned long long *number)
+{
+    unsigned int start = *pos;
+
+    *number = 0;
+    for (; *pos < key_len && key[*pos] >= '0' && key[*pos] <= '9'; (*pos)++) {
+        *number = *number * 10 + (key[*pos] - '0');
+    }
+    return *pos > start;
+}
+
+bool key_template::parse(const char *key, unsigned int key_len, unsigned long long *key_index) const
+{
+    if (key_len < m_head.length() || memcmp(key, m_head.c_str(), m_head.length()) != 0) return false;
+
+    unsigned int pos = m_head.length();
+    if (m_group_size) {
+        unsigned long long tag;
+        if (pos >= key_len || key[pos++] != '{') return false;
+        if (!parse_key_number(key, key_len, &pos, &tag)) return false;
+        if (pos >= key_len || key[pos++] != '}') return false;
+        if (key_len - pos < m_tail.length() || memcmp(key + pos, m_tail.c_str(), m_tail.length()) != 0) {
+            return false;
+        }
+        pos += m_tail.length();
+    }
+
+    return parse_key_number(key, key_len, &pos, key_index) && pos == key_len;
+}
+
+key_write_times::key_write_times(const key_template *key_names, unsigned long long key_minimum,
+                                 unsigned long long key_maximum) :
+        m_key_names(key_names), m_key_minimum(key_minimum)
+{
+    m_slots_count = key_maximum - key_minimum + 1;
+    if (m_slots_count > max_slots) m_slots_count = max_slots;
+
+    m_slots = new std::atomic<unsigned long long>[m_slots_count];
+    for (unsigned long long i = 0; i < m_slots_count; i++) {
+        m_slots[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+key_write_times::~key_write_times()
+{
+    delete[] m_slots;
+}
+
+void key_write_times::record(unsigned long long key_index, const struct timeval *ts)
+{
+    unsigned long long usec = (unsigned long long) ts->tv_sec * 1000000 + ts->tv_usec;
+    m_slots[(key_index - m_key_minimum) % m_slots_count].store(usec, std::memory_order_relaxed);
+}
+
+unsigned long long key_write_times::lookup(const char *key, unsigned int key_len) const
+{
+    unsigned long long key_index;
+    if (!m_key_names->parse(key, key_len, &key_index) || key_index < m_key_minimum) return 0;
+
+    return m_slots[(key_index - m_key_minimum) % m_slots_count].load(std::memory_order_relaxed);
+}
+
 static int hex_digit_to_int(char c)
 {
     if (c >= 'a' && c <= 'f') {
@@ -300,7 +466,7 @@ static int hex_digit_to_int(char c)
 }
 
 arbitrary_command::arbitrary_command(const char *cmd) :
-        command(cmd), key_pattern('R'), keys_count(0), ratio(1), stats_only(false)
+        command(cmd), key_pattern('R'), keys_count(0), ratio(1), stats_only(false), commands_count(0)
 {
     // command name is the first word in the command
     size_t pos = command.find(" ");
@@ -340,6 +506,16 @@ bool arbitrary_command::set_ratio(const char *ratio_str)
     return true;
 }
 
+// Closes the command whose args start at first_arg, false if it has none
+bool arbitrary_command::end_command(size_t first_arg)
+{
+    if (first_arg >= command_args.size()) return false;
+
+    command_args[first_arg].args_count = command_args.size() - first_arg;
+    commands_count++;
+    return true;
+}
+
 bool arbitrary_command::split_command_to_args()
 {
     const char *p = command.c_str();
@@ -347,6 +523,7 @@ bool arbitrary_command::split_command_to_args()
 
     char buffer[command_len];
     unsigned int buffer_len = 0;
+    size_t first_arg = 0;
 
     while (1) {
         /* skip blanks */
@@ -358,6 +535,7 @@ bool arbitrary_command::split_command_to_args()
             /* get a token */
             bool in_quotes = 0;        /* set to 1 if we are in "quotes" */
             bool in_single_quotes = 0; /* set to 1 if we are in 'single quotes' */
+            bool quoted = 0;           /* set to 1 if the token had any quotes */
             bool done = 0;
             buffer_len = 0;
             // current = p;
@@ -450,10 +628,12 @@ bool arbitrary_command::split_command_to_args()
 
                     case '"':
                         in_quotes = 1;
+                        quoted = 1;
                         break;
 
                     case '\'':
                         in_single_quotes = 1;
+                        quoted = 1;
                         break;
 
                     default:
@@ -468,14 +648,38 @@ bool arbitrary_command::split_command_to_args()
                 }
             }
 
+            // a bare ';' ends a command of a compound request
+            if (!quoted && buffer_len == 1 && buffer[0] == ';') {
+                if (!end_command(first_arg)) goto err;
+                first_arg = command_args.size();
+                continue;
+            }
+
             // add new arg
             command_arg arg(buffer, buffer_len);
             command_args.push_back(arg);
         } else {
-            return true;
+            break;
         }
     }
 
+    if (command_args.empty()) return true;
+    if (!end_command(first_arg)) goto err;
+
+    // a compound request is named after its commands, e.g. MULTI+INCR+EXEC
+    if (commands_count > 1) {
+        command_name.clear();
+        for (size_t i = 0; i < command_args.size(); i++) {
+            if (command_args[i].args_count == 0) continue;
+            if (!command_name.empty()) command_name += "+";
+            command_name += command_args[i].data;
+        }
+        std::transform(command_name.begin(), command_name.end(), command_name.begin(), ::toupper);
+        command_type = command_name;
+    }
+
+    return true;
+
 err:
     return false;
 }
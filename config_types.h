@@ -23,6 +23,7 @@
 #include <pthread.h>
 #endif
 
+#include <sys/time.h>
 #include <netinet/in.h>
 
 #include <vector>
@@ -95,7 +96,7 @@ struct connect_info
 
 struct server_addr
 {
-    server_addr(const char *hostname, int port, int resolution);
+    server_addr(const char *hostname, int port, int resolution, bool resolve_on_connect);
     virtual ~server_addr();
 
     int get_connect_info(struct connect_info *ci);
@@ -110,9 +111,68 @@ protected:
     struct addrinfo *m_server_addr;
     struct addrinfo *m_used_addr;
     int m_resolution;
+    bool m_resolve_on_connect;
     std::atomic<int> m_last_error; // Atomic to prevent data race between resolve() and get_connect_info()
 };
 
+// Local addresses that outgoing connections are bound to, round-robin
+struct source_addr_pool
+{
+    // list is a comma separated list of IP addresses and/or interface names
+    source_addr_pool(const char *list);
+
+    bool get_next(int family, struct sockaddr_storage *addr, socklen_t *addrlen);
+    size_t size(void) const { return m_addrs.size(); }
+
+protected:
+    void add_address(const char *name);
+
+    std::vector<struct sockaddr_storage> m_addrs;
+    std::atomic<unsigned int> m_next;
+};
+
+// Names generated keys: the key prefix followed by the key index.  With a
+// group size, every group_size consecutive indexes share a {hash tag} so a
+// cluster keeps them in one slot; the tag replaces a {tag} segment of the
+// prefix, or follows the prefix if it has none.
+struct key_template
+{
+    key_template(const char *key_prefix, unsigned int group_size);
+
+    // writes the name of a key, returns its length as snprintf does
+    int format(char *buf, size_t size, unsigned long long key_index) const;
+    // extracts the index from a key name, false if it isn't a generated key
+    bool parse(const char *key, unsigned int key_len, unsigned long long *key_index) const;
+
+    unsigned int get_group_size() const { return m_group_size; }
+
+protected:
+    std::string m_head;
+    std::string m_tail;
+    unsigned int m_group_size;
+};
+
+// Last write time of every key, shared by all threads so a tracking
+// invalidation can be matched to the SET that caused it.  Keys map to
+// slots by their index; above max_slots indices wrap and share a slot.
+struct key_write_times
+{
+    key_write_times(const key_template *key_names, unsigned long long key_minimum, unsigned long long key_maximum);
+    ~key_write_times();
+
+    void record(unsigned long long key_index, const struct timeval *ts);
+    // returns the write time in usec of a key by name, 0 if unknown
+    unsigned long long lookup(const char *key, unsigned int key_len) const;
+
+    static const unsigned long long max_slots = 1ULL << 22;
+
+protected:
+    const key_template *m_key_names;
+    unsigned long long m_key_minimum;
+    unsigned long long m_slots_count;
+    std::atomic<unsigned long long> *m_slots;
+};
+
 // Forward declaration for object_generator
 class object_generator;
 
@@ -136,7 +196,7 @@ enum command_arg_type
 struct command_arg
 {
     command_arg(const char *arg, unsigned int arg_len) :
-            type(undefined_type), data(arg, arg_len), monitor_index(0), has_key_affixes(false)
+            type(undefined_type), data(arg, arg_len), monitor_index(0), has_key_affixes(false), args_count(0)
     {
         ;
     }
@@ -149,6 +209,8 @@ struct command_arg
     std::string data_suffix;
     // optimization flag to avoid runtime checks
     bool has_key_affixes;
+    // set on the first arg of each command: the number of args of that command
+    unsigned int args_count;
 };
 
 struct arbitrary_command
@@ -158,6 +220,7 @@ struct arbitrary_command
     bool set_key_pattern(const char *pattern_str);
     bool set_ratio(const char *pattern_str);
     bool split_command_to_args();
+    bool is_compound() const { return commands_count > 1; }
 
     std::vector<command_arg> command_args;
     std::string command;
@@ -167,6 +230,13 @@ struct arbitrary_command
     unsigned int keys_count;
     unsigned int ratio;
     bool stats_only; // If true, this is a stats-only slot (not executed, just for stats tracking)
+    // commands separated by ';' are sent together as one compound request,
+    // e.g. "MULTI ; INCR __key__ ; EXEC", and get one reply each
+    unsigned int commands_count;
+    std::vector<std::string> scripts; // EVAL scripts, sent as EVALSHA and loaded on connect
+
+private:
+    bool end_command(size_t first_arg);
 };
 
 struct arbitrary_command_list
@@ -192,6 +262,14 @@ public:
 
     bool is_defined() const { return !commands_list.empty(); }
 
+    bool has_scripts() const
+    {
+        for (size_t i = 0; i < size(); i++) {
+            if (!commands_list[i].scripts.empty()) return true;
+        }
+        return false;
+    }
+
     unsigned int get_max_command_name_length() const
     {
         unsigned int max_length = 0;
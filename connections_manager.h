@@ -19,6 +19,12 @@
 #ifndef MEMTIER_BENCHMARK_CLIENT_DATA_MANAGER_H
 #define MEMTIER_BENCHMARK_CLIENT_DATA_MANAGER_H
 
+class thread_overhead;
+class shared_socket;
+#ifdef USE_TLS
+class tls_session_cache;
+#endif
+
 class connections_manager
 {
 public:
@@ -35,6 +41,7 @@ public:
     virtual void handle_cluster_slots(protocol_response *r) = 0;
     virtual void handle_response(unsigned int conn_id, struct timeval timestamp, request *request,
                                  protocol_response *response) = 0;
+    virtual void handle_push(unsigned int conn_id, struct timeval timestamp, protocol_response *response) = 0;
 
     virtual void create_request(struct timeval timestamp, unsigned int conn_id) = 0;
     virtual bool hold_pipeline(unsigned int conn_id) = 0;
@@ -42,6 +49,15 @@ public:
     virtual int connect(void) = 0;
     virtual void disconnect(void) = 0;
     virtual void disconnect_all(void) = 0;
+    virtual void handle_connect_result(unsigned int conn_id, bool connected, unsigned long long connect_usec) = 0;
+    // the requests in flight on the connection won't get a reply
+    virtual void handle_requests_lost(unsigned int conn_id) = 0;
+
+    virtual thread_overhead *get_thread_overhead(void) = 0;
+    virtual shared_socket *get_shared_socket(const char *server_id) = 0;
+#ifdef USE_TLS
+    virtual tls_session_cache *get_tls_session_cache(void) = 0;
+#endif
 };
 
 
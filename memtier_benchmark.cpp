@@ -40,6 +40,7 @@
 #include <errno.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <netinet/tcp.h>
 #include <signal.h>
 #ifdef HAVE_EXECINFO_H
 #include <execinfo.h>
@@ -78,6 +79,8 @@
 #include <algorithm>
 
 #include "client.h"
+#include "cluster_client.h"
+#include "sharded_client.h"
 #include "JSON_handler.h"
 #include "obj_gen.h"
 #include "memtier_benchmark.h"
@@ -263,6 +266,64 @@ static const char *get_protocol_name(enum PROTOCOL_TYPE type)
         return "memcache_text";
     else if (type == PROTOCOL_MEMCACHE_BINARY)
         return "memcache_binary";
+    else if (type == PROTOCOL_MEMCACHE_META)
+        return "memcache_meta";
+    else
+        return "none";
+}
+
+const char *get_data_type_name(enum DATA_TYPE type)
+{
+    if (type == DATA_TYPE_STRING)
+        return "string";
+    else if (type == DATA_TYPE_HASH)
+        return "hash";
+    else if (type == DATA_TYPE_SET)
+        return "set";
+    else if (type == DATA_TYPE_ZSET)
+        return "zset";
+    else if (type == DATA_TYPE_LIST)
+        return "list";
+    else
+        return "none";
+}
+
+const char *get_queue_pop_name(enum QUEUE_POP_TYPE type)
+{
+    if (type == QUEUE_POP_BRPOP)
+        return "BRPOP";
+    else if (type == QUEUE_POP_BLPOP)
+        return "BLPOP";
+    else if (type == QUEUE_POP_BLMOVE)
+        return "BLMOVE";
+    else if (type == QUEUE_POP_BZPOPMIN)
+        return "BZPOPMIN";
+    else
+        return "none";
+}
+
+const char *get_read_from_name(enum READ_FROM read_from)
+{
+    if (read_from == READ_FROM_PRIMARY)
+        return "primary";
+    else if (read_from == READ_FROM_REPLICA)
+        return "replica";
+    else if (read_from == READ_FROM_ROUND_ROBIN)
+        return "round-robin";
+    else if (read_from == READ_FROM_NEAREST)
+        return "nearest";
+    else
+        return "none";
+}
+
+const char *get_sharding_name(enum SHARDING sharding)
+{
+    if (sharding == SHARDING_KETAMA)
+        return "ketama";
+    else if (sharding == SHARDING_JUMP)
+        return "jump";
+    else if (sharding == SHARDING_MODULO)
+        return "modulo";
     else
         return "none";
 }
@@ -327,7 +388,7 @@ static void config_print(FILE *file, struct benchmark_config *cfg)
             "wait-timeout = %u-%u\n"
             "json-out-file = %s\n"
             "print-all-runs = %s\n",
-            cfg->server, cfg->port, cfg->uri ? cfg->uri : "", cfg->unix_socket,
+            cfg->servers ? cfg->servers : cfg->server, cfg->port, cfg->uri ? cfg->uri : "", cfg->unix_socket,
             cfg->resolution == AF_UNSPEC ? "Unspecified"
             : cfg->resolution == AF_INET ? "AF_INET"
                                          : "AF_INET6",
@@ -355,7 +416,7 @@ static void config_print_to_json(json_handler *jsonhandler, struct benchmark_con
 
     jsonhandler->open_nesting("configuration");
 
-    jsonhandler->write_obj("server", "\"%s\"", cfg->server);
+    jsonhandler->write_obj("server", "\"%s\"", cfg->servers ? cfg->servers : cfg->server);
     jsonhandler->write_obj("port", "%u", cfg->port);
     jsonhandler->write_obj("uri", "\"%s\"", cfg->uri ? cfg->uri : "");
     jsonhandler->write_obj("unix socket", "\"%s\"", cfg->unix_socket);
@@ -372,6 +433,8 @@ static void config_print_to_json(json_handler *jsonhandler, struct benchmark_con
     jsonhandler->write_obj("cacert", "\"%s\"", cfg->tls_cacert);
     jsonhandler->write_obj("tls_skip_verify", "\"%s\"", cfg->tls_skip_verify ? "true" : "false");
     jsonhandler->write_obj("sni", "\"%s\"", cfg->tls_sni);
+    jsonhandler->write_obj("tls_session_reuse", "\"%s\"", cfg->tls_session_reuse ? "true" : "false");
+    jsonhandler->write_obj("tls_ktls", "\"%s\"", cfg->tls_ktls ? "true" : "false");
 #endif
     jsonhandler->write_obj("client_stats", "\"%s\"", cfg->client_stats);
     jsonhandler->write_obj("run_count", "%u", cfg->run_count);
@@ -386,15 +449,21 @@ static void config_print_to_json(json_handler *jsonhandler, struct benchmark_con
     jsonhandler->write_obj("data_size", "%u", cfg->data_size);
     jsonhandler->write_obj("data_offset", "%u", cfg->data_offset);
     jsonhandler->write_obj("random_data", "\"%s\"", cfg->random_data ? "true" : "false");
+    jsonhandler->write_obj("zero_copy_threshold", "%u", cfg->zero_copy_threshold);
     jsonhandler->write_obj("data_size_range", "\"%u:%u\"", cfg->data_size_range.min, cfg->data_size_range.max);
     jsonhandler->write_obj("data_size_list", "\"%s\"", cfg->data_size_list.print(tmpbuf, sizeof(tmpbuf) - 1));
     jsonhandler->write_obj("data_size_pattern", "\"%s\"", cfg->data_size_pattern);
     jsonhandler->write_obj("expiry_range", "\"%u:%u\"", cfg->expiry_range.min, cfg->expiry_range.max);
+    jsonhandler->write_obj("data_type", "\"%s\"", get_data_type_name(cfg->data_type));
+    jsonhandler->write_obj("data_fields", "%u", cfg->data_fields);
+    jsonhandler->write_obj("data_read_fields", "%u", cfg->data_read_fields);
+    jsonhandler->write_obj("data_score_pattern", "\"%s\"", cfg->data_score_pattern ? cfg->data_score_pattern : "");
     jsonhandler->write_obj("data_import", "\"%s\"", cfg->data_import);
     jsonhandler->write_obj("data_verify", "\"%s\"", cfg->data_verify ? "true" : "false");
     jsonhandler->write_obj("verify_only", "\"%s\"", cfg->verify_only ? "true" : "false");
     jsonhandler->write_obj("generate_keys", "\"%s\"", cfg->generate_keys ? "true" : "false");
     jsonhandler->write_obj("key_prefix", "\"%s\"", cfg->key_prefix);
+    jsonhandler->write_obj("key_group_size", "%u", cfg->key_group_size);
     jsonhandler->write_obj("key_minimum", "%11u", cfg->key_minimum);
     jsonhandler->write_obj("key_maximum", "%11u", cfg->key_maximum);
     jsonhandler->write_obj("key_pattern", "\"%s\"", cfg->key_pattern);
@@ -405,7 +474,28 @@ static void config_print_to_json(json_handler *jsonhandler, struct benchmark_con
     jsonhandler->write_obj("connection_timeout", "%u", cfg->connection_timeout);
     jsonhandler->write_obj("thread_conn_start_min_jitter_micros", "%u", cfg->thread_conn_start_min_jitter_micros);
     jsonhandler->write_obj("thread_conn_start_max_jitter_micros", "%u", cfg->thread_conn_start_max_jitter_micros);
+    jsonhandler->write_obj("connect_wave_size", "%u", cfg->connect_wave_size);
+    jsonhandler->write_obj("shared_connections", "%u", cfg->shared_connections);
+    jsonhandler->write_obj("resolve_on_connect", "\"%s\"", cfg->resolve_on_connect ? "true" : "false");
+    jsonhandler->write_obj("source_address", "\"%s\"", cfg->source_address ? cfg->source_address : "");
+    jsonhandler->write_obj("tcp_fast_open", "\"%s\"", cfg->tcp_fast_open ? "true" : "false");
     jsonhandler->write_obj("multi_key_get", "%u", cfg->multi_key_get);
+    jsonhandler->write_obj("read_from", "\"%s\"", get_read_from_name(cfg->read_from));
+    jsonhandler->write_obj("cluster_refresh_interval", "%u", cfg->cluster_refresh_interval);
+    jsonhandler->write_obj("slot_cache_mb", "%u", cfg->slot_cache_mb);
+    jsonhandler->write_obj("servers", "\"%s\"", cfg->servers ? cfg->servers : "");
+    jsonhandler->write_obj("sharding", "\"%s\"", get_sharding_name(cfg->sharding));
+    jsonhandler->write_obj("client_tracking", "\"%s\"", cfg->client_tracking ? "true" : "false");
+    jsonhandler->write_obj("pubsub_channels", "%u", cfg->pubsub_channels);
+    jsonhandler->write_obj("pubsub_subscribers", "%u", cfg->pubsub_subscribers);
+    jsonhandler->write_obj("streams", "%u", cfg->streams);
+    jsonhandler->write_obj("stream_consumers", "%u", cfg->stream_consumers);
+    jsonhandler->write_obj("stream_count", "%u", cfg->stream_count);
+    jsonhandler->write_obj("stream_block", "%u", cfg->stream_block);
+    jsonhandler->write_obj("queues", "%u", cfg->queues);
+    jsonhandler->write_obj("queue_consumers", "%u", cfg->queue_consumers);
+    jsonhandler->write_obj("queue_pop", "\"%s\"", get_queue_pop_name(cfg->queue_pop));
+    jsonhandler->write_obj("queue_timeout", "%.3f", cfg->queue_timeout);
     jsonhandler->write_obj("authenticate", "\"%s\"", cfg->authenticate ? cfg->authenticate : "");
     jsonhandler->write_obj("select-db", "%d", cfg->select_db);
     jsonhandler->write_obj("no-expiry", "\"%s\"", cfg->no_expiry ? "true" : "false");
@@ -413,6 +503,9 @@ static void config_print_to_json(json_handler *jsonhandler, struct benchmark_con
     jsonhandler->write_obj("num-slaves", "\"%u:%u\"", cfg->num_slaves.min, cfg->num_slaves.max);
     jsonhandler->write_obj("wait-timeout", "\"%u-%u\"", cfg->wait_timeout.min, cfg->wait_timeout.max);
     jsonhandler->write_obj("print-all-runs", "\"%s\"", cfg->print_all_runs ? "true" : "false");
+    jsonhandler->write_obj("thread-stats", "\"%s\"", cfg->thread_stats ? "true" : "false");
+    jsonhandler->write_obj("thread-cpu-warn", "%u", cfg->thread_cpu_warn);
+    jsonhandler->write_obj("first-byte-stats", "\"%s\"", cfg->first_byte_stats ? "true" : "false");
     if (cfg->clients_start > 0) {
         jsonhandler->write_obj("clients_start", "%u", cfg->clients_start);
         jsonhandler->write_obj("clients_step", "%u", cfg->clients_step);
@@ -541,8 +634,9 @@ static int parse_uri(const char *uri, struct benchmark_config *cfg)
 
 static void config_init_defaults(struct benchmark_config *cfg)
 {
-    if (!cfg->server && !cfg->unix_socket) cfg->server = "localhost";
-    if (!cfg->port && !cfg->unix_socket) cfg->port = 6379;
+    if (!cfg->server && !cfg->unix_socket && !cfg->servers) cfg->server = "localhost";
+    if (!cfg->port && !cfg->unix_socket && !cfg->servers) cfg->port = 6379;
+    if (cfg->servers && cfg->sharding == SHARDING_NONE) cfg->sharding = SHARDING_KETAMA;
     if (!cfg->resolution) cfg->resolution = AF_UNSPEC;
     if (!cfg->run_count) cfg->run_count = 1;
     if (!cfg->clients) cfg->clients = 50;
@@ -573,6 +667,8 @@ static void config_init_defaults(struct benchmark_config *cfg)
     if (!cfg->statsd_run_label) cfg->statsd_run_label = "default";
     if (!cfg->graphite_port) cfg->graphite_port = 8080;
 
+    if (!cfg->thread_cpu_warn) cfg->thread_cpu_warn = 90;
+
 #ifdef USE_TLS
     if (!cfg->tls_protocols) cfg->tls_protocols = REDIS_TLS_PROTO_DEFAULT;
 #endif
@@ -596,9 +692,6 @@ static bool verify_cluster_option(struct benchmark_config *cfg)
     if (cfg->reconnect_interval) {
         fprintf(stderr, "error: cluster mode dose not support reconnect-interval option.\n");
         return false;
-    } else if (cfg->multi_key_get) {
-        fprintf(stderr, "error: cluster mode dose not support multi-key-get option.\n");
-        return false;
     } else if (cfg->wait_ratio.is_defined()) {
         fprintf(stderr, "error: cluster mode dose not support wait-ratio option.\n");
         return false;
@@ -613,6 +706,34 @@ static bool verify_cluster_option(struct benchmark_config *cfg)
     return true;
 }
 
+static bool verify_servers_option(struct benchmark_config *cfg)
+{
+    if (cfg->server || cfg->port || cfg->unix_socket || cfg->uri) {
+        fprintf(stderr, "error: servers cannot be used with server, port, unix-socket or uri.\n");
+        return false;
+    } else if (cfg->cluster_mode) {
+        fprintf(stderr, "error: servers cannot be used in cluster mode.\n");
+        return false;
+    } else if (cfg->reconnect_interval) {
+        fprintf(stderr, "error: servers does not support reconnect-interval option.\n");
+        return false;
+    } else if (cfg->multi_key_get) {
+        fprintf(stderr, "error: servers does not support multi-key-get option.\n");
+        return false;
+    } else if (cfg->data_verify || cfg->verify_only) {
+        fprintf(stderr, "error: servers does not support data-verify and verify-only options.\n");
+        return false;
+    } else if (cfg->data_import && !cfg->generate_keys) {
+        fprintf(stderr, "error: servers requires generate-keys with data-import.\n");
+        return false;
+    } else if (cfg->pubsub_channels || cfg->streams || cfg->queues) {
+        fprintf(stderr, "error: servers cannot be used with pub/sub, streams or queues.\n");
+        return false;
+    }
+
+    return true;
+}
+
 static bool verify_arbitrary_command_option(struct benchmark_config *cfg)
 {
     if (cfg->key_pattern) {
@@ -652,11 +773,17 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         o_data_size_list,
         o_data_size_pattern,
         o_data_offset,
+        o_zero_copy_threshold,
         o_expiry_range,
+        o_data_type,
+        o_data_fields,
+        o_data_read_fields,
+        o_data_score_pattern,
         o_data_import,
         o_data_verify,
         o_verify_only,
         o_key_prefix,
+        o_key_group_size,
         o_key_minimum,
         o_key_maximum,
         o_key_pattern,
@@ -677,8 +804,24 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         o_connection_timeout,
         o_thread_conn_start_min_jitter_micros,
         o_thread_conn_start_max_jitter_micros,
+        o_connect_wave_size,
+        o_shared_connections,
+        o_resolve_on_connect,
+        o_source_address,
+        o_tcp_fast_open,
         o_generate_keys,
         o_multi_key_get,
+        o_client_tracking,
+        o_pubsub_channels,
+        o_pubsub_subscribers,
+        o_streams,
+        o_stream_consumers,
+        o_stream_count,
+        o_stream_block,
+        o_queues,
+        o_queue_consumers,
+        o_queue_pop,
+        o_queue_timeout,
         o_select_db,
         o_no_expiry,
         o_wait_ratio,
@@ -686,6 +829,11 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         o_wait_timeout,
         o_json_out_file,
         o_cluster_mode,
+        o_read_from,
+        o_cluster_refresh_interval,
+        o_slot_cache_mb,
+        o_servers,
+        o_sharding,
         o_command,
         o_command_key_pattern,
         o_command_ratio,
@@ -699,6 +847,8 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         o_tls_skip_verify,
         o_tls_sni,
         o_tls_protocols,
+        o_tls_session_reuse,
+        o_tls_ktls,
         o_hdr_file_prefix,
         o_rate_limiting,
         o_uri,
@@ -709,6 +859,9 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         o_graphite_port,
         o_scan_incremental_iteration,
         o_scan_incremental_max_iterations,
+        o_thread_stats,
+        o_thread_cpu_warn,
+        o_first_byte_stats,
         o_clients_start,
         o_clients_step,
         o_step_duration,
@@ -731,6 +884,8 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         {"tls-skip-verify", 0, 0, o_tls_skip_verify},
         {"sni", 1, 0, o_tls_sni},
         {"tls-protocols", 1, 0, o_tls_protocols},
+        {"tls-session-reuse", 0, 0, o_tls_session_reuse},
+        {"tls-ktls", 0, 0, o_tls_ktls},
 #endif
         {"out-file", 1, 0, 'o'},
         {"hdr-file-prefix", 1, 0, o_hdr_file_prefix},
@@ -751,16 +906,22 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         {"pipeline", 1, 0, o_pipeline},
         {"data-size", 1, 0, 'd'},
         {"data-offset", 1, 0, o_data_offset},
+        {"zero-copy-threshold", 1, 0, o_zero_copy_threshold},
         {"random-data", 0, 0, 'R'},
         {"data-size-range", 1, 0, o_data_size_range},
         {"data-size-list", 1, 0, o_data_size_list},
         {"data-size-pattern", 1, 0, o_data_size_pattern},
         {"expiry-range", 1, 0, o_expiry_range},
+        {"data-type", 1, 0, o_data_type},
+        {"data-fields", 1, 0, o_data_fields},
+        {"data-read-fields", 1, 0, o_data_read_fields},
+        {"data-score-pattern", 1, 0, o_data_score_pattern},
         {"data-import", 1, 0, o_data_import},
         {"data-verify", 0, 0, o_data_verify},
         {"verify-only", 0, 0, o_verify_only},
         {"generate-keys", 0, 0, o_generate_keys},
         {"key-prefix", 1, 0, o_key_prefix},
+        {"key-group-size", 1, 0, o_key_group_size},
         {"key-minimum", 1, 0, o_key_minimum},
         {"key-maximum", 1, 0, o_key_maximum},
         {"key-pattern", 1, 0, o_key_pattern},
@@ -774,7 +935,23 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         {"connection-timeout", 1, 0, o_connection_timeout},
         {"thread-conn-start-min-jitter-micros", 1, 0, o_thread_conn_start_min_jitter_micros},
         {"thread-conn-start-max-jitter-micros", 1, 0, o_thread_conn_start_max_jitter_micros},
+        {"connect-wave-size", 1, 0, o_connect_wave_size},
+        {"shared-connections", 1, 0, o_shared_connections},
+        {"resolve-on-connect", 0, 0, o_resolve_on_connect},
+        {"source-address", 1, 0, o_source_address},
+        {"tcp-fast-open", 0, 0, o_tcp_fast_open},
         {"multi-key-get", 1, 0, o_multi_key_get},
+        {"client-tracking", 0, 0, o_client_tracking},
+        {"pubsub-channels", 1, 0, o_pubsub_channels},
+        {"pubsub-subscribers", 1, 0, o_pubsub_subscribers},
+        {"streams", 1, 0, o_streams},
+        {"stream-consumers", 1, 0, o_stream_consumers},
+        {"stream-count", 1, 0, o_stream_count},
+        {"stream-block", 1, 0, o_stream_block},
+        {"queues", 1, 0, o_queues},
+        {"queue-consumers", 1, 0, o_queue_consumers},
+        {"queue-pop", 1, 0, o_queue_pop},
+        {"queue-timeout", 1, 0, o_queue_timeout},
         {"authenticate", 1, 0, 'a'},
         {"select-db", 1, 0, o_select_db},
         {"no-expiry", 0, 0, o_no_expiry},
@@ -783,6 +960,11 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         {"wait-timeout", 1, 0, o_wait_timeout},
         {"json-out-file", 1, 0, o_json_out_file},
         {"cluster-mode", 0, 0, o_cluster_mode},
+        {"read-from", 1, 0, o_read_from},
+        {"cluster-refresh-interval", 1, 0, o_cluster_refresh_interval},
+        {"slot-cache-mb", 1, 0, o_slot_cache_mb},
+        {"servers", 1, 0, o_servers},
+        {"sharding", 1, 0, o_sharding},
         {"help", 0, 0, o_help},
         {"version", 0, 0, 'v'},
         {"command", 1, 0, o_command},
@@ -800,6 +982,9 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         {"graphite-port", 1, 0, o_graphite_port},
         {"scan-incremental-iteration", 0, 0, o_scan_incremental_iteration},
         {"scan-incremental-max-iterations", 1, 0, o_scan_incremental_max_iterations},
+        {"thread-stats", 0, 0, o_thread_stats},
+        {"thread-cpu-warn", 1, 0, o_thread_cpu_warn},
+        {"first-byte-stats", 0, 0, o_first_byte_stats},
         {"clients-start", 1, 0, o_clients_start},
         {"clients-step", 1, 0, o_clients_step},
         {"step-duration", 1, 0, o_step_duration},
@@ -876,9 +1061,11 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
                 cfg->protocol = PROTOCOL_MEMCACHE_TEXT;
             } else if (strcmp(optarg, "memcache_binary") == 0) {
                 cfg->protocol = PROTOCOL_MEMCACHE_BINARY;
+            } else if (strcmp(optarg, "memcache_meta") == 0) {
+                cfg->protocol = PROTOCOL_MEMCACHE_META;
             } else {
-                fprintf(stderr, "error: supported protocols are 'memcache_text', 'memcache_binary', 'redis', 'resp2' "
-                                "and resp3'.\n");
+                fprintf(stderr, "error: supported protocols are 'memcache_text', 'memcache_binary', "
+                                "'memcache_meta', 'redis', 'resp2' and resp3'.\n");
                 return -1;
             }
             break;
@@ -1003,6 +1190,14 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
                 return -1;
             }
             break;
+        case o_zero_copy_threshold:
+            endptr = NULL;
+            cfg->zero_copy_threshold = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!endptr || *endptr != '\0') {
+                fprintf(stderr, "error: zero-copy-threshold must be greater than or equal to zero.\n");
+                return -1;
+            }
+            break;
         case o_data_size_range:
             cfg->data_size_range = config_range(optarg);
             if (!cfg->data_size_range.is_defined() || cfg->data_size_range.min < 1) {
@@ -1032,6 +1227,46 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
                 return -1;
             }
             break;
+        case o_data_type:
+            if (strcmp(optarg, "string") == 0) {
+                cfg->data_type = DATA_TYPE_STRING;
+            } else if (strcmp(optarg, "hash") == 0) {
+                cfg->data_type = DATA_TYPE_HASH;
+            } else if (strcmp(optarg, "set") == 0) {
+                cfg->data_type = DATA_TYPE_SET;
+            } else if (strcmp(optarg, "zset") == 0) {
+                cfg->data_type = DATA_TYPE_ZSET;
+            } else if (strcmp(optarg, "list") == 0) {
+                cfg->data_type = DATA_TYPE_LIST;
+            } else {
+                fprintf(stderr, "error: data-type must be one of 'string', 'hash', 'set', 'zset' or 'list'.\n");
+                return -1;
+            }
+            break;
+        case o_data_fields:
+            endptr = NULL;
+            cfg->data_fields = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!cfg->data_fields || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: data-fields must be greater than zero.\n");
+                return -1;
+            }
+            break;
+        case o_data_read_fields:
+            endptr = NULL;
+            cfg->data_read_fields = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!endptr || *endptr != '\0') {
+                fprintf(stderr, "error: data-read-fields must be a valid number.\n");
+                return -1;
+            }
+            break;
+        case o_data_score_pattern:
+            cfg->data_score_pattern = optarg;
+            if (strlen(cfg->data_score_pattern) != 1 ||
+                (cfg->data_score_pattern[0] != 'R' && cfg->data_score_pattern[0] != 'S')) {
+                fprintf(stderr, "error: data-score-pattern must be either R or S.\n");
+                return -1;
+            }
+            break;
         case o_data_import:
             cfg->data_import = optarg;
             break;
@@ -1045,6 +1280,14 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         case o_key_prefix:
             cfg->key_prefix = optarg;
             break;
+        case o_key_group_size:
+            endptr = NULL;
+            cfg->key_group_size = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (cfg->key_group_size < 1 || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: key-group-size must be greater than zero.\n");
+                return -1;
+            }
+            break;
         case o_key_minimum:
             endptr = NULL;
             cfg->key_minimum = strtoull(optarg, &endptr, 10);
@@ -1156,6 +1399,36 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
                 return -1;
             }
             break;
+        case o_connect_wave_size:
+            endptr = NULL;
+            cfg->connect_wave_size = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!endptr || *endptr != '\0') {
+                fprintf(stderr, "error: connect-wave-size must be a valid number.\n");
+                return -1;
+            }
+            break;
+        case o_shared_connections:
+            endptr = NULL;
+            cfg->shared_connections = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (cfg->shared_connections < 1 || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: shared-connections must be greater than zero.\n");
+                return -1;
+            }
+            break;
+        case o_resolve_on_connect:
+            cfg->resolve_on_connect = true;
+            break;
+        case o_source_address:
+            cfg->source_address = optarg;
+            break;
+        case o_tcp_fast_open:
+#ifdef TCP_FASTOPEN_CONNECT
+            cfg->tcp_fast_open = true;
+            break;
+#else
+            fprintf(stderr, "error: tcp-fast-open is not supported on this platform.\n");
+            return -1;
+#endif
         case o_generate_keys:
             cfg->generate_keys = 1;
             break;
@@ -1167,6 +1440,95 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
                 return -1;
             }
             break;
+        case o_client_tracking:
+            cfg->client_tracking = true;
+            break;
+        case o_pubsub_channels:
+            endptr = NULL;
+            cfg->pubsub_channels = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!cfg->pubsub_channels || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: pubsub-channels must be greater than zero.\n");
+                return -1;
+            }
+            break;
+        case o_pubsub_subscribers:
+            endptr = NULL;
+            cfg->pubsub_subscribers = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!cfg->pubsub_subscribers || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: pubsub-subscribers must be greater than zero.\n");
+                return -1;
+            }
+            break;
+        case o_streams:
+            endptr = NULL;
+            cfg->streams = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!cfg->streams || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: streams must be greater than zero.\n");
+                return -1;
+            }
+            break;
+        case o_stream_consumers:
+            endptr = NULL;
+            cfg->stream_consumers = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!cfg->stream_consumers || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: stream-consumers must be greater than zero.\n");
+                return -1;
+            }
+            break;
+        case o_stream_count:
+            endptr = NULL;
+            cfg->stream_count = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!cfg->stream_count || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: stream-count must be greater than zero.\n");
+                return -1;
+            }
+            break;
+        case o_stream_block:
+            endptr = NULL;
+            cfg->stream_block = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!endptr || *endptr != '\0') {
+                fprintf(stderr, "error: stream-block must be a valid number of milliseconds.\n");
+                return -1;
+            }
+            break;
+        case o_queues:
+            endptr = NULL;
+            cfg->queues = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!cfg->queues || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: queues must be greater than zero.\n");
+                return -1;
+            }
+            break;
+        case o_queue_consumers:
+            endptr = NULL;
+            cfg->queue_consumers = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!cfg->queue_consumers || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: queue-consumers must be greater than zero.\n");
+                return -1;
+            }
+            break;
+        case o_queue_pop:
+            if (strcasecmp(optarg, "brpop") == 0) {
+                cfg->queue_pop = QUEUE_POP_BRPOP;
+            } else if (strcasecmp(optarg, "blpop") == 0) {
+                cfg->queue_pop = QUEUE_POP_BLPOP;
+            } else if (strcasecmp(optarg, "blmove") == 0) {
+                cfg->queue_pop = QUEUE_POP_BLMOVE;
+            } else if (strcasecmp(optarg, "bzpopmin") == 0) {
+                cfg->queue_pop = QUEUE_POP_BZPOPMIN;
+            } else {
+                fprintf(stderr, "error: queue-pop must be one of 'brpop', 'blpop', 'blmove' or 'bzpopmin'.\n");
+                return -1;
+            }
+            break;
+        case o_queue_timeout:
+            endptr = NULL;
+            cfg->queue_timeout = strtod(optarg, &endptr);
+            if (cfg->queue_timeout <= 0.0 || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: queue-timeout must be greater than zero.\n");
+                return -1;
+            }
+            break;
         case 'a':
             cfg->authenticate = optarg;
             break;
@@ -1211,6 +1573,51 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         case o_cluster_mode:
             cfg->cluster_mode = true;
             break;
+        case o_read_from:
+            if (strcmp(optarg, "primary") == 0) {
+                cfg->read_from = READ_FROM_PRIMARY;
+            } else if (strcmp(optarg, "replica") == 0) {
+                cfg->read_from = READ_FROM_REPLICA;
+            } else if (strcmp(optarg, "round-robin") == 0) {
+                cfg->read_from = READ_FROM_ROUND_ROBIN;
+            } else if (strcmp(optarg, "nearest") == 0) {
+                cfg->read_from = READ_FROM_NEAREST;
+            } else {
+                fprintf(stderr, "error: read-from must be one of 'primary', 'replica', 'round-robin' or 'nearest'.\n");
+                return -1;
+            }
+            break;
+        case o_cluster_refresh_interval:
+            endptr = NULL;
+            cfg->cluster_refresh_interval = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!endptr || *endptr != '\0') {
+                fprintf(stderr, "error: cluster-refresh-interval must be a valid number.\n");
+                return -1;
+            }
+            break;
+        case o_slot_cache_mb:
+            endptr = NULL;
+            cfg->slot_cache_mb = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!endptr || *endptr != '\0') {
+                fprintf(stderr, "error: slot-cache-mb must be a valid number.\n");
+                return -1;
+            }
+            break;
+        case o_servers:
+            cfg->servers = optarg;
+            break;
+        case o_sharding:
+            if (strcmp(optarg, "ketama") == 0) {
+                cfg->sharding = SHARDING_KETAMA;
+            } else if (strcmp(optarg, "jump") == 0) {
+                cfg->sharding = SHARDING_JUMP;
+            } else if (strcmp(optarg, "modulo") == 0) {
+                cfg->sharding = SHARDING_MODULO;
+            } else {
+                fprintf(stderr, "error: sharding must be one of 'ketama', 'jump' or 'modulo'.\n");
+                return -1;
+            }
+            break;
         case o_command: {
             // Check if this is a monitor placeholder
             const char *cmd_str = optarg;
@@ -1350,6 +1757,17 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
             }
             break;
         }
+        case o_tls_session_reuse:
+            cfg->tls_session_reuse = true;
+            break;
+        case o_tls_ktls:
+#ifdef SSL_OP_ENABLE_KTLS
+            cfg->tls_ktls = true;
+#else
+            fprintf(stderr, "error: kernel TLS is not supported by this OpenSSL version.\n");
+            return -1;
+#endif
+            break;
 #endif
         case o_statsd_host:
             cfg->statsd_host = optarg;
@@ -1388,6 +1806,20 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
             }
             break;
         }
+        case o_thread_stats:
+            cfg->thread_stats = true;
+            break;
+        case o_first_byte_stats:
+            cfg->first_byte_stats = true;
+            break;
+        case o_thread_cpu_warn:
+            endptr = NULL;
+            cfg->thread_cpu_warn = (unsigned int) strtoul(optarg, &endptr, 10);
+            if (!cfg->thread_cpu_warn || cfg->thread_cpu_warn > 100 || !endptr || *endptr != '\0') {
+                fprintf(stderr, "error: thread-cpu-warn must be a percentage between 1 and 100.\n");
+                return -1;
+            }
+            break;
         case o_clients_start:
             endptr = NULL;
             cfg->clients_start = (unsigned int) strtoul(optarg, &endptr, 10);
@@ -1439,7 +1871,28 @@ static int config_parse_args(int argc, char *argv[], struct benchmark_config *cf
         }
     }
 
-    if ((cfg->cluster_mode && !verify_cluster_option(cfg)) ||
+    if (cfg->read_from != READ_FROM_PRIMARY && !cfg->cluster_mode) {
+        fprintf(stderr, "error: read-from can only be used in cluster mode.\n");
+        return -1;
+    }
+
+    if (cfg->cluster_refresh_interval && !cfg->cluster_mode) {
+        fprintf(stderr, "error: cluster-refresh-interval can only be used in cluster mode.\n");
+        return -1;
+    }
+
+    if (cfg->sharding != SHARDING_NONE && !cfg->servers) {
+        fprintf(stderr, "error: sharding can only be used with servers.\n");
+        return -1;
+    }
+
+    // pushes and blocked replies would hold up the other clients of the connection
+    if (cfg->shared_connections && (cfg->pubsub_channels || cfg->streams || cfg->queues || cfg->client_tracking)) {
+        fprintf(stderr, "error: shared-connections cannot be used with pub/sub, streams, queues or client tracking.\n");
+        return -1;
+    }
+
+    if ((cfg->cluster_mode && !verify_cluster_option(cfg)) || (cfg->servers && !verify_servers_option(cfg)) ||
         (cfg->arbitrary_commands->is_defined() && !verify_arbitrary_command_option(cfg))) {
         return -1;
     }
@@ -1462,8 +1915,8 @@ void usage()
         "  -4, --ipv4                     Force IPv4 address resolution.\n"
         "  -6  --ipv6                     Force IPv6 address resolution.\n"
         "  -P, --protocol=PROTOCOL        Protocol to use (default: redis).\n"
-        "                                 other supported protocols are resp2, resp3, memcache_text and "
-        "memcache_binary.\n"
+        "                                 other supported protocols are resp2, resp3, memcache_text, "
+        "memcache_binary and memcache_meta.\n"
         "                                 when using one of resp2 or resp3 the redis protocol version will be set via "
         "HELLO command.\n"
         "  -a, --authenticate=CREDENTIALS Authenticate using specified credentials.\n"
@@ -1484,10 +1937,29 @@ void usage()
         "      --tls-protocols            Specify the tls protocol version to use, comma delemited. Use a combination "
         "of 'TLSv1', 'TLSv1.1', 'TLSv1.2' and 'TLSv1.3'.\n"
         "      --sni=STRING               Add an SNI header\n"
+        "      --tls-session-reuse        Resume TLS sessions: connections of a thread to the same\n"
+        "                                 server offer the most recent session ticket/ID\n"
+        "      --tls-ktls                 Offload TLS record encryption to the kernel (kTLS) after\n"
+        "                                 the handshake, where OpenSSL and the kernel support it\n"
 #endif
         "  -x, --run-count=NUMBER         Number of full-test iterations to perform\n"
         "  -D, --debug                    Print debug output\n"
-        "      --cluster-mode             Run client in cluster mode\n"
+        "      --cluster-mode             Run client in cluster mode, results are also broken down per shard\n"
+        "      --read-from=POLICY         Where cluster mode sends Gets, Sets always go to the primaries:\n"
+        "                                 primary, replica (READONLY connections to the replicas of each\n"
+        "                                 slot range), round-robin (the primary and its replicas in turn) or\n"
+        "                                 nearest (the node with the lowest reply latency) (default: primary)\n"
+        "      --cluster-refresh-interval=SECS Refresh the cluster topology every SECS seconds, besides on\n"
+        "                                 MOVED, on a dedicated connection (default: 0, on MOVED only)\n"
+        "      --slot-cache-mb=MB         Memory cluster mode may take to cache the hash slot of every key of\n"
+        "                                 the key range, 6 bytes a key with the keys of every slot, for each\n"
+        "                                 connection to draw its own keys, or 2 bytes a key with the slots\n"
+        "                                 only, 0 to hash every key (default: 96)\n"
+        "      --servers=LIST             Distribute the keys over several standalone servers, a comma\n"
+        "                                 separated list of host:port, results are also broken down per server;\n"
+        "                                 arbitrary commands may only use a single __key__\n"
+        "      --sharding=METHOD          How --servers distributes the keys: ketama (consistent hashing),\n"
+        "                                 jump (jump consistent hashing) or modulo (default: ketama)\n"
         "  -h, --help                     Display this help\n"
         "  -v, --version                  Display version information\n"
         "\n"
@@ -1514,6 +1986,12 @@ void usage()
         "(default: default)\n"
         "      --graphite-port=PORT       Graphite HTTP port for event annotations (default: 8080 for host access; "
         "use 80 when running inside the Docker network)\n"
+        "      --thread-stats             Measure time each thread spends creating requests, parsing responses and\n"
+        "                                 updating stats, and report per-thread CPU usage live and in the results\n"
+        "      --thread-cpu-warn=PCT      Warn when a thread's CPU utilization exceeds PCT percent, meaning the\n"
+        "                                 benchmark client may be the bottleneck (default: 90)\n"
+        "      --first-byte-stats         Report the time to first byte of the replies next to the time to last\n"
+        "                                 byte, telling server time from transfer time for large replies\n"
         "\n"
         "Test Options:\n"
         "  -n, --requests=NUMBER          Number of total requests per client (default: 10000)\n"
@@ -1540,7 +2018,42 @@ void usage()
         "(default: 0)\n"
         "      --thread-conn-start-max-jitter-micros=NUM Maximum jitter in microseconds between connection creation "
         "(default: 0)\n"
+        "      --connect-wave-size=NUM    Maximum number of connects in flight per thread during start-up\n"
+        "                                 (default: 0, connect all clients at once)\n"
+        "      --shared-connections=NUM   The clients of a thread share NUM connections to every server,\n"
+        "                                 client i sending over the (i %% NUM)th one (default: 0, a\n"
+        "                                 connection per client)\n"
+        "      --resolve-on-connect       Resolve the server name again once all of its addresses were used,\n"
+        "                                 instead of reusing the addresses resolved at start-up\n"
+        "      --source-address=LIST      Bind connections round-robin to a comma separated list of local\n"
+        "                                 addresses and/or interface names\n"
+        "      --tcp-fast-open            Use TCP Fast Open, sending the first request in the SYN\n"
         "      --multi-key-get=NUM        Enable multi-key get commands, up to NUM keys (default: 0)\n"
+        "                                 Uses MGET with redis; in cluster mode one MGET per hash slot,\n"
+        "                                 sent at once and accounted as one request when all replied\n"
+        "                                 With memcache_binary, quiet GETKQ requests ended by a NOOP;\n"
+        "                                 with memcache_meta, quiet mg requests between two mn\n"
+        "      --client-tracking          Enable CLIENT TRACKING on every connection (requires -P resp3)\n"
+        "                                 and report the latency from a SET to its invalidation push\n"
+        "      --pubsub-channels=NUM      Pub/Sub mode: publish to NUM channels, named like keys from\n"
+        "                                 --key-minimum on; SPUBLISH/SSUBSCRIBE in cluster mode\n"
+        "      --pubsub-subscribers=NUM   Number of clients per thread that subscribe to all the channels,\n"
+        "                                 the other clients publish (default: 1).  Messages are sized by\n"
+        "                                 the data size options and PUBLISH is reported as Sets\n"
+        "      --streams=NUM              Streams mode: XADD to NUM streams, named like keys from\n"
+        "                                 --key-minimum on, and consume them with a consumer group\n"
+        "      --stream-consumers=NUM     Number of clients per thread that XREADGROUP/XACK, the other\n"
+        "                                 clients produce (default: 1).  XADD is reported as Sets and\n"
+        "                                 XREADGROUP as Gets, with one hit per entry read\n"
+        "      --stream-count=NUM         Max entries read by each XREADGROUP (default: 10)\n"
+        "      --stream-block=MSEC        XREADGROUP BLOCK timeout, 0 doesn't block (default: 0)\n"
+        "      --queues=NUM               Queue mode: push to NUM lists, named like keys from --key-minimum\n"
+        "                                 on, and consume them with a blocking pop\n"
+        "      --queue-consumers=NUM      Number of clients per thread that pop, the other clients push\n"
+        "                                 (default: 1).  Pushes are reported as Sets and pops as Gets\n"
+        "      --queue-pop=CMD            Blocking pop: brpop (LPUSH/BRPOP), blpop, blmove (to a processing\n"
+        "                                 list, then LREM) or bzpopmin (ZADD/BZPOPMIN) (default: brpop)\n"
+        "      --queue-timeout=SECS       Timeout of each blocking pop, a timed out pop is a miss (default: 1)\n"
         "      --select-db=DB             DB number to select, when testing a redis server\n"
         "      --distinct-client-seed     Use a different random seed for each client\n"
         "      --randomize                random seed based on timestamp (default is constant value)\n"
@@ -1554,6 +2067,14 @@ void usage()
         "                                 To use a generated key or object, enter:\n"
         "                                   __key__: Use key generated from Key Options.\n"
         "                                   __data__: Use data generated from Object Options.\n"
+        "                                 With memcache_meta, __data__ must follow __key__, e.g.\n"
+        "                                 \"ms __key__ __data__ T60\", and commands must not use the\n"
+        "                                 q flag since every command is expected to be answered, nor\n"
+        "                                 be mn, which multi-get uses.\n"
+        "                                 Separate commands with ' ; ' to send them as one compound\n"
+        "                                 request, e.g. \"MULTI ; INCR __key__ ; EXEC\"; all of them\n"
+        "                                 share one __key__ and latency is measured to the last reply.\n"
+        "                                 EVAL scripts are loaded on connect and sent as EVALSHA.\n"
         "      --command-ratio            The number of times the command is sent in sequence.(default: 1)\n"
         "      --command-key-pattern      Key pattern for the command (default: R):\n"
         "                                 G for Gaussian distribution.\n"
@@ -1585,6 +2106,8 @@ void usage()
         "      --data-offset=OFFSET       Actual size of value will be data-size + data-offset\n"
         "                                 Will use SETRANGE / GETRANGE (default: 0)\n"
         "  -R  --random-data              Indicate that data should be randomized\n"
+        "      --zero-copy-threshold=SIZE Attach values of SIZE bytes or more to the output buffer by reference\n"
+        "                                 instead of copying them (default: 0, always copy)\n"
         "      --data-size-range=RANGE    Use random-sized items in the specified range (min-max)\n"
         "      --data-size-list=LIST      Use sizes from weight list (size1:weight1,..sizeN:weightN)\n"
         "      --data-size-pattern=R|S    Use together with data-size-range\n"
@@ -1592,6 +2115,14 @@ void usage()
         "                                 when set to S, the defined data sizes will be evenly distributed across\n"
         "                                 the key range, see --key-maximum (default R)\n"
         "      --expiry-range=RANGE       Use random expiry values from the specified range\n"
+        "      --data-type=TYPE           Type of the objects: string, hash, set, zset or list (default: string)\n"
+        "                                 Sets write --data-fields fields, members or elements of data size\n"
+        "                                 with HSET, SADD, ZADD or RPUSH+LTRIM, Gets read them with\n"
+        "                                 HGETALL/HMGET, SMEMBERS/SRANDMEMBER, ZRANGEBYSCORE or LRANGE\n"
+        "      --data-fields=NUM          Fields, members or list elements per object (default: 10)\n"
+        "      --data-read-fields=NUM     Fields read by each Get, 0 reads the whole object (default: 0)\n"
+        "      --data-score-pattern=R|S   Sorted set scores: S for the member index, R for a random score\n"
+        "                                 below --data-fields (default: S)\n"
         "\n"
         "Imported Data Options:\n"
         "      --data-import=FILE         Read object data from file\n"
@@ -1602,6 +2133,10 @@ void usage()
         "\n"
         "Key Options:\n"
         "      --key-prefix=PREFIX        Prefix for keys (default: \"memtier-\")\n"
+        "      --key-group-size=NUMBER    Give every NUMBER consecutive keys a shared {hash tag}, so they\n"
+        "                                 map to one cluster slot. The tag replaces a {tag} segment of\n"
+        "                                 the key prefix, or follows the prefix; multi-key gets use\n"
+        "                                 keys of one group (default: 0, no hash tags)\n"
         "      --key-minimum=NUMBER       Key ID minimum value (default: 0)\n"
         "      --key-maximum=NUMBER       Key ID maximum value (default: 10000000)\n"
         "      --key-pattern=PATTERN      Set:Get pattern (default: R:R)\n"
@@ -1728,7 +2263,7 @@ static void *cg_thread_start(void *t)
 
         // Check if we should restart due to connection failures
         // If the thread finished but still has time left and connection errors, request restart
-        if (thread->m_cg->get_total_connection_errors() > 0) {
+        if (thread->m_cg->get_total_connection_errors() > 0 && !thread->m_cg->all_clients_finished()) {
             benchmark_error_log("Thread %u finished due to connection failures, requesting restart.\n",
                                 thread->m_thread_id);
             thread->m_restart_requested = true;
@@ -1905,10 +2440,29 @@ static void print_staircase_pattern(int run_id, benchmark_config *cfg)
     fprintf(stderr, "\n");
 }
 
+// Returns how long after prepare_start the last thread got all of its initial
+// clients connected, or 0 if some thread has not gotten there (yet).
+static unsigned long long get_all_connected_usec(std::vector<cg_thread *> &threads, struct timeval *prepare_start)
+{
+    unsigned long long start_usec = (unsigned long long) prepare_start->tv_sec * 1000000 + prepare_start->tv_usec;
+    unsigned long long last_usec = 0;
+
+    for (std::vector<cg_thread *>::iterator i = threads.begin(); i != threads.end(); i++) {
+        unsigned long long usec = (*i)->m_cg->get_all_connected_usec();
+        if (usec == 0) return 0;
+        if (usec > last_usec) last_usec = usec;
+    }
+
+    return last_usec > start_usec ? last_usec - start_usec : 0;
+}
+
 run_stats run_benchmark(int run_id, benchmark_config *cfg, object_generator *obj_gen)
 {
     fprintf(stderr, "[RUN #%u] Preparing benchmark client...\n", run_id);
 
+    struct timeval prepare_start;
+    gettimeofday(&prepare_start, NULL);
+
     // prepare threads data
     std::vector<cg_thread *> threads;
     g_threads = &threads; // Set global pointer for crash handler
@@ -1953,15 +2507,29 @@ run_stats run_benchmark(int run_id, benchmark_config *cfg, object_generator *obj
     unsigned long int cur_ops_sec = 0;
     unsigned long int cur_bytes_sec = 0;
 
+    // last CPU sample and utilization per thread, for the live --thread-stats display
+    std::vector<thread_overhead_stats> prev_overhead(threads.size());
+    std::vector<double> thread_cpu(threads.size(), 0);
+
     // provide some feedback...
     // NOTE: Reading stats from worker threads without synchronization is a benign race.
     // These stats are only for progress display and are approximate. Final results are
     // collected after pthread_join() when all threads have finished (race-free).
     unsigned int active_threads = 0;
+    unsigned long long all_connected_usec = 0;
     do {
         active_threads = 0;
         sleep(1);
 
+        if (!all_connected_usec) {
+            all_connected_usec = get_all_connected_usec(threads, &prepare_start);
+            if (all_connected_usec) {
+                fprintf(stderr, "\n[RUN #%u] All %u connections established after %.3f secs.\n", run_id,
+                        cfg->threads * (cfg->clients_start > 0 ? cfg->clients_start : cfg->clients),
+                        all_connected_usec / 1000000.0);
+            }
+        }
+
         // Check for Ctrl+C interrupt
         if (g_interrupted) {
             // Calculate elapsed time before interrupting
@@ -2007,6 +2575,20 @@ run_stats run_benchmark(int run_id, benchmark_config *cfg, object_generator *obj
 
             if (!(*i)->m_finished) active_threads++;
 
+            if (cfg->thread_stats) {
+                unsigned int id = (*i)->m_thread_id;
+                thread_overhead_stats cur = (*i)->m_cg->get_overhead_stats(id);
+
+                // a restarted thread starts over with fresh counters
+                if (cur.m_wall_usec < prev_overhead[id].m_wall_usec) prev_overhead[id] = thread_overhead_stats();
+                if (cur.m_wall_usec > prev_overhead[id].m_wall_usec) {
+                    unsigned long long busy = (cur.m_user_usec + cur.m_sys_usec) -
+                                              (prev_overhead[id].m_user_usec + prev_overhead[id].m_sys_usec);
+                    thread_cpu[id] = 100.0 * busy / (cur.m_wall_usec - prev_overhead[id].m_wall_usec);
+                    prev_overhead[id] = cur;
+                }
+            }
+
             total_ops += (*i)->m_cg->get_total_ops();
             total_bytes += (*i)->m_cg->get_total_bytes();
             total_latency += (*i)->m_cg->get_total_latency();
@@ -2043,6 +2625,16 @@ run_stats run_benchmark(int run_id, benchmark_config *cfg, object_generator *obj
         size_to_str(bytes_sec, bytes_str, sizeof(bytes_str) - 1);
         size_to_str(cur_bytes_sec, cur_bytes_str, sizeof(cur_bytes_str) - 1);
 
+        double max_thread_cpu = 0;
+        char thread_cpu_str[64] = "";
+        if (cfg->thread_stats) {
+            for (std::size_t t = 0; t < thread_cpu.size(); t++) {
+                if (thread_cpu[t] > max_thread_cpu) max_thread_cpu = thread_cpu[t];
+            }
+            snprintf(thread_cpu_str, sizeof(thread_cpu_str), ", %3.0f%% max thread cpu%s", max_thread_cpu,
+                     max_thread_cpu >= cfg->thread_cpu_warn ? " (!)" : "");
+        }
+
         // Calculate current client count for display
         unsigned int display_clients = cfg->clients;
         if (cfg->clients_start > 0) {
@@ -2070,16 +2662,16 @@ run_stats run_benchmark(int run_id, benchmark_config *cfg, object_generator *obj
         if (total_connection_errors > 0) {
             fprintf(stderr,
                     "[RUN #%u %.0f%%, %3u secs] %2u threads %2u conns %lu conn errors: %11lu ops, %7lu (avg: %7lu) "
-                    "ops/sec, %s/sec (avg: %s/sec), %5.2f (avg: %5.2f) msec latency\r",
+                    "ops/sec, %s/sec (avg: %s/sec), %5.2f (avg: %5.2f) msec latency%s\r",
                     run_id, progress, (unsigned int) (duration / 1000000), active_threads, display_clients,
                     total_connection_errors, total_ops, cur_ops_sec, ops_sec, cur_bytes_str, bytes_str, cur_latency,
-                    avg_latency);
+                    avg_latency, thread_cpu_str);
         } else {
             fprintf(stderr,
                     "[RUN #%u %.0f%%, %3u secs] %2u threads %2u conns: %11lu ops, %7lu (avg: %7lu) ops/sec, %s/sec "
-                    "(avg: %s/sec), %5.2f (avg: %5.2f) msec latency\r",
+                    "(avg: %s/sec), %5.2f (avg: %5.2f) msec latency%s\r",
                     run_id, progress, (unsigned int) (duration / 1000000), active_threads, display_clients, total_ops,
-                    cur_ops_sec, ops_sec, cur_bytes_str, bytes_str, cur_latency, avg_latency);
+                    cur_ops_sec, ops_sec, cur_bytes_str, bytes_str, cur_latency, avg_latency, thread_cpu_str);
         }
 
         // Send metrics to StatsD if configured
@@ -2095,6 +2687,9 @@ run_stats run_benchmark(int run_id, benchmark_config *cfg, object_generator *obj
             if (total_connection_errors > 0) {
                 cfg->statsd->gauge("connection_errors", (long) total_connection_errors);
             }
+            if (cfg->thread_stats) {
+                cfg->statsd->gauge("thread_cpu_max_pct", max_thread_cpu);
+            }
 
             // Calculate and send percentile metrics from instantaneous histograms
             // Allocate a temporary histogram to aggregate all threads' instantaneous histograms
@@ -2162,7 +2757,17 @@ run_stats run_benchmark(int run_id, benchmark_config *cfg, object_generator *obj
     for (std::vector<cg_thread *>::iterator i = threads.begin(); i != threads.end(); i++) {
         (*i)->join();
         (*i)->m_cg->merge_run_stats(&stats);
+
+        thread_overhead_stats overhead = (*i)->m_cg->get_overhead_stats((*i)->m_thread_id);
+        stats.add_thread_overhead(overhead);
+        if (overhead.cpu_utilization() >= cfg->thread_cpu_warn) {
+            fprintf(stderr,
+                    "[RUN #%u] WARNING: thread %u averaged %.1f%% CPU utilization (threshold: %u%%), results may be "
+                    "limited by the benchmark client rather than the server.\n",
+                    run_id, (*i)->m_thread_id, overhead.cpu_utilization(), cfg->thread_cpu_warn);
+        }
     }
+    stats.set_all_connected_usec(get_all_connected_usec(threads, &prepare_start));
 
     // Do we need to produce client stats?
     if (cfg->client_stats != NULL) {
@@ -2287,6 +2892,7 @@ int main(int argc, char *argv[])
     cfg.arbitrary_commands = new arbitrary_command_list();
     cfg.monitor_commands = new monitor_command_list();
     cfg.command_stats_by_type = true; // Default: aggregate by command type
+    cfg.slot_cache_mb = 96;           // Default: the keys of every slot for up to 16M keys
 
     if (config_parse_args(argc, argv, &cfg) < 0) {
         usage();
@@ -2581,6 +3187,12 @@ int main(int argc, char *argv[])
             continue;
         }
 
+        // Compound commands rely on redis transactions and scripts
+        if (cmd.is_compound() && !is_redis_protocol(cfg.protocol)) {
+            benchmark_error_log("error: compound commands are only supported with the redis protocol\n");
+            exit(1);
+        }
+
         abstract_protocol *tmp_protocol = protocol_factory(cfg.protocol);
         assert(tmp_protocol != NULL);
 
@@ -2588,11 +3200,19 @@ int main(int argc, char *argv[])
             exit(1);
         }
 
-        // Cluster mode supports only a single key commands
-        if (cfg.cluster_mode && cmd.keys_count > 1) {
+        // Cluster mode supports only a single key commands; all the commands
+        // of a compound share the same key, so they always hit a single slot
+        if (cfg.cluster_mode && cmd.keys_count > 1 && !cmd.is_compound()) {
             benchmark_error_log("error: Cluster mode supports only a single key commands\n");
             exit(1);
         }
+
+        // The keys of a command are sharded independently, yet it is sent to
+        // a single server
+        if (cfg.servers && cmd.keys_count > 1 && !cmd.is_compound()) {
+            benchmark_error_log("error: --servers supports only a single key commands\n");
+            exit(1);
+        }
         delete tmp_protocol;
     }
 
@@ -2621,6 +3241,11 @@ int main(int argc, char *argv[])
     }
 
 #ifdef USE_TLS
+    if (!cfg.tls && (cfg.tls_session_reuse || cfg.tls_ktls)) {
+        fprintf(stderr, "error: tls-session-reuse and tls-ktls require --tls.\n");
+        exit(1);
+    }
+
     // Initialize OpenSSL only if we're really going to use it.
     if (cfg.tls) {
         init_openssl();
@@ -2657,6 +3282,14 @@ int main(int argc, char *argv[])
             }
         }
         SSL_CTX_set_verify(cfg.openssl_ctx, cfg.tls_skip_verify ? SSL_VERIFY_NONE : SSL_VERIFY_PEER, NULL);
+
+        if (cfg.tls_session_reuse && !tls_session_cache::setup_ctx(cfg.openssl_ctx)) {
+            fprintf(stderr, "Error: Failed to set up the TLS session cache.\n");
+            exit(1);
+        }
+#ifdef SSL_OP_ENABLE_KTLS
+        if (cfg.tls_ktls) SSL_CTX_set_options(cfg.openssl_ctx, SSL_OP_ENABLE_KTLS);
+#endif
     }
 #endif
 
@@ -2681,14 +3314,38 @@ int main(int argc, char *argv[])
 
     if (cfg.server != NULL && cfg.port > 0) {
         try {
-            cfg.server_addr = new server_addr(cfg.server, cfg.port, cfg.resolution);
+            cfg.server_addr = new server_addr(cfg.server, cfg.port, cfg.resolution, cfg.resolve_on_connect);
         } catch (std::runtime_error &e) {
             benchmark_error_log("%s:%u: error: %s\n", cfg.server, cfg.port, e.what());
             exit(1);
         }
     }
 
-    unsigned int fds_needed = (cfg.threads * cfg.clients) + (cfg.threads * 10) + 10;
+    if (cfg.servers != NULL) {
+        try {
+            cfg.servers_ring = new server_ring(cfg.servers, cfg.sharding, cfg.resolution, cfg.resolve_on_connect);
+        } catch (std::runtime_error &e) {
+            benchmark_error_log("error: servers: %s\n", e.what());
+            exit(1);
+        }
+    }
+
+    if (cfg.source_address != NULL) {
+        if (cfg.unix_socket != NULL) {
+            benchmark_error_log("error: source-address cannot be used with a UNIX domain socket.\n");
+            exit(1);
+        }
+        try {
+            cfg.source_addrs = new source_addr_pool(cfg.source_address);
+        } catch (std::runtime_error &e) {
+            benchmark_error_log("error: source-address: %s\n", e.what());
+            exit(1);
+        }
+    }
+
+    // every client connects to each of the servers
+    unsigned int servers_count = cfg.servers_ring != NULL ? cfg.servers_ring->size() : 1;
+    unsigned int fds_needed = (cfg.threads * cfg.clients * servers_count) + (cfg.threads * 10) + 10;
     if (fds_needed > rlim.rlim_cur) {
         if (fds_needed > rlim.rlim_max && getuid() != 0) {
             benchmark_error_log("error: running the tool with this number of connections requires 'root' privilegs.\n");
@@ -2738,11 +3395,21 @@ int main(int argc, char *argv[])
             exit(1);
         }
 
+        if (cfg.zero_copy_threshold) {
+            fprintf(stderr, "error: zero-copy-threshold cannot be specified when importing.\n");
+            exit(1);
+        }
+
         if (!cfg.generate_keys && (cfg.key_maximum || cfg.key_minimum || cfg.key_prefix)) {
             fprintf(stderr, "error: use key-minimum, key-maximum and key-prefix only with generate-keys.\n");
             exit(1);
         }
 
+        if (!cfg.generate_keys && cfg.key_group_size) {
+            fprintf(stderr, "error: use key-group-size only with generate-keys.\n");
+            exit(1);
+        }
+
         if (!cfg.generate_keys) {
             // read keys
             fprintf(stderr, "Reading keys from %s...", cfg.data_import);
@@ -2767,7 +3434,7 @@ int main(int argc, char *argv[])
     }
 
     if (cfg.authenticate) {
-        if (cfg.protocol == PROTOCOL_MEMCACHE_TEXT) {
+        if (cfg.protocol == PROTOCOL_MEMCACHE_TEXT || cfg.protocol == PROTOCOL_MEMCACHE_META) {
             fprintf(stderr, "error: authenticate can only be used with redis or memcache_binary.\n");
             usage();
         }
@@ -2778,6 +3445,7 @@ int main(int argc, char *argv[])
     }
     if (!cfg.data_import) {
         obj_gen->set_random_data(cfg.random_data);
+        obj_gen->set_immutable_values(cfg.zero_copy_threshold > 0);
     }
 
     if (cfg.select_db > 0 && !is_redis_protocol(cfg.protocol)) {
@@ -2794,6 +3462,10 @@ int main(int argc, char *argv[])
                     "error: data-offset can only be used with redis protocol, and cannot be used with expiry\n");
             usage();
         }
+        if (cfg.multi_key_get) {
+            fprintf(stderr, "error: data-offset cannot be used with multi-key-get (MGET has no range form).\n");
+            usage();
+        }
     }
     if (cfg.data_size) {
         if (cfg.data_size_list.is_defined() || cfg.data_size_range.is_defined()) {
@@ -2815,9 +3487,142 @@ int main(int argc, char *argv[])
         usage();
     }
 
+    if (cfg.pubsub_channels) {
+        if (!is_redis_protocol(cfg.protocol)) {
+            fprintf(stderr, "error: pubsub-channels can only be used with redis protocol.\n");
+            usage();
+        }
+        if (!cfg.pubsub_subscribers) cfg.pubsub_subscribers = 1;
+        if (cfg.pubsub_subscribers >= cfg.clients) {
+            fprintf(stderr, "error: pubsub-subscribers (%u) must be less than --clients (%u).\n",
+                    cfg.pubsub_subscribers, cfg.clients);
+            usage();
+        }
+        if (cfg.arbitrary_commands->is_defined() || cfg.multi_key_get || cfg.wait_ratio.is_defined() ||
+            cfg.data_import || cfg.clients_start || cfg.data_verify) {
+            fprintf(stderr, "error: pubsub-channels cannot be used with arbitrary commands, multi-key-get, "
+                            "wait-ratio, data-import, data-verify or client staircase mode.\n");
+            usage();
+        }
+
+        // publishers only publish, each message to one of the channels
+        cfg.ratio = config_ratio("1:0");
+        cfg.key_maximum = cfg.key_minimum + cfg.pubsub_channels - 1;
+    } else if (cfg.pubsub_subscribers) {
+        fprintf(stderr, "error: pubsub-subscribers requires pubsub-channels.\n");
+        usage();
+    }
+
+    if (cfg.streams) {
+        if (!is_redis_protocol(cfg.protocol)) {
+            fprintf(stderr, "error: streams can only be used with redis protocol.\n");
+            usage();
+        }
+        if (!cfg.stream_consumers) cfg.stream_consumers = 1;
+        if (!cfg.stream_count) cfg.stream_count = 10;
+        if (cfg.stream_consumers >= cfg.clients) {
+            fprintf(stderr, "error: stream-consumers (%u) must be less than --clients (%u).\n", cfg.stream_consumers,
+                    cfg.clients);
+            usage();
+        }
+        if (cfg.pubsub_channels || cfg.arbitrary_commands->is_defined() || cfg.multi_key_get ||
+            cfg.wait_ratio.is_defined() || cfg.data_import || cfg.clients_start || cfg.data_verify ||
+            cfg.reconnect_interval) {
+            fprintf(stderr, "error: streams cannot be used with pubsub-channels, arbitrary commands, multi-key-get, "
+                            "wait-ratio, data-import, data-verify, reconnect-interval or client staircase mode.\n");
+            usage();
+        }
+
+        // producers only add entries, each one to one of the streams
+        cfg.ratio = config_ratio("1:0");
+        cfg.key_maximum = cfg.key_minimum + cfg.streams - 1;
+    } else if (cfg.stream_consumers || cfg.stream_count || cfg.stream_block) {
+        fprintf(stderr, "error: stream-consumers, stream-count and stream-block require streams.\n");
+        usage();
+    }
+
+    if (cfg.data_type != DATA_TYPE_STRING) {
+        if (!is_redis_protocol(cfg.protocol)) {
+            fprintf(stderr, "error: data-type %s can only be used with redis protocol.\n",
+                    get_data_type_name(cfg.data_type));
+            usage();
+        }
+        if (!cfg.data_fields) cfg.data_fields = 10;
+        if (!cfg.data_score_pattern) cfg.data_score_pattern = "S";
+        if (cfg.data_read_fields > cfg.data_fields) {
+            fprintf(stderr, "error: data-read-fields (%u) cannot exceed data-fields (%u).\n", cfg.data_read_fields,
+                    cfg.data_fields);
+            usage();
+        }
+        if (cfg.pubsub_channels || cfg.streams || cfg.queues || cfg.arbitrary_commands->is_defined() ||
+            cfg.multi_key_get || cfg.data_offset || cfg.data_import || cfg.data_verify || cfg.expiry_range.max) {
+            fprintf(stderr, "error: data-type cannot be used with pubsub-channels, streams, queues, arbitrary "
+                            "commands, multi-key-get, data-offset, data-import, data-verify or expiry-range.\n");
+            usage();
+        }
+    } else if (cfg.data_fields || cfg.data_read_fields || cfg.data_score_pattern) {
+        fprintf(stderr, "error: data-fields, data-read-fields and data-score-pattern require a data-type other "
+                        "than string.\n");
+        usage();
+    }
+
+    if (cfg.queues) {
+        if (!is_redis_protocol(cfg.protocol)) {
+            fprintf(stderr, "error: queues can only be used with redis protocol.\n");
+            usage();
+        }
+        if (!cfg.queue_consumers) cfg.queue_consumers = 1;
+        if (cfg.queue_timeout <= 0) cfg.queue_timeout = 1;
+        if (cfg.queue_consumers >= cfg.clients) {
+            fprintf(stderr, "error: queue-consumers (%u) must be less than --clients (%u).\n", cfg.queue_consumers,
+                    cfg.clients);
+            usage();
+        }
+        if (cfg.pubsub_channels || cfg.streams || cfg.arbitrary_commands->is_defined() || cfg.multi_key_get ||
+            cfg.wait_ratio.is_defined() || cfg.data_import || cfg.clients_start || cfg.data_verify ||
+            cfg.reconnect_interval) {
+            fprintf(stderr, "error: queues cannot be used with pubsub-channels, streams, arbitrary commands, "
+                            "multi-key-get, wait-ratio, data-import, data-verify, reconnect-interval or client "
+                            "staircase mode.\n");
+            usage();
+        }
+
+        // producers only push, each message to one of the queues
+        cfg.ratio = config_ratio("1:0");
+        cfg.key_maximum = cfg.key_minimum + cfg.queues - 1;
+    } else if (cfg.queue_consumers || cfg.queue_timeout > 0 || cfg.queue_pop != QUEUE_POP_BRPOP) {
+        fprintf(stderr, "error: queue-consumers, queue-pop and queue-timeout require queues.\n");
+        usage();
+    }
+
     if (!cfg.data_import || cfg.generate_keys) {
+        cfg.key_names = new key_template(cfg.key_prefix, cfg.key_group_size);
         obj_gen->set_key_prefix(cfg.key_prefix);
+        obj_gen->set_key_names(cfg.key_names);
         obj_gen->set_key_range(cfg.key_minimum, cfg.key_maximum);
+
+        // lets every cluster connection draw the keys of its own slots, or
+        // at least look their slots up, as far as the slot cache allows
+        unsigned long long keys = cfg.key_maximum - cfg.key_minimum + 1;
+        if (cfg.cluster_mode && keys <= UINT_MAX) {
+            unsigned long long cache_keys = (unsigned long long) cfg.slot_cache_mb << 20;
+            if (keys <= cache_keys / slot_key_map::key_lists_bytes) {
+                cfg.slot_keys = new slot_key_map(cfg.key_names, cfg.key_minimum, cfg.key_maximum, true);
+            } else if (keys <= cache_keys / slot_key_map::key_slot_bytes) {
+                cfg.slot_keys = new slot_key_map(cfg.key_names, cfg.key_minimum, cfg.key_maximum, false);
+            }
+        }
+    }
+    if (cfg.client_tracking) {
+        if (cfg.protocol != PROTOCOL_RESP3) {
+            fprintf(stderr, "error: client-tracking requires the resp3 protocol (-P resp3).\n");
+            usage();
+        }
+        if (cfg.data_import && !cfg.generate_keys) {
+            fprintf(stderr, "error: client-tracking cannot be used with imported keys.\n");
+            usage();
+        }
+        cfg.tracking_writes = new key_write_times(cfg.key_names, cfg.key_minimum, cfg.key_maximum);
     }
     if (cfg.key_stddev > 0 || cfg.key_median > 0) {
         if (cfg.key_pattern[key_pattern_set] != 'G' && cfg.key_pattern[key_pattern_get] != 'G') {
@@ -2981,6 +3786,31 @@ int main(int argc, char *argv[])
         cfg.server_addr = NULL;
     }
 
+    if (cfg.servers_ring) {
+        delete cfg.servers_ring;
+        cfg.servers_ring = NULL;
+    }
+
+    if (cfg.source_addrs) {
+        delete cfg.source_addrs;
+        cfg.source_addrs = NULL;
+    }
+
+    if (cfg.tracking_writes) {
+        delete cfg.tracking_writes;
+        cfg.tracking_writes = NULL;
+    }
+
+    if (cfg.slot_keys) {
+        delete cfg.slot_keys;
+        cfg.slot_keys = NULL;
+    }
+
+    if (cfg.key_names) {
+        delete cfg.key_names;
+        cfg.key_names = NULL;
+    }
+
     if (jsonhandler != NULL) {
         // Log message for saving JSON file
         fprintf(stderr, "Saving JSON output file: %s\n", cfg.json_out_file);
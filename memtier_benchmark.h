@@ -51,6 +51,45 @@ enum PROTOCOL_TYPE
     PROTOCOL_RESP3,
     PROTOCOL_MEMCACHE_TEXT,
     PROTOCOL_MEMCACHE_BINARY,
+    PROTOCOL_MEMCACHE_META,
+};
+
+// the type of the values written and read
+enum DATA_TYPE
+{
+    DATA_TYPE_STRING,
+    DATA_TYPE_HASH,
+    DATA_TYPE_SET,
+    DATA_TYPE_ZSET,
+    DATA_TYPE_LIST,
+};
+
+// the blocking command queue consumers pop with
+enum QUEUE_POP_TYPE
+{
+    QUEUE_POP_BRPOP,
+    QUEUE_POP_BLPOP,
+    QUEUE_POP_BLMOVE,
+    QUEUE_POP_BZPOPMIN,
+};
+
+// where cluster mode sends reads: primaries, replicas, all of them in
+// turn, or the node answering fastest
+enum READ_FROM
+{
+    READ_FROM_PRIMARY,
+    READ_FROM_REPLICA,
+    READ_FROM_ROUND_ROBIN,
+    READ_FROM_NEAREST,
+};
+
+// how the keys are distributed over the standalone servers of --servers
+enum SHARDING
+{
+    SHARDING_NONE, // not given, ketama with --servers
+    SHARDING_KETAMA,
+    SHARDING_JUMP,
+    SHARDING_MODULO,
 };
 
 struct benchmark_config
@@ -81,15 +120,23 @@ struct benchmark_config
     unsigned int data_size;
     unsigned int data_offset;
     bool random_data;
+    unsigned int zero_copy_threshold;
     struct config_range data_size_range;
     config_weight_list data_size_list;
     const char *data_size_pattern;
     struct config_range expiry_range;
+    // Native data types: fields, members or elements per key
+    enum DATA_TYPE data_type;
+    unsigned int data_fields;
+    unsigned int data_read_fields;
+    const char *data_score_pattern;
     const char *data_import;
     int data_verify;
     int verify_only;
     int generate_keys;
     const char *key_prefix;
+    unsigned int key_group_size;
+    struct key_template *key_names;
     unsigned long long key_minimum;
     unsigned long long key_maximum;
     double key_stddev;
@@ -103,12 +150,33 @@ struct benchmark_config
     unsigned int connection_timeout;
     unsigned int thread_conn_start_min_jitter_micros;
     unsigned int thread_conn_start_max_jitter_micros;
+    unsigned int connect_wave_size;
+    unsigned int shared_connections;
     int multi_key_get;
     const char *authenticate;
     int select_db;
     const char *uri;
     bool no_expiry;
     bool resolve_on_connect;
+    const char *source_address;
+    struct source_addr_pool *source_addrs;
+    bool tcp_fast_open;
+    // RESP3 client tracking
+    bool client_tracking;
+    struct key_write_times *tracking_writes;
+    // Pub/Sub fan-out
+    unsigned int pubsub_channels;
+    unsigned int pubsub_subscribers;
+    // Streams consumer groups
+    unsigned int streams;
+    unsigned int stream_consumers;
+    unsigned int stream_count;
+    unsigned int stream_block;
+    // Blocking-command queues
+    unsigned int queues;
+    unsigned int queue_consumers;
+    enum QUEUE_POP_TYPE queue_pop;
+    double queue_timeout;
     // WAIT related
     config_ratio wait_ratio;
     config_range num_slaves;
@@ -116,6 +184,14 @@ struct benchmark_config
     // JSON additions
     const char *json_out_file;
     bool cluster_mode;
+    enum READ_FROM read_from;
+    unsigned int cluster_refresh_interval;
+    unsigned int slot_cache_mb;
+    class slot_key_map *slot_keys;
+    // client side sharding over standalone servers
+    const char *servers;
+    enum SHARDING sharding;
+    class server_ring *servers_ring;
     struct arbitrary_command_list *arbitrary_commands;
     const char *monitor_input;
     struct monitor_command_list *monitor_commands;
@@ -141,6 +217,11 @@ struct benchmark_config
     bool scan_incremental_iteration;
     unsigned int scan_incremental_max_iterations;
     arbitrary_command *scan_continuation_command;
+    // Self-overhead instrumentation
+    bool thread_stats;
+    unsigned int thread_cpu_warn;
+    // time to first byte of the replies, next to their completion latency
+    bool first_byte_stats;
 #ifdef USE_TLS
     bool tls;
     const char *tls_cert;
@@ -149,6 +230,8 @@ struct benchmark_config
     bool tls_skip_verify;
     const char *tls_sni;
     int tls_protocols;
+    bool tls_session_reuse;
+    bool tls_ktls;
     SSL_CTX *openssl_ctx;
 #endif
 };
@@ -157,5 +240,9 @@ struct benchmark_config
 extern void benchmark_log_file_line(int level, const char *filename, unsigned int line, const char *fmt, ...);
 extern void benchmark_log(int level, const char *fmt, ...);
 bool is_redis_protocol(enum PROTOCOL_TYPE type);
+const char *get_queue_pop_name(enum QUEUE_POP_TYPE type);
+const char *get_data_type_name(enum DATA_TYPE type);
+const char *get_read_from_name(enum READ_FROM read_from);
+const char *get_sharding_name(enum SHARDING sharding);
 
 #endif /* _MEMTIER_BENCHMARK_H */
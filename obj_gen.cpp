@@ -140,9 +140,11 @@ object_generator::object_generator(size_t n_key_iterators /*= OBJECT_GENERATOR_K
         m_data_size_type(data_size_unknown),
         m_data_size_pattern(NULL),
         m_random_data(false),
+        m_immutable_values(false),
         m_expiry_min(0),
         m_expiry_max(0),
         m_key_prefix(NULL),
+        m_key_names(NULL),
         m_key_min(0),
         m_key_max(0),
         m_key_stddev(0),
@@ -169,9 +171,11 @@ object_generator::object_generator(const object_generator &copy) :
         m_data_size(copy.m_data_size),
         m_data_size_pattern(copy.m_data_size_pattern),
         m_random_data(copy.m_random_data),
+        m_immutable_values(copy.m_immutable_values),
         m_expiry_min(copy.m_expiry_min),
         m_expiry_max(copy.m_expiry_max),
         m_key_prefix(copy.m_key_prefix),
+        m_key_names(copy.m_key_names),
         m_key_min(copy.m_key_min),
         m_key_max(copy.m_key_max),
         m_key_stddev(copy.m_key_stddev),
@@ -239,6 +243,9 @@ void object_generator::alloc_value_buffer(void)
     else if (m_data_size_type == data_size_weighted)
         size = m_data_size.size_list->largest();
 
+    // immutable random values are windows into a larger buffer, see get_value()
+    if (size > 0 && m_random_data && m_immutable_values) size += VALUE_WINDOW_COUNT;
+
     m_value_buffer_size = size;
     if (size > 0) {
         m_value_buffer = (char *) malloc(size);
@@ -251,6 +258,13 @@ void object_generator::set_random_data(bool random_data)
     m_random_data = random_data;
 }
 
+// When set, buffers returned by get_value() are never modified afterwards, so
+// they may be referenced by output buffers until the object generator is freed.
+void object_generator::set_immutable_values(bool immutable_values)
+{
+    m_immutable_values = immutable_values;
+}
+
 void object_generator::set_data_size_fixed(unsigned int size)
 {
     m_data_size_type = data_size_fixed;
@@ -292,6 +306,11 @@ void object_generator::set_key_prefix(const char *key_prefix)
     m_key_prefix = key_prefix;
 }
 
+void object_generator::set_key_names(const key_template *key_names)
+{
+    m_key_names = key_names;
+}
+
 void object_generator::set_key_range(unsigned long long key_min, unsigned long long key_max)
 {
     m_key_min = key_min;
@@ -417,9 +436,28 @@ unsigned long long object_generator::get_key_index(int iter)
     return k;
 }
 
+// The n-th key after key_index within its hash tag group, wrapping around
+// the group, so the keys of a multi-key command share a cluster slot
+unsigned long long object_generator::get_group_key_index(unsigned long long key_index, unsigned int n)
+{
+    unsigned int group_size = m_key_names != NULL ? m_key_names->get_group_size() : 0;
+    if (!group_size) return key_index;
+
+    unsigned long long first = key_index - key_index % group_size;
+    unsigned long long last = first + group_size - 1;
+    if (first < m_key_min) first = m_key_min;
+    if (last > m_key_max) last = m_key_max;
+
+    return first + (key_index - first + n) % (last - first + 1);
+}
+
 void object_generator::generate_key(unsigned long long key_index)
 {
-    m_key_len = snprintf(m_key_buffer, sizeof(m_key_buffer) - 1, "%s%llu", m_key_prefix, key_index);
+    if (m_key_names != NULL) {
+        m_key_len = m_key_names->format(m_key_buffer, sizeof(m_key_buffer) - 1, key_index);
+    } else {
+        m_key_len = snprintf(m_key_buffer, sizeof(m_key_buffer) - 1, "%s%llu", m_key_prefix, key_index);
+    }
     m_key = m_key_buffer;
 }
 
@@ -449,6 +487,17 @@ const char *object_generator::get_value(unsigned long long key_index, unsigned i
         assert(0);
     }
 
+    // vary object content by sliding over the pre-generated buffer
+    if (m_random_data && m_immutable_values) {
+        const char *value = m_value_buffer + m_value_buffer_mutation_pos++;
+        if (m_value_buffer_mutation_pos >= VALUE_WINDOW_COUNT) {
+            m_value_buffer_mutation_pos = 0;
+        }
+
+        *len = new_size;
+        return value;
+    }
+
     // modify object content in case of random data
     if (m_random_data) {
         m_value_buffer[m_value_buffer_mutation_pos++]++;
@@ -24,6 +24,7 @@
 
 struct random_data;
 struct config_weight_list;
+struct key_template;
 
 class random_generator
 {
@@ -62,6 +63,8 @@ private:
 #define OBJECT_GENERATOR_KEY_GAUSSIAN -2
 #define OBJECT_GENERATOR_KEY_ZIPFIAN -3
 
+#define VALUE_WINDOW_COUNT 4096 /* distinct immutable random values per generator */
+
 class object_generator
 {
 public:
@@ -87,9 +90,11 @@ protected:
     } m_data_size;
     const char *m_data_size_pattern;
     bool m_random_data;
+    bool m_immutable_values;
     unsigned int m_expiry_min;
     unsigned int m_expiry_max;
     const char *m_key_prefix;
+    const key_template *m_key_names;
     unsigned long long m_key_min;
     unsigned long long m_key_max;
     double m_key_stddev;
@@ -133,18 +138,23 @@ public:
     unsigned long long zipf_distribution();
 
     void set_random_data(bool random_data);
+    void set_immutable_values(bool immutable_values);
     void set_data_size_fixed(unsigned int size);
     void set_data_size_range(unsigned int size_min, unsigned int size_max);
     void set_data_size_list(config_weight_list *data_size_list);
     void set_data_size_pattern(const char *pattern);
     void set_expiry_range(unsigned int expiry_min, unsigned int expiry_max);
     void set_key_prefix(const char *key_prefix);
+    void set_key_names(const key_template *key_names);
     void set_key_range(unsigned long long key_min, unsigned long long key_max);
+    unsigned long long get_key_min() { return m_key_min; }
+    unsigned long long get_key_max() { return m_key_max; }
     void set_key_distribution(double key_stddev, double key_median);
     void set_key_zipf_distribution(double key_exp);
     void set_random_seed(int seed);
     void fill_value_buffer();
     unsigned long long get_key_index(int iter);
+    unsigned long long get_group_key_index(unsigned long long key_index, unsigned int n);
     void generate_key(unsigned long long key_index);
     const char *get_key() { return m_key; }
     int get_key_len() { return m_key_len; }
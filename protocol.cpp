@@ -23,17 +23,23 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #ifdef HAVE_ASSERT_H
 #include <assert.h>
 #endif
 
+#include <algorithm>
+
 #include "protocol.h"
 #include "memtier_benchmark.h"
 #include "libmemcached_protocol/binary.h"
 
 /////////////////////////////////////////////////////////////////////////
 
-abstract_protocol::abstract_protocol() : m_read_buf(NULL), m_write_buf(NULL), m_keep_value(false) {}
+abstract_protocol::abstract_protocol() :
+        m_read_buf(NULL), m_write_buf(NULL), m_keep_value(false), m_value_ref_threshold(0)
+{
+}
 
 abstract_protocol::~abstract_protocol() {}
 
@@ -48,10 +54,27 @@ void abstract_protocol::set_keep_value(bool flag)
     m_keep_value = flag;
 }
 
+void abstract_protocol::set_value_ref_threshold(unsigned int threshold)
+{
+    m_value_ref_threshold = threshold;
+}
+
+// Values at or above the threshold are attached to the write buffer by
+// reference rather than copied.  The caller guarantees the value memory
+// stays untouched until the buffer is drained or freed.
+void abstract_protocol::add_value(const char *value, unsigned int value_len)
+{
+    if (m_value_ref_threshold > 0 && value_len >= m_value_ref_threshold) {
+        evbuffer_add_reference(m_write_buf, value, value_len, NULL, NULL);
+    } else {
+        evbuffer_add(m_write_buf, value, value_len);
+    }
+}
+
 /////////////////////////////////////////////////////////////////////////
 
 protocol_response::protocol_response() :
-        m_status(NULL), m_mbulk_value(NULL), m_value(NULL), m_value_len(0), m_hits(0), m_error(false)
+        m_status(NULL), m_mbulk_value(NULL), m_value(NULL), m_value_len(0), m_hits(0), m_error(false), m_push(false)
 {
 }
 
@@ -70,6 +93,16 @@ bool protocol_response::is_error(void)
     return m_error;
 }
 
+void protocol_response::set_push()
+{
+    m_push = true;
+}
+
+bool protocol_response::is_push(void)
+{
+    return m_push;
+}
+
 void protocol_response::set_status(const char *status)
 {
     if (m_status != NULL) free((void *) m_status);
@@ -135,6 +168,7 @@ void protocol_response::clear(void)
     m_total_len = 0;
     m_hits = 0;
     m_error = 0;
+    m_push = false;
 }
 
 void protocol_response::set_mbulk_value(mbulk_size_el *element)
@@ -161,6 +195,7 @@ protected:
     };
     response_state m_response_state;
     long m_bulk_len;
+    size_t m_bulk_left; // bytes of the current bulk, CRLF included, not read yet
     size_t m_response_len;
 
     unsigned int m_total_bulks_count;
@@ -172,11 +207,18 @@ protected:
     bool blob_type(char c);
     bool single_type(char c);
     bool response_ended();
+    bool keep_value() { return m_keep_value || m_last_response.is_push(); }
+    int write_bulk(const char *value, int value_len);
+    int write_timestamped_message(const char *message, int message_len, unsigned long long sent_usec);
+    int write_processing_list(const char *queue, int queue_len);
+    int write_value(const char *value, int value_len);
+    int write_member(unsigned int index, const char *value, int value_len);
 
 public:
     redis_protocol() :
             m_response_state(rs_initial),
             m_bulk_len(0),
+            m_bulk_left(0),
             m_response_len(0),
             m_total_bulks_count(0),
             m_current_mbulk(NULL),
@@ -189,12 +231,34 @@ public:
     virtual int authenticate(const char *credentials);
     virtual int configure_protocol(enum PROTOCOL_TYPE type);
     virtual int write_command_cluster_slots();
+    virtual int write_command_client_tracking();
+    virtual int write_command_readonly();
     virtual int write_command_set(const char *key, int key_len, const char *value, int value_len, int expiry,
                                   unsigned int offset);
     virtual int write_command_get(const char *key, int key_len, unsigned int offset);
     virtual int write_command_multi_get(const keylist *keylist);
     virtual int write_command_wait(unsigned int num_slaves, unsigned int timeout);
+    virtual int write_command_publish(const char *channel, int channel_len, const char *message, int message_len,
+                                      unsigned long long sent_usec, bool sharded);
+    virtual int write_command_subscribe(const char *channel, int channel_len, bool sharded);
+    virtual int write_command_xadd(const char *stream, int stream_len, const char *message, int message_len,
+                                   unsigned long long sent_usec);
+    virtual int write_command_xgroup_create(const char *stream, int stream_len, const char *group);
+    virtual int write_command_xreadgroup(const char *stream, int stream_len, const char *group, const char *consumer,
+                                         unsigned int count, unsigned int block_msec);
+    virtual int write_command_xack(const char *stream, int stream_len, const char *group, const keylist *ids);
+    virtual int write_command_script_load(const char *script, int script_len);
+    virtual int write_command_queue_push(const char *queue, int queue_len, const char *message, int message_len,
+                                         unsigned long long sent_usec, bool sorted);
+    virtual int write_command_queue_pop(const char *queue, int queue_len, enum QUEUE_POP_TYPE pop, double timeout);
+    virtual int write_command_queue_ack(const char *queue, int queue_len, const char *message, int message_len);
+    virtual int write_command_collection_write(enum DATA_TYPE type, const char *key, int key_len, const char *value,
+                                               int value_len, unsigned int fields, const unsigned int *scores);
+    virtual int write_command_collection_read(enum DATA_TYPE type, const char *key, int key_len, unsigned int first,
+                                              unsigned int count);
+    virtual int write_command_list_trim(const char *key, int key_len, unsigned int length);
     virtual int parse_response(void);
+    virtual bool in_response(void) { return m_response_state != rs_initial; }
 
     // handle arbitrary command
     virtual bool format_arbitrary_command(arbitrary_command &cmd);
@@ -300,6 +364,37 @@ int redis_protocol::write_command_cluster_slots()
     return size;
 }
 
+int redis_protocol::write_command_client_tracking()
+{
+    int size = 0;
+
+    size = evbuffer_add(m_write_buf,
+                        "*3\r\n"
+                        "$6\r\n"
+                        "CLIENT\r\n"
+                        "$8\r\n"
+                        "TRACKING\r\n"
+                        "$2\r\n"
+                        "ON\r\n",
+                        38);
+
+    return size;
+}
+
+// lets a cluster replica serve reads of the slots of its primary
+int redis_protocol::write_command_readonly()
+{
+    int size = 0;
+
+    size = evbuffer_add(m_write_buf,
+                        "*1\r\n"
+                        "$8\r\n"
+                        "READONLY\r\n",
+                        18);
+
+    return size;
+}
+
 int redis_protocol::write_command_set(const char *key, int key_len, const char *value, int value_len, int expiry,
                                       unsigned int offset)
 {
@@ -359,7 +454,7 @@ int redis_protocol::write_command_set(const char *key, int key_len, const char *
                                     "$%u\r\n",
                                     (unsigned int) strlen(expiry_str), expiry_str, value_len);
     }
-    evbuffer_add(m_write_buf, value, value_len);
+    add_value(value, value_len);
     evbuffer_add(m_write_buf, "\r\n", 2);
     size += value_len + 2;
 
@@ -368,8 +463,31 @@ int redis_protocol::write_command_set(const char *key, int key_len, const char *
 
 int redis_protocol::write_command_multi_get(const keylist *keylist)
 {
-    fprintf(stderr, "error: multi get not implemented for redis yet!\n");
-    assert(0);
+    assert(keylist != NULL);
+    assert(keylist->get_keys_count() > 0);
+
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*%u\r\n"
+                               "$4\r\n"
+                               "MGET\r\n",
+                               keylist->get_keys_count() + 1);
+
+    for (unsigned int i = 0; i < keylist->get_keys_count(); i++) {
+        const char *key;
+        unsigned int key_len;
+
+        key = keylist->get_key(i, &key_len);
+        assert(key != NULL);
+
+        size += evbuffer_add_printf(m_write_buf, "$%u\r\n", key_len);
+        evbuffer_add(m_write_buf, key, key_len);
+        evbuffer_add(m_write_buf, "\r\n", 2);
+        size += key_len + 2;
+    }
+
+    return size;
 }
 
 int redis_protocol::write_command_get(const char *key, int key_len, unsigned int offset)
@@ -444,11 +562,471 @@ int redis_protocol::write_command_wait(unsigned int num_slaves, unsigned int tim
     return size;
 }
 
+int redis_protocol::write_bulk(const char *value, int value_len)
+{
+    int size = evbuffer_add_printf(m_write_buf, "$%u\r\n", value_len);
+    evbuffer_add(m_write_buf, value, value_len);
+    evbuffer_add(m_write_buf, "\r\n", 2);
+
+    return size + value_len + 2;
+}
+
+// the send time replaces the head of the message, which keeps its size
+int redis_protocol::write_timestamped_message(const char *message, int message_len, unsigned long long sent_usec)
+{
+    int payload_len = message_len > MESSAGE_TIMESTAMP_LEN ? message_len : MESSAGE_TIMESTAMP_LEN;
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "$%u\r\n"
+                               "%016llx",
+                               payload_len, sent_usec);
+    if (message_len > MESSAGE_TIMESTAMP_LEN) {
+        add_value(message + MESSAGE_TIMESTAMP_LEN, message_len - MESSAGE_TIMESTAMP_LEN);
+        size += message_len - MESSAGE_TIMESTAMP_LEN;
+    }
+    evbuffer_add(m_write_buf, "\r\n", 2);
+    size += 2;
+
+    return size;
+}
+
+int redis_protocol::write_command_publish(const char *channel, int channel_len, const char *message, int message_len,
+                                          unsigned long long sent_usec, bool sharded)
+{
+    assert(channel != NULL);
+    assert(channel_len > 0);
+    const char *cmd = sharded ? "SPUBLISH" : "PUBLISH";
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*3\r\n"
+                               "$%u\r\n"
+                               "%s\r\n",
+                               (unsigned int) strlen(cmd), cmd);
+    size += write_bulk(channel, channel_len);
+    size += write_timestamped_message(message, message_len, sent_usec);
+
+    return size;
+}
+
+int redis_protocol::write_command_subscribe(const char *channel, int channel_len, bool sharded)
+{
+    assert(channel != NULL);
+    assert(channel_len > 0);
+    const char *cmd = sharded ? "SSUBSCRIBE" : "SUBSCRIBE";
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*2\r\n"
+                               "$%u\r\n"
+                               "%s\r\n"
+                               "$%u\r\n",
+                               (unsigned int) strlen(cmd), cmd, channel_len);
+    evbuffer_add(m_write_buf, channel, channel_len);
+    evbuffer_add(m_write_buf, "\r\n", 2);
+    size += channel_len + 2;
+
+    return size;
+}
+
+// XADD stream * data <message>, the entry's only field carries the timestamped message
+int redis_protocol::write_command_xadd(const char *stream, int stream_len, const char *message, int message_len,
+                                       unsigned long long sent_usec)
+{
+    assert(stream != NULL);
+    assert(stream_len > 0);
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*5\r\n"
+                               "$4\r\n"
+                               "XADD\r\n");
+    size += write_bulk(stream, stream_len);
+    size += evbuffer_add_printf(m_write_buf,
+                                "$1\r\n"
+                                "*\r\n"
+                                "$4\r\n"
+                                "data\r\n");
+    size += write_timestamped_message(message, message_len, sent_usec);
+
+    return size;
+}
+
+// XGROUP CREATE stream group $ MKSTREAM, the group only sees entries added from now on
+int redis_protocol::write_command_xgroup_create(const char *stream, int stream_len, const char *group)
+{
+    assert(stream != NULL);
+    assert(stream_len > 0);
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*6\r\n"
+                               "$6\r\n"
+                               "XGROUP\r\n"
+                               "$6\r\n"
+                               "CREATE\r\n");
+    size += write_bulk(stream, stream_len);
+    size += write_bulk(group, strlen(group));
+    size += evbuffer_add_printf(m_write_buf,
+                                "$1\r\n"
+                                "$\r\n"
+                                "$8\r\n"
+                                "MKSTREAM\r\n");
+
+    return size;
+}
+
+// XREADGROUP GROUP group consumer COUNT count [BLOCK block_msec] STREAMS stream >
+int redis_protocol::write_command_xreadgroup(const char *stream, int stream_len, const char *group,
+                                             const char *consumer, unsigned int count, unsigned int block_msec)
+{
+    assert(stream != NULL);
+    assert(stream_len > 0);
+    char num[32];
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*%u\r\n"
+                               "$10\r\n"
+                               "XREADGROUP\r\n"
+                               "$5\r\n"
+                               "GROUP\r\n",
+                               block_msec > 0 ? 11 : 9);
+    size += write_bulk(group, strlen(group));
+    size += write_bulk(consumer, strlen(consumer));
+    size += evbuffer_add_printf(m_write_buf,
+                                "$5\r\n"
+                                "COUNT\r\n");
+    size += write_bulk(num, snprintf(num, sizeof(num), "%u", count));
+    if (block_msec > 0) {
+        size += evbuffer_add_printf(m_write_buf,
+                                    "$5\r\n"
+                                    "BLOCK\r\n");
+        size += write_bulk(num, snprintf(num, sizeof(num), "%u", block_msec));
+    }
+    size += evbuffer_add_printf(m_write_buf,
+                                "$7\r\n"
+                                "STREAMS\r\n");
+    size += write_bulk(stream, stream_len);
+    size += evbuffer_add_printf(m_write_buf,
+                                "$1\r\n"
+                                ">\r\n");
+
+    return size;
+}
+
+// XACK stream group id [id ...]
+int redis_protocol::write_command_xack(const char *stream, int stream_len, const char *group, const keylist *ids)
+{
+    assert(stream != NULL);
+    assert(stream_len > 0);
+    assert(ids->get_keys_count() > 0);
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*%u\r\n"
+                               "$4\r\n"
+                               "XACK\r\n",
+                               ids->get_keys_count() + 3);
+    size += write_bulk(stream, stream_len);
+    size += write_bulk(group, strlen(group));
+    for (unsigned int i = 0; i < ids->get_keys_count(); i++) {
+        unsigned int id_len;
+        const char *id = ids->get_key(i, &id_len);
+        size += write_bulk(id, id_len);
+    }
+
+    return size;
+}
+
+int redis_protocol::write_command_script_load(const char *script, int script_len)
+{
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*3\r\n"
+                               "$6\r\n"
+                               "SCRIPT\r\n"
+                               "$4\r\n"
+                               "LOAD\r\n");
+    size += write_bulk(script, script_len);
+
+    return size;
+}
+
+// LPUSH queue <message>, or ZADD queue <sent_usec> <message> for a sorted set
+// queue, where the oldest message has the lowest score
+int redis_protocol::write_command_queue_push(const char *queue, int queue_len, const char *message, int message_len,
+                                             unsigned long long sent_usec, bool sorted)
+{
+    assert(queue != NULL);
+    assert(queue_len > 0);
+    char num[32];
+    int size = 0;
+
+    if (sorted) {
+        size = evbuffer_add_printf(m_write_buf,
+                                   "*4\r\n"
+                                   "$4\r\n"
+                                   "ZADD\r\n");
+        size += write_bulk(queue, queue_len);
+        size += write_bulk(num, snprintf(num, sizeof(num), "%llu", sent_usec));
+    } else {
+        size = evbuffer_add_printf(m_write_buf,
+                                   "*3\r\n"
+                                   "$5\r\n"
+                                   "LPUSH\r\n");
+        size += write_bulk(queue, queue_len);
+    }
+    size += write_timestamped_message(message, message_len, sent_usec);
+
+    return size;
+}
+
+// BLMOVE moves each message to a processing list of the same slot: a queue
+// with a hash tag keeps it, any other is wrapped in one
+int redis_protocol::write_processing_list(const char *queue, int queue_len)
+{
+    const char *suffix = ":processing";
+    int suffix_len = strlen(suffix);
+    bool tagged = memchr(queue, '{', queue_len) != NULL;
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf, "$%u\r\n", queue_len + suffix_len + (tagged ? 0 : 2));
+    if (!tagged) evbuffer_add(m_write_buf, "{", 1);
+    evbuffer_add(m_write_buf, queue, queue_len);
+    if (!tagged) evbuffer_add(m_write_buf, "}", 1);
+    evbuffer_add_printf(m_write_buf, "%s\r\n", suffix);
+
+    return size + queue_len + suffix_len + (tagged ? 0 : 2) + 2;
+}
+
+// BRPOP/BLPOP/BZPOPMIN queue timeout, or BLMOVE queue processing RIGHT LEFT timeout
+int redis_protocol::write_command_queue_pop(const char *queue, int queue_len, enum QUEUE_POP_TYPE pop,
+                                            double timeout)
+{
+    assert(queue != NULL);
+    assert(queue_len > 0);
+    const char *cmd = get_queue_pop_name(pop);
+    char num[32];
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*%u\r\n"
+                               "$%u\r\n"
+                               "%s\r\n",
+                               pop == QUEUE_POP_BLMOVE ? 6 : 3, (unsigned int) strlen(cmd), cmd);
+    size += write_bulk(queue, queue_len);
+    if (pop == QUEUE_POP_BLMOVE) {
+        size += write_processing_list(queue, queue_len);
+        size += evbuffer_add_printf(m_write_buf,
+                                    "$5\r\n"
+                                    "RIGHT\r\n"
+                                    "$4\r\n"
+                                    "LEFT\r\n");
+    }
+    size += write_bulk(num, snprintf(num, sizeof(num), "%g", timeout));
+
+    return size;
+}
+
+// LREM processing 1 <message>, acknowledges a message moved by BLMOVE
+int redis_protocol::write_command_queue_ack(const char *queue, int queue_len, const char *message, int message_len)
+{
+    assert(queue != NULL);
+    assert(queue_len > 0);
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*4\r\n"
+                               "$4\r\n"
+                               "LREM\r\n");
+    size += write_processing_list(queue, queue_len);
+    size += evbuffer_add_printf(m_write_buf,
+                                "$1\r\n"
+                                "1\r\n");
+    size += write_bulk(message, message_len);
+
+    return size;
+}
+
+// like write_bulk, subject to the zero-copy threshold
+int redis_protocol::write_value(const char *value, int value_len)
+{
+    int size = evbuffer_add_printf(m_write_buf, "$%u\r\n", value_len);
+    add_value(value, value_len);
+    evbuffer_add(m_write_buf, "\r\n", 2);
+
+    return size + value_len + 2;
+}
+
+// a set or sorted set member is the value, prefixed by its index to keep the
+// members distinct
+int redis_protocol::write_member(unsigned int index, const char *value, int value_len)
+{
+    char prefix[16];
+    int prefix_len = snprintf(prefix, sizeof(prefix), "%u:", index);
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "$%u\r\n"
+                               "%s",
+                               prefix_len + value_len, prefix);
+    add_value(value, value_len);
+    evbuffer_add(m_write_buf, "\r\n", 2);
+
+    return size + value_len + 2;
+}
+
+// Writes fields fields, members or elements, all carrying the value:
+// HSET key field:<i> value ..., SADD key <i>:value ..., ZADD key score
+// <i>:value ... or RPUSH key value ...
+int redis_protocol::write_command_collection_write(enum DATA_TYPE type, const char *key, int key_len,
+                                                   const char *value, int value_len, unsigned int fields,
+                                                   const unsigned int *scores)
+{
+    assert(key != NULL);
+    assert(key_len > 0);
+    assert(type != DATA_TYPE_STRING);
+    const char *cmd = "RPUSH";
+    if (type == DATA_TYPE_HASH)
+        cmd = "HSET";
+    else if (type == DATA_TYPE_SET)
+        cmd = "SADD";
+    else if (type == DATA_TYPE_ZSET)
+        cmd = "ZADD";
+    bool pairs = type == DATA_TYPE_HASH || type == DATA_TYPE_ZSET;
+    char num[32];
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*%u\r\n"
+                               "$%u\r\n"
+                               "%s\r\n",
+                               2 + fields * (pairs ? 2 : 1), (unsigned int) strlen(cmd), cmd);
+    size += write_bulk(key, key_len);
+    for (unsigned int i = 0; i < fields; i++) {
+        switch (type) {
+        case DATA_TYPE_HASH:
+            size += write_bulk(num, snprintf(num, sizeof(num), "field:%u", i));
+            size += write_value(value, value_len);
+            break;
+        case DATA_TYPE_SET:
+            size += write_member(i, value, value_len);
+            break;
+        case DATA_TYPE_ZSET:
+            assert(scores != NULL);
+            size += write_bulk(num, snprintf(num, sizeof(num), "%u", scores[i]));
+            size += write_member(i, value, value_len);
+            break;
+        default:
+            size += write_value(value, value_len);
+            break;
+        }
+    }
+
+    return size;
+}
+
+// Reads count fields from first on, or the whole object when count is 0:
+// HMGET/HGETALL, SRANDMEMBER/SMEMBERS, ZRANGEBYSCORE or LRANGE
+int redis_protocol::write_command_collection_read(enum DATA_TYPE type, const char *key, int key_len,
+                                                  unsigned int first, unsigned int count)
+{
+    assert(key != NULL);
+    assert(key_len > 0);
+    char num[32];
+    int size = 0;
+
+    switch (type) {
+    case DATA_TYPE_HASH:
+        if (count == 0) {
+            size = evbuffer_add_printf(m_write_buf,
+                                       "*2\r\n"
+                                       "$7\r\n"
+                                       "HGETALL\r\n");
+            size += write_bulk(key, key_len);
+            break;
+        }
+        size = evbuffer_add_printf(m_write_buf,
+                                   "*%u\r\n"
+                                   "$5\r\n"
+                                   "HMGET\r\n",
+                                   2 + count);
+        size += write_bulk(key, key_len);
+        for (unsigned int i = first; i < first + count; i++) {
+            size += write_bulk(num, snprintf(num, sizeof(num), "field:%u", i));
+        }
+        break;
+    case DATA_TYPE_SET:
+        size = evbuffer_add_printf(m_write_buf,
+                                   "*%u\r\n"
+                                   "$%u\r\n"
+                                   "%s\r\n",
+                                   count == 0 ? 2 : 3, count == 0 ? 8 : 11, count == 0 ? "SMEMBERS" : "SRANDMEMBER");
+        size += write_bulk(key, key_len);
+        if (count > 0) size += write_bulk(num, snprintf(num, sizeof(num), "%u", count));
+        break;
+    case DATA_TYPE_ZSET:
+        size = evbuffer_add_printf(m_write_buf,
+                                   "*4\r\n"
+                                   "$13\r\n"
+                                   "ZRANGEBYSCORE\r\n");
+        size += write_bulk(key, key_len);
+        if (count == 0) {
+            size += evbuffer_add_printf(m_write_buf,
+                                        "$4\r\n"
+                                        "-inf\r\n"
+                                        "$4\r\n"
+                                        "+inf\r\n");
+        } else {
+            size += write_bulk(num, snprintf(num, sizeof(num), "%u", first));
+            size += write_bulk(num, snprintf(num, sizeof(num), "%u", first + count - 1));
+        }
+        break;
+    case DATA_TYPE_LIST:
+        size = evbuffer_add_printf(m_write_buf,
+                                   "*4\r\n"
+                                   "$6\r\n"
+                                   "LRANGE\r\n");
+        size += write_bulk(key, key_len);
+        size += write_bulk(num, snprintf(num, sizeof(num), "%u", count == 0 ? 0 : first));
+        size += write_bulk(num, snprintf(num, sizeof(num), "%d", count == 0 ? -1 : (int) (first + count - 1)));
+        break;
+    default:
+        assert(0);
+    }
+
+    return size;
+}
+
+// LTRIM key -length -1, keeps the list at its last length elements
+int redis_protocol::write_command_list_trim(const char *key, int key_len, unsigned int length)
+{
+    assert(key != NULL);
+    assert(key_len > 0);
+    char num[32];
+    int size = 0;
+
+    size = evbuffer_add_printf(m_write_buf,
+                               "*4\r\n"
+                               "$5\r\n"
+                               "LTRIM\r\n");
+    size += write_bulk(key, key_len);
+    size += write_bulk(num, snprintf(num, sizeof(num), "-%u", length));
+    size += evbuffer_add_printf(m_write_buf,
+                                "$2\r\n"
+                                "-1\r\n");
+
+    return size;
+}
+
 bool redis_protocol::aggregate_type(char c)
 {
     if (c == '*') return true;
 
-    if (m_resp3 && (c == '%' || c == '~' || c == '|')) return true;
+    if (m_resp3 && (c == '%' || c == '~' || c == '|' || c == '>')) return true;
 
     return false;
 }
@@ -535,8 +1113,14 @@ int redis_protocol::parse_response(void)
                     count *= 2;
                 }
 
-                if (m_keep_value) {
-                    mbulk_size_el *new_mbulk_size = new mbulk_size_el();
+                // a push at the top level is out-of-band data (e.g. a tracking
+                // invalidation), its content is always kept for the client to inspect
+                if (line[0] == '>' && m_total_bulks_count == 0) {
+                    m_last_response.set_push();
+                }
+
+                if (keep_value()) {
+                    mbulk_size_el *new_mbulk_size = new mbulk_size_el();
                     new_mbulk_size->bulks_count = count;
                     new_mbulk_size->upper_level = m_current_mbulk;
 
@@ -577,6 +1161,7 @@ int redis_protocol::parse_response(void)
                 if (m_bulk_len < 0) {
                     m_response_state = rs_end_bulk;
                 } else {
+                    m_bulk_left = m_bulk_len + 2;
                     m_response_state = rs_read_bulk;
                 }
             } else if (single_type(line[0])) {
@@ -586,7 +1171,7 @@ int redis_protocol::parse_response(void)
                 }
 
                 // if we are not inside mbulk, the status will be kept in m_status anyway
-                if (m_keep_value && m_current_mbulk) {
+                if (keep_value() && m_current_mbulk) {
                     char *bulk_value = strdup(line);
                     assert(bulk_value != NULL);
 
@@ -616,7 +1201,22 @@ int redis_protocol::parse_response(void)
             }
             break;
         case rs_read_bulk:
-            if (evbuffer_get_length(m_read_buf) >= (unsigned long) (m_bulk_len + 2)) {
+            if (!keep_value()) {
+                /*
+                 * a value we don't keep is drained as it arrives, so large
+                 * replies don't pile up in the read buffer
+                 */
+                size_t len = std::min(evbuffer_get_length(m_read_buf), m_bulk_left);
+                if (len > 0) {
+                    int ret = evbuffer_drain(m_read_buf, len);
+                    assert(ret != -1);
+                    m_bulk_left -= len;
+                }
+            } else if (evbuffer_get_length(m_read_buf) >= m_bulk_left) {
+                m_bulk_left = 0;
+            }
+
+            if (m_bulk_left == 0) {
                 m_response_len += m_bulk_len + 2;
 
                 /*
@@ -637,7 +1237,7 @@ int redis_protocol::parse_response(void)
             }
             break;
         case rs_end_bulk:
-            if (m_keep_value) {
+            if (keep_value()) {
                 /*
                  * keep bulk value - in case we need to save bulk value it depends
                  * if it's inside a mbulk or not.
@@ -674,12 +1274,6 @@ int redis_protocol::parse_response(void)
                     // negative bulk len counted as empty bulk
                     m_last_response.set_value(bulk_value, m_bulk_len > 0 ? m_bulk_len : 0);
                 }
-            } else {
-                // just drain the buffer, include the CRLF
-                if (m_bulk_len >= 0) {
-                    int ret = evbuffer_drain(m_read_buf, m_bulk_len + 2);
-                    assert(ret != -1);
-                }
             }
 
             m_total_bulks_count--;
@@ -720,44 +1314,138 @@ int redis_protocol::write_arbitrary_command(const char *rand_val, int rand_val_l
     return size;
 }
 
+/*
+ * Sets the type of an arbitrary command argument from the placeholders it
+ * contains; shared by the protocols that support arbitrary commands.
+ */
+static bool classify_arbitrary_arg(arbitrary_command &cmd, command_arg *current_arg)
+{
+    current_arg->type = const_type;
+
+    if (current_arg->data.find(KEY_PLACEHOLDER) != std::string::npos) {
+        if (current_arg->data.length() != strlen(KEY_PLACEHOLDER)) {
+            current_arg->has_key_affixes = true;
+            current_arg->data_prefix = current_arg->data.substr(0, current_arg->data.find(KEY_PLACEHOLDER));
+            current_arg->data_suffix =
+                current_arg->data.substr(current_arg->data.find(KEY_PLACEHOLDER) + strlen(KEY_PLACEHOLDER));
+        }
+        cmd.keys_count++;
+        current_arg->type = key_type;
+    } else if (current_arg->data.find(DATA_PLACEHOLDER) != std::string::npos) {
+        if (current_arg->data.length() != strlen(DATA_PLACEHOLDER)) {
+            benchmark_error_log("error: data placeholder can't combined with other data\n");
+            return false;
+        }
+
+        current_arg->type = data_type;
+    } else if (current_arg->data == SCAN_CURSOR_PLACEHOLDER) {
+        current_arg->type = scan_cursor_type;
+    }
+
+    return true;
+}
+
+// SHA1 of a script, in hex as used by EVALSHA
+static std::string script_sha1(const std::string &script)
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string msg = script;
+    uint64_t bits = (uint64_t) script.length() * 8;
+
+    msg += (char) 0x80;
+    while (msg.length() % 64 != 56)
+        msg += (char) 0;
+    for (int i = 7; i >= 0; i--)
+        msg += (char) (bits >> (i * 8));
+
+    for (size_t chunk = 0; chunk < msg.length(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const unsigned char *b = (const unsigned char *) msg.data() + chunk + i * 4;
+            w[i] = ((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) | ((uint32_t) b[2] << 8) | b[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            uint32_t v = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+            w[i] = (v << 1) | (v >> 31);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = (b << 30) | (b >> 2);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    char hex[41];
+    for (int i = 0; i < 5; i++)
+        snprintf(hex + i * 8, 9, "%08x", h[i]);
+    return std::string(hex, 40);
+}
+
 bool redis_protocol::format_arbitrary_command(arbitrary_command &cmd)
 {
+    // EVAL with a literal script is sent as EVALSHA, the script itself is
+    // loaded when connecting (and again on NOSCRIPT)
+    for (unsigned int i = 0; i < cmd.command_args.size(); i++) {
+        command_arg *name = &cmd.command_args[i];
+        if (name->args_count < 3 || strcasecmp(name->data.c_str(), "EVAL") != 0) continue;
+
+        command_arg *script = &cmd.command_args[i + 1];
+        if (script->data.find(KEY_PLACEHOLDER) != std::string::npos ||
+            script->data.find(DATA_PLACEHOLDER) != std::string::npos) {
+            continue;
+        }
+
+        if (std::find(cmd.scripts.begin(), cmd.scripts.end(), script->data) == cmd.scripts.end()) {
+            cmd.scripts.push_back(script->data);
+        }
+        name->data = "EVALSHA";
+        script->data = script_sha1(script->data);
+    }
+
     for (unsigned int i = 0; i < cmd.command_args.size(); i++) {
         command_arg *current_arg = &cmd.command_args[i];
-        current_arg->type = const_type;
 
         // check arg type
-        if (current_arg->data.find(KEY_PLACEHOLDER) != std::string::npos) {
-            if (current_arg->data.length() != strlen(KEY_PLACEHOLDER)) {
-                current_arg->has_key_affixes = true;
-                current_arg->data_prefix = current_arg->data.substr(0, current_arg->data.find(KEY_PLACEHOLDER));
-                current_arg->data_suffix =
-                    current_arg->data.substr(current_arg->data.find(KEY_PLACEHOLDER) + strlen(KEY_PLACEHOLDER));
-            }
-            cmd.keys_count++;
-            current_arg->type = key_type;
-        } else if (current_arg->data.find(DATA_PLACEHOLDER) != std::string::npos) {
-            if (current_arg->data.length() != strlen(DATA_PLACEHOLDER)) {
-                benchmark_error_log("error: data placeholder can't combined with other data\n");
-                return false;
-            }
+        if (!classify_arbitrary_arg(cmd, current_arg)) return false;
 
-            current_arg->type = data_type;
-        } else if (current_arg->data == SCAN_CURSOR_PLACEHOLDER) {
-            current_arg->type = scan_cursor_type;
+        // we expect that the first arg of each command is the COMMAND name
+        if (current_arg->args_count > 0 && current_arg->type != const_type) {
+            fprintf(stderr, "error: command name can't be a placeholder: %s\n", cmd.command.c_str());
+            return false;
         }
 
-        // we expect that first arg is the COMMAND name
-        assert(i != 0 || (i == 0 && current_arg->type == const_type && "first arg is not command name?"));
-
         if (current_arg->type == const_type) {
-            char buffer[20];
+            char buffer[40];
             int buffer_len;
 
-            // if it's first arg we add also the mbulk size
-            if (i == 0) {
-                buffer_len =
-                    snprintf(buffer, 20, "*%zd\r\n$%zd\r\n", cmd.command_args.size(), current_arg->data.length());
+            // if it's the command name we add also the mbulk size
+            if (current_arg->args_count > 0) {
+                buffer_len = snprintf(buffer, sizeof(buffer), "*%u\r\n$%zd\r\n", current_arg->args_count,
+                                      current_arg->data.length());
             } else {
                 buffer_len = snprintf(buffer, 20, "$%zd\r\n", current_arg->data.length());
             }
@@ -793,12 +1481,34 @@ public:
     virtual int authenticate(const char *credentials);
     virtual int configure_protocol(enum PROTOCOL_TYPE type);
     virtual int write_command_cluster_slots();
+    virtual int write_command_client_tracking();
+    virtual int write_command_readonly();
     virtual int write_command_set(const char *key, int key_len, const char *value, int value_len, int expiry,
                                   unsigned int offset);
     virtual int write_command_get(const char *key, int key_len, unsigned int offset);
     virtual int write_command_multi_get(const keylist *keylist);
     virtual int write_command_wait(unsigned int num_slaves, unsigned int timeout);
+    virtual int write_command_publish(const char *channel, int channel_len, const char *message, int message_len,
+                                      unsigned long long sent_usec, bool sharded);
+    virtual int write_command_subscribe(const char *channel, int channel_len, bool sharded);
+    virtual int write_command_xadd(const char *stream, int stream_len, const char *message, int message_len,
+                                   unsigned long long sent_usec);
+    virtual int write_command_xgroup_create(const char *stream, int stream_len, const char *group);
+    virtual int write_command_xreadgroup(const char *stream, int stream_len, const char *group, const char *consumer,
+                                         unsigned int count, unsigned int block_msec);
+    virtual int write_command_xack(const char *stream, int stream_len, const char *group, const keylist *ids);
+    virtual int write_command_script_load(const char *script, int script_len);
+    virtual int write_command_queue_push(const char *queue, int queue_len, const char *message, int message_len,
+                                         unsigned long long sent_usec, bool sorted);
+    virtual int write_command_queue_pop(const char *queue, int queue_len, enum QUEUE_POP_TYPE pop, double timeout);
+    virtual int write_command_queue_ack(const char *queue, int queue_len, const char *message, int message_len);
+    virtual int write_command_collection_write(enum DATA_TYPE type, const char *key, int key_len, const char *value,
+                                               int value_len, unsigned int fields, const unsigned int *scores);
+    virtual int write_command_collection_read(enum DATA_TYPE type, const char *key, int key_len, unsigned int first,
+                                              unsigned int count);
+    virtual int write_command_list_trim(const char *key, int key_len, unsigned int length);
     virtual int parse_response(void);
+    virtual bool in_response(void) { return m_response_state != rs_initial; }
 
     // handle arbitrary command
     virtual bool format_arbitrary_command(arbitrary_command &cmd);
@@ -826,6 +1536,16 @@ int memcache_text_protocol::write_command_cluster_slots()
     assert(0);
 }
 
+int memcache_text_protocol::write_command_client_tracking()
+{
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_readonly()
+{
+    assert(0);
+}
+
 int memcache_text_protocol::write_command_set(const char *key, int key_len, const char *value, int value_len,
                                               int expiry, unsigned int offset)
 {
@@ -836,7 +1556,7 @@ int memcache_text_protocol::write_command_set(const char *key, int key_len, cons
     int size = 0;
 
     size = evbuffer_add_printf(m_write_buf, "set %.*s 0 %u %u\r\n", key_len, key, expiry, value_len);
-    evbuffer_add(m_write_buf, value, value_len);
+    add_value(value, value_len);
     evbuffer_add(m_write_buf, "\r\n", 2);
     size += value_len + 2;
 
@@ -894,6 +1614,94 @@ int memcache_text_protocol::write_command_wait(unsigned int num_slaves, unsigned
     assert(0);
 }
 
+int memcache_text_protocol::write_command_publish(const char *channel, int channel_len, const char *message,
+                                int message_len, unsigned long long sent_usec, bool sharded)
+{
+    fprintf(stderr, "error: PUBLISH command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_subscribe(const char *channel, int channel_len, bool sharded)
+{
+    fprintf(stderr, "error: SUBSCRIBE command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_xadd(const char *stream, int stream_len, const char *message, int message_len,
+                                               unsigned long long sent_usec)
+{
+    fprintf(stderr, "error: XADD command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_xgroup_create(const char *stream, int stream_len, const char *group)
+{
+    fprintf(stderr, "error: XGROUP command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_xreadgroup(const char *stream, int stream_len, const char *group,
+                                                     const char *consumer, unsigned int count, unsigned int block_msec)
+{
+    fprintf(stderr, "error: XREADGROUP command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_xack(const char *stream, int stream_len, const char *group,
+                                               const keylist *ids)
+{
+    fprintf(stderr, "error: XACK command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_script_load(const char *script, int script_len)
+{
+    fprintf(stderr, "error: SCRIPT LOAD command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_queue_push(const char *queue, int queue_len, const char *message,
+                                                     int message_len, unsigned long long sent_usec, bool sorted)
+{
+    fprintf(stderr, "error: queue push command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_queue_pop(const char *queue, int queue_len, enum QUEUE_POP_TYPE pop,
+                                                    double timeout)
+{
+    fprintf(stderr, "error: blocking pop command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_queue_ack(const char *queue, int queue_len, const char *message,
+                                                    int message_len)
+{
+    fprintf(stderr, "error: LREM command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_collection_write(enum DATA_TYPE type, const char *key, int key_len,
+                                                           const char *value, int value_len, unsigned int fields,
+                                                           const unsigned int *scores)
+{
+    fprintf(stderr, "error: data types are not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_collection_read(enum DATA_TYPE type, const char *key, int key_len,
+                                                          unsigned int first, unsigned int count)
+{
+    fprintf(stderr, "error: data types are not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_text_protocol::write_command_list_trim(const char *key, int key_len, unsigned int length)
+{
+    fprintf(stderr, "error: LTRIM command not implemented for memcache!\n");
+    assert(0);
+}
+
 int memcache_text_protocol::parse_response(void)
 {
     char *line;
@@ -1009,22 +1817,45 @@ protected:
     response_state m_response_state;
     protocol_binary_response_no_extras m_response_hdr;
     size_t m_response_len;
+    bool m_quiet_batch; // collecting GETKQ hits until the terminating NOOP
 
     const char *status_text(void);
 
 public:
-    memcache_binary_protocol() : m_response_state(rs_initial), m_response_len(0) {}
+    memcache_binary_protocol() : m_response_state(rs_initial), m_response_len(0), m_quiet_batch(false) {}
     virtual memcache_binary_protocol *clone(void) { return new memcache_binary_protocol(); }
     virtual int select_db(int db);
     virtual int authenticate(const char *credentials);
     virtual int configure_protocol(enum PROTOCOL_TYPE type);
     virtual int write_command_cluster_slots();
+    virtual int write_command_client_tracking();
+    virtual int write_command_readonly();
     virtual int write_command_set(const char *key, int key_len, const char *value, int value_len, int expiry,
                                   unsigned int offset);
     virtual int write_command_get(const char *key, int key_len, unsigned int offset);
     virtual int write_command_multi_get(const keylist *keylist);
     virtual int write_command_wait(unsigned int num_slaves, unsigned int timeout);
+    virtual int write_command_publish(const char *channel, int channel_len, const char *message, int message_len,
+                                      unsigned long long sent_usec, bool sharded);
+    virtual int write_command_subscribe(const char *channel, int channel_len, bool sharded);
+    virtual int write_command_xadd(const char *stream, int stream_len, const char *message, int message_len,
+                                   unsigned long long sent_usec);
+    virtual int write_command_xgroup_create(const char *stream, int stream_len, const char *group);
+    virtual int write_command_xreadgroup(const char *stream, int stream_len, const char *group, const char *consumer,
+                                         unsigned int count, unsigned int block_msec);
+    virtual int write_command_xack(const char *stream, int stream_len, const char *group, const keylist *ids);
+    virtual int write_command_script_load(const char *script, int script_len);
+    virtual int write_command_queue_push(const char *queue, int queue_len, const char *message, int message_len,
+                                         unsigned long long sent_usec, bool sorted);
+    virtual int write_command_queue_pop(const char *queue, int queue_len, enum QUEUE_POP_TYPE pop, double timeout);
+    virtual int write_command_queue_ack(const char *queue, int queue_len, const char *message, int message_len);
+    virtual int write_command_collection_write(enum DATA_TYPE type, const char *key, int key_len, const char *value,
+                                               int value_len, unsigned int fields, const unsigned int *scores);
+    virtual int write_command_collection_read(enum DATA_TYPE type, const char *key, int key_len, unsigned int first,
+                                              unsigned int count);
+    virtual int write_command_list_trim(const char *key, int key_len, unsigned int length);
     virtual int parse_response(void);
+    virtual bool in_response(void) { return m_response_state != rs_initial || m_quiet_batch; }
 
     // handle arbitrary command
     virtual bool format_arbitrary_command(arbitrary_command &cmd);
@@ -1084,6 +1915,16 @@ int memcache_binary_protocol::write_command_cluster_slots()
     assert(0);
 }
 
+int memcache_binary_protocol::write_command_client_tracking()
+{
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_readonly()
+{
+    assert(0);
+}
+
 int memcache_binary_protocol::write_command_set(const char *key, int key_len, const char *value, int value_len,
                                                 int expiry, unsigned int offset)
 {
@@ -1105,7 +1946,7 @@ int memcache_binary_protocol::write_command_set(const char *key, int key_len, co
 
     evbuffer_add(m_write_buf, &req, sizeof(req));
     evbuffer_add(m_write_buf, key, key_len);
-    evbuffer_add(m_write_buf, value, value_len);
+    add_value(value, value_len);
 
     return sizeof(req) + key_len + value_len;
 }
@@ -1131,10 +1972,52 @@ int memcache_binary_protocol::write_command_get(const char *key, int key_len, un
     return sizeof(req) + key_len;
 }
 
+/*
+ * Multi-get is a pipeline of quiet GETKQ requests terminated by a NOOP.  The
+ * server only answers GETKQ for keys it has, and the NOOP answer tells us
+ * the batch is over; parse_response() folds all of it into one response.
+ */
 int memcache_binary_protocol::write_command_multi_get(const keylist *keylist)
 {
-    fprintf(stderr, "error: multi get not implemented for binary memcache yet!\n");
-    assert(0);
+    assert(keylist != NULL);
+    assert(keylist->get_keys_count() > 0);
+
+    protocol_binary_request_get req;
+    int size = 0;
+
+    memset(&req, 0, sizeof(req));
+    req.message.header.request.magic = PROTOCOL_BINARY_REQ;
+    req.message.header.request.opcode = PROTOCOL_BINARY_CMD_GETKQ;
+    req.message.header.request.datatype = PROTOCOL_BINARY_RAW_BYTES;
+    req.message.header.request.extlen = 0;
+
+    for (unsigned int i = 0; i < keylist->get_keys_count(); i++) {
+        const char *key;
+        unsigned int key_len;
+
+        key = keylist->get_key(i, &key_len);
+        assert(key != NULL);
+
+        req.message.header.request.keylen = htons(key_len);
+        req.message.header.request.bodylen = htonl(key_len);
+        req.message.header.request.opaque = htonl(i);
+
+        evbuffer_add(m_write_buf, &req, sizeof(req));
+        evbuffer_add(m_write_buf, key, key_len);
+        size += sizeof(req) + key_len;
+    }
+
+    protocol_binary_request_noop noop;
+
+    memset(&noop, 0, sizeof(noop));
+    noop.message.header.request.magic = PROTOCOL_BINARY_REQ;
+    noop.message.header.request.opcode = PROTOCOL_BINARY_CMD_NOOP;
+    noop.message.header.request.datatype = PROTOCOL_BINARY_RAW_BYTES;
+
+    evbuffer_add(m_write_buf, &noop, sizeof(noop));
+    size += sizeof(noop);
+
+    return size;
 }
 
 const char *memcache_binary_protocol::status_text(void)
@@ -1174,6 +2057,95 @@ int memcache_binary_protocol::write_command_wait(unsigned int num_slaves, unsign
     assert(0);
 }
 
+int memcache_binary_protocol::write_command_publish(const char *channel, int channel_len, const char *message,
+                                int message_len, unsigned long long sent_usec, bool sharded)
+{
+    fprintf(stderr, "error: PUBLISH command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_subscribe(const char *channel, int channel_len, bool sharded)
+{
+    fprintf(stderr, "error: SUBSCRIBE command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_xadd(const char *stream, int stream_len, const char *message,
+                                                 int message_len, unsigned long long sent_usec)
+{
+    fprintf(stderr, "error: XADD command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_xgroup_create(const char *stream, int stream_len, const char *group)
+{
+    fprintf(stderr, "error: XGROUP command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_xreadgroup(const char *stream, int stream_len, const char *group,
+                                                       const char *consumer, unsigned int count,
+                                                       unsigned int block_msec)
+{
+    fprintf(stderr, "error: XREADGROUP command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_xack(const char *stream, int stream_len, const char *group,
+                                                 const keylist *ids)
+{
+    fprintf(stderr, "error: XACK command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_script_load(const char *script, int script_len)
+{
+    fprintf(stderr, "error: SCRIPT LOAD command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_queue_push(const char *queue, int queue_len, const char *message,
+                                                       int message_len, unsigned long long sent_usec, bool sorted)
+{
+    fprintf(stderr, "error: queue push command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_queue_pop(const char *queue, int queue_len, enum QUEUE_POP_TYPE pop,
+                                                      double timeout)
+{
+    fprintf(stderr, "error: blocking pop command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_queue_ack(const char *queue, int queue_len, const char *message,
+                                                      int message_len)
+{
+    fprintf(stderr, "error: LREM command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_collection_write(enum DATA_TYPE type, const char *key, int key_len,
+                                                             const char *value, int value_len, unsigned int fields,
+                                                             const unsigned int *scores)
+{
+    fprintf(stderr, "error: data types are not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_collection_read(enum DATA_TYPE type, const char *key, int key_len,
+                                                            unsigned int first, unsigned int count)
+{
+    fprintf(stderr, "error: data types are not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_binary_protocol::write_command_list_trim(const char *key, int key_len, unsigned int length)
+{
+    fprintf(stderr, "error: LTRIM command not implemented for memcache!\n");
+    assert(0);
+}
+
 int memcache_binary_protocol::parse_response(void)
 {
     while (true) {
@@ -1192,8 +2164,17 @@ int memcache_binary_protocol::parse_response(void)
                 return -1;
             }
 
-            m_response_len = sizeof(m_response_hdr);
-            m_last_response.clear();
+            // a GETKQ batch accumulates hits and length up to its NOOP
+            if (m_quiet_batch) {
+                m_response_len += sizeof(m_response_hdr);
+            } else {
+                m_response_len = sizeof(m_response_hdr);
+                m_last_response.clear();
+            }
+            if (m_response_hdr.message.header.response.opcode == PROTOCOL_BINARY_CMD_NOOP) {
+                m_quiet_batch = false;
+            }
+
             if (status_text()) {
                 m_last_response.set_status(strdup(status_text()));
             }
@@ -1242,6 +2223,12 @@ int memcache_binary_protocol::parse_response(void)
                 m_response_len += m_response_hdr.message.header.response.bodylen;
                 m_response_state = rs_initial;
 
+                // a GETKQ answer is never the last one of its request, keep going until the NOOP
+                if (m_response_hdr.message.header.response.opcode == PROTOCOL_BINARY_CMD_GETKQ) {
+                    m_quiet_batch = true;
+                    continue;
+                }
+
                 return 1;
             } else {
                 return 0;
@@ -1273,12 +2260,474 @@ int memcache_binary_protocol::write_arbitrary_command(const char *val, int val_l
 
 /////////////////////////////////////////////////////////////////////////
 
+#define META_LINE_MAX 1024
+
+class memcache_meta_protocol : public abstract_protocol
+{
+protected:
+    enum response_state
+    {
+        rs_initial,
+        rs_read_line,
+        rs_read_value
+    };
+    response_state m_response_state;
+    unsigned int m_value_len;
+    size_t m_response_len;
+    bool m_quiet_batch; // collecting the answers of a multi-get until its closing MN
+
+    // ms value of the arbitrary command being written, sent after its command line
+    const char *m_pending_value;
+    int m_pending_value_len;
+
+public:
+    memcache_meta_protocol() :
+            m_response_state(rs_initial),
+            m_value_len(0),
+            m_response_len(0),
+            m_quiet_batch(false),
+            m_pending_value(NULL),
+            m_pending_value_len(0)
+    {
+    }
+    virtual memcache_meta_protocol *clone(void) { return new memcache_meta_protocol(); }
+    virtual int select_db(int db);
+    virtual int authenticate(const char *credentials);
+    virtual int configure_protocol(enum PROTOCOL_TYPE type);
+    virtual int write_command_cluster_slots();
+    virtual int write_command_client_tracking();
+    virtual int write_command_readonly();
+    virtual int write_command_set(const char *key, int key_len, const char *value, int value_len, int expiry,
+                                  unsigned int offset);
+    virtual int write_command_get(const char *key, int key_len, unsigned int offset);
+    virtual int write_command_multi_get(const keylist *keylist);
+    virtual int write_command_wait(unsigned int num_slaves, unsigned int timeout);
+    virtual int write_command_publish(const char *channel, int channel_len, const char *message, int message_len,
+                                      unsigned long long sent_usec, bool sharded);
+    virtual int write_command_subscribe(const char *channel, int channel_len, bool sharded);
+    virtual int write_command_xadd(const char *stream, int stream_len, const char *message, int message_len,
+                                   unsigned long long sent_usec);
+    virtual int write_command_xgroup_create(const char *stream, int stream_len, const char *group);
+    virtual int write_command_xreadgroup(const char *stream, int stream_len, const char *group, const char *consumer,
+                                         unsigned int count, unsigned int block_msec);
+    virtual int write_command_xack(const char *stream, int stream_len, const char *group, const keylist *ids);
+    virtual int write_command_script_load(const char *script, int script_len);
+    virtual int write_command_queue_push(const char *queue, int queue_len, const char *message, int message_len,
+                                         unsigned long long sent_usec, bool sorted);
+    virtual int write_command_queue_pop(const char *queue, int queue_len, enum QUEUE_POP_TYPE pop, double timeout);
+    virtual int write_command_queue_ack(const char *queue, int queue_len, const char *message, int message_len);
+    virtual int write_command_collection_write(enum DATA_TYPE type, const char *key, int key_len, const char *value,
+                                               int value_len, unsigned int fields, const unsigned int *scores);
+    virtual int write_command_collection_read(enum DATA_TYPE type, const char *key, int key_len, unsigned int first,
+                                              unsigned int count);
+    virtual int write_command_list_trim(const char *key, int key_len, unsigned int length);
+    virtual int parse_response(void);
+    virtual bool in_response(void) { return m_response_state != rs_initial || m_quiet_batch; }
+
+    // handle arbitrary command
+    virtual bool format_arbitrary_command(arbitrary_command &cmd);
+    virtual int write_arbitrary_command(const command_arg *arg);
+    virtual int write_arbitrary_command(const char *val, int val_len);
+    virtual int write_arbitrary_command(const command_arg *arg, const char *val, int val_len);
+};
+
+int memcache_meta_protocol::select_db(int db)
+{
+    assert(0);
+}
+
+int memcache_meta_protocol::authenticate(const char *credentials)
+{
+    assert(0);
+}
+
+int memcache_meta_protocol::configure_protocol(enum PROTOCOL_TYPE type)
+{
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_cluster_slots()
+{
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_client_tracking()
+{
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_readonly()
+{
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_set(const char *key, int key_len, const char *value, int value_len,
+                                              int expiry, unsigned int offset)
+{
+    assert(key != NULL);
+    assert(key_len > 0);
+    assert(value != NULL);
+    assert(value_len > 0);
+    int size = 0;
+
+    evbuffer_add(m_write_buf, "ms ", 3);
+    evbuffer_add(m_write_buf, key, key_len);
+    size = 3 + key_len;
+    if (expiry > 0) {
+        size += evbuffer_add_printf(m_write_buf, " %u T%u\r\n", value_len, expiry);
+    } else {
+        size += evbuffer_add_printf(m_write_buf, " %u\r\n", value_len);
+    }
+    add_value(value, value_len);
+    evbuffer_add(m_write_buf, "\r\n", 2);
+    size += value_len + 2;
+
+    return size;
+}
+
+int memcache_meta_protocol::write_command_get(const char *key, int key_len, unsigned int offset)
+{
+    assert(key != NULL);
+    assert(key_len > 0);
+
+    evbuffer_add(m_write_buf, "mg ", 3);
+    evbuffer_add(m_write_buf, key, key_len);
+    evbuffer_add(m_write_buf, " v\r\n", 4);
+
+    return 3 + key_len + 4;
+}
+
+/*
+ * Multi-get is a pipeline of quiet mg requests between two mn.  Misses of
+ * quiet requests are not answered, and nothing else tells the answers of a
+ * batch apart, errors included, so the first MN opens the batch and the
+ * second one closes it; parse_response() folds all of it into one response.
+ */
+int memcache_meta_protocol::write_command_multi_get(const keylist *keylist)
+{
+    assert(keylist != NULL);
+    assert(keylist->get_keys_count() > 0);
+
+    static const char flags[] = " v q\r\n";
+    int size = 0;
+
+    evbuffer_add(m_write_buf, "mn\r\n", 4);
+    size += 4;
+
+    for (unsigned int i = 0; i < keylist->get_keys_count(); i++) {
+        const char *key;
+        unsigned int key_len;
+
+        key = keylist->get_key(i, &key_len);
+        assert(key != NULL);
+
+        evbuffer_add(m_write_buf, "mg ", 3);
+        evbuffer_add(m_write_buf, key, key_len);
+        evbuffer_add(m_write_buf, flags, sizeof(flags) - 1);
+        size += 3 + key_len + sizeof(flags) - 1;
+    }
+
+    evbuffer_add(m_write_buf, "mn\r\n", 4);
+    size += 4;
+
+    return size;
+}
+
+int memcache_meta_protocol::write_command_wait(unsigned int num_slaves, unsigned int timeout)
+{
+    fprintf(stderr, "error: WAIT command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_publish(const char *channel, int channel_len, const char *message,
+                                int message_len, unsigned long long sent_usec, bool sharded)
+{
+    fprintf(stderr, "error: PUBLISH command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_subscribe(const char *channel, int channel_len, bool sharded)
+{
+    fprintf(stderr, "error: SUBSCRIBE command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_xadd(const char *stream, int stream_len, const char *message, int message_len,
+                                               unsigned long long sent_usec)
+{
+    fprintf(stderr, "error: XADD command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_xgroup_create(const char *stream, int stream_len, const char *group)
+{
+    fprintf(stderr, "error: XGROUP command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_xreadgroup(const char *stream, int stream_len, const char *group,
+                                                     const char *consumer, unsigned int count, unsigned int block_msec)
+{
+    fprintf(stderr, "error: XREADGROUP command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_xack(const char *stream, int stream_len, const char *group,
+                                               const keylist *ids)
+{
+    fprintf(stderr, "error: XACK command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_script_load(const char *script, int script_len)
+{
+    fprintf(stderr, "error: SCRIPT LOAD command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_queue_push(const char *queue, int queue_len, const char *message,
+                                                     int message_len, unsigned long long sent_usec, bool sorted)
+{
+    fprintf(stderr, "error: queue push command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_queue_pop(const char *queue, int queue_len, enum QUEUE_POP_TYPE pop,
+                                                    double timeout)
+{
+    fprintf(stderr, "error: blocking pop command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_queue_ack(const char *queue, int queue_len, const char *message,
+                                                    int message_len)
+{
+    fprintf(stderr, "error: LREM command not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_collection_write(enum DATA_TYPE type, const char *key, int key_len,
+                                                           const char *value, int value_len, unsigned int fields,
+                                                           const unsigned int *scores)
+{
+    fprintf(stderr, "error: data types are not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_collection_read(enum DATA_TYPE type, const char *key, int key_len,
+                                                          unsigned int first, unsigned int count)
+{
+    fprintf(stderr, "error: data types are not implemented for memcache!\n");
+    assert(0);
+}
+
+int memcache_meta_protocol::write_command_list_trim(const char *key, int key_len, unsigned int length)
+{
+    fprintf(stderr, "error: LTRIM command not implemented for memcache!\n");
+    assert(0);
+}
+
+/*
+ * Response lines are copied into a stack buffer instead of being allocated;
+ * only error lines are kept, as the response status.  An MN answers nothing
+ * but a multi-get, whose answers are read up to the closing MN, errors being
+ * recorded on the way.
+ */
+int memcache_meta_protocol::parse_response(void)
+{
+    while (true) {
+        switch (m_response_state) {
+        case rs_initial:
+            if (!m_quiet_batch) {
+                m_last_response.clear();
+                m_response_len = 0;
+            }
+            m_response_state = rs_read_line;
+            break;
+
+        case rs_read_line: {
+            size_t eol_len;
+            struct evbuffer_ptr eol = evbuffer_search_eol(m_read_buf, NULL, &eol_len, EVBUFFER_EOL_CRLF_STRICT);
+            if (eol.pos < 0) return 0;
+
+            if ((size_t) eol.pos >= META_LINE_MAX) {
+                benchmark_error_log("error: memcache meta response line too long.\n");
+                return -1;
+            }
+
+            char line[META_LINE_MAX];
+            int ret = evbuffer_remove(m_read_buf, line, eol.pos);
+            assert(ret == (int) eol.pos);
+            line[eol.pos] = '\0';
+            evbuffer_drain(m_read_buf, eol_len);
+            m_response_len += eol.pos + eol_len;
+
+            if (line[0] == 'V' && line[1] == 'A' && (line[2] == ' ' || line[2] == '\0')) {
+                m_value_len = strtoul(line + 2, NULL, 10);
+                m_response_state = rs_read_value;
+                continue;
+            }
+
+            if (line[0] == 'M' && line[1] == 'N') {
+                // opens or closes a multi-get
+                m_quiet_batch = !m_quiet_batch;
+                if (m_quiet_batch) continue;
+            } else if (memcmp(line, "HD", 2) != 0 && memcmp(line, "EN", 2) != 0 && memcmp(line, "NF", 2) != 0 &&
+                       memcmp(line, "NS", 2) != 0 && memcmp(line, "EX", 2) != 0 && memcmp(line, "ME", 2) != 0) {
+                // ERROR, CLIENT_ERROR, SERVER_ERROR or anything we don't know
+                m_last_response.set_status(strdup(line));
+                m_last_response.set_error();
+                if (memcmp(line, "ERROR", 5) != 0 && memcmp(line, "CLIENT_ERROR", 12) != 0 &&
+                    memcmp(line, "SERVER_ERROR", 12) != 0) {
+                    benchmark_debug_log("unknown response: %s\n", line);
+                    return -1;
+                }
+            }
+
+            // an error of a multi-get ends it only with its MN
+            if (m_quiet_batch) continue;
+
+            m_last_response.set_total_len(m_response_len);
+            m_response_state = rs_initial;
+            return 1;
+        }
+
+        case rs_read_value:
+            if (evbuffer_get_length(m_read_buf) < m_value_len + 2) return 0;
+
+            if (m_keep_value) {
+                char *value = (char *) malloc(m_value_len);
+                assert(value != NULL);
+
+                int ret = evbuffer_remove(m_read_buf, value, m_value_len);
+                assert((unsigned int) ret == m_value_len);
+
+                m_last_response.set_value(value, m_value_len);
+            } else {
+                int ret = evbuffer_drain(m_read_buf, m_value_len);
+                assert(ret == 0);
+            }
+
+            evbuffer_drain(m_read_buf, 2);
+            m_response_len += m_value_len + 2;
+            m_last_response.incr_hits();
+
+            // a multi-get hit is never the last answer of its request, keep going until the MN
+            if (m_quiet_batch) {
+                m_response_state = rs_read_line;
+                continue;
+            }
+
+            m_last_response.set_total_len(m_response_len);
+            m_response_state = rs_initial;
+            return 1;
+
+        default:
+            benchmark_debug_log("unknown response state %d.\n", m_response_state);
+            return -1;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Meta commands are space separated tokens on one line.  Const tokens get
+ * their separator here and a final "\r\n" token ends the line.  A data
+ * placeholder must directly follow the key, where ms expects the value
+ * length; the value itself is sent after the line.
+ */
+bool memcache_meta_protocol::format_arbitrary_command(arbitrary_command &cmd)
+{
+    for (unsigned int i = 0; i < cmd.command_args.size(); i++) {
+        command_arg *current_arg = &cmd.command_args[i];
+
+        if (!classify_arbitrary_arg(cmd, current_arg)) return false;
+
+        if (current_arg->type == scan_cursor_type) {
+            benchmark_error_log("error: scan cursor placeholder is not supported by memcache meta commands\n");
+            return false;
+        }
+
+        if (current_arg->type == data_type && (i == 0 || cmd.command_args[i - 1].type != key_type)) {
+            benchmark_error_log("error: memcache meta commands expect the data placeholder right after the key\n");
+            return false;
+        }
+
+        // an MN outside a multi-get would be taken for the start of one
+        if (i == 0 && current_arg->data == "mn") {
+            benchmark_error_log("error: memcache meta command mn is reserved for multi-get\n");
+            return false;
+        }
+
+        // a quiet command has no answer to match, it would desync the pipeline
+        if (i > 0 && current_arg->type == const_type && current_arg->data == "q") {
+            benchmark_error_log("error: memcache meta commands can't use the q flag\n");
+            return false;
+        }
+
+        // we expect that first arg is the COMMAND name
+        assert(i != 0 || (i == 0 && current_arg->type == const_type && "first arg is not command name?"));
+
+        if (current_arg->type == const_type && i > 0) {
+            current_arg->data.insert(0, " ");
+        }
+    }
+
+    command_arg end_of_line("\r\n", 2);
+    end_of_line.type = const_type;
+    cmd.command_args.push_back(end_of_line);
+
+    return true;
+}
+
+int memcache_meta_protocol::write_arbitrary_command(const command_arg *arg)
+{
+    int size = arg->data.length();
+
+    evbuffer_add(m_write_buf, arg->data.c_str(), arg->data.length());
+
+    // the end of the command line is followed by the value, if any
+    if (m_pending_value != NULL && arg->data == "\r\n") {
+        add_value(m_pending_value, m_pending_value_len);
+        evbuffer_add(m_write_buf, "\r\n", 2);
+        size += m_pending_value_len + 2;
+
+        m_pending_value = NULL;
+        m_pending_value_len = 0;
+    }
+
+    return size;
+}
+
+int memcache_meta_protocol::write_arbitrary_command(const char *val, int val_len)
+{
+    evbuffer_add(m_write_buf, " ", 1);
+    evbuffer_add(m_write_buf, val, val_len);
+
+    return val_len + 1;
+}
+
+int memcache_meta_protocol::write_arbitrary_command(const command_arg *arg, const char *val, int val_len)
+{
+    if (arg->type != data_type) return write_arbitrary_command(val, val_len);
+
+    m_pending_value = val;
+    m_pending_value_len = val_len;
+
+    return evbuffer_add_printf(m_write_buf, " %d", val_len);
+}
+
+/////////////////////////////////////////////////////////////////////////
+
 class abstract_protocol *protocol_factory(enum PROTOCOL_TYPE type)
 {
     if (is_redis_protocol(type)) {
         return new redis_protocol();
     } else if (type == PROTOCOL_MEMCACHE_TEXT) {
         return new memcache_text_protocol();
+    } else if (type == PROTOCOL_MEMCACHE_META) {
+        return new memcache_meta_protocol();
     } else if (type == PROTOCOL_MEMCACHE_BINARY) {
         return new memcache_binary_protocol();
     } else {
@@ -1328,14 +2777,18 @@ bool keylist::add_key(const char *key, unsigned int key_len)
         while (m_buffer_ptr + key_len >= m_buffer + m_buffer_size) {
             m_buffer_size *= 2;
         }
+
+        // the buffer may move, so keys are kept as offsets into it
+        size_t used = m_buffer_ptr - m_buffer;
         m_buffer = (char *) realloc(m_buffer, m_buffer_size);
         assert(m_buffer != NULL);
+        m_buffer_ptr = m_buffer + used;
     }
 
     // copy key
     memcpy(m_buffer_ptr, key, key_len);
     m_buffer_ptr[key_len] = '\0';
-    m_keys[m_keys_count].key_ptr = m_buffer_ptr;
+    m_keys[m_keys_count].key_offset = m_buffer_ptr - m_buffer;
     m_keys[m_keys_count].key_len = key_len;
 
     m_buffer_ptr += key_len + 1;
@@ -1353,7 +2806,7 @@ const char *keylist::get_key(unsigned int index, unsigned int *key_len) const
 {
     if (index < 0 || index >= m_keys_count) return NULL;
     if (key_len != NULL) *key_len = m_keys[index].key_len;
-    return m_keys[index].key_ptr;
+    return m_buffer + m_keys[index].key_offset;
 }
 
 void keylist::clear(void)
@@ -42,6 +42,8 @@ public:
     virtual mbulk_size_el *as_mbulk_size() = 0;
     virtual bulk_el *as_bulk() = 0;
 
+    mbulk_element_type get_type() const { return type; }
+
 protected:
     mbulk_element_type type;
 };
@@ -117,6 +119,7 @@ protected:
     unsigned int m_total_len;
     unsigned int m_hits;
     bool m_error;
+    bool m_push; // RESP3 out-of-band push, not a reply to any request
 
 public:
     protocol_response();
@@ -128,6 +131,9 @@ public:
     void set_error();
     bool is_error(void);
 
+    void set_push();
+    bool is_push(void);
+
     void set_value(const char *value, unsigned int value_len);
     const char *get_value(unsigned int *value_len);
 
@@ -148,7 +154,7 @@ class keylist
 protected:
     struct key_entry
     {
-        char *key_ptr;
+        size_t key_offset; // into m_buffer, which may be reallocated
         unsigned int key_len;
     };
 
@@ -171,6 +177,10 @@ public:
     void clear(void);
 };
 
+// every published message and stream entry starts with its send time, in
+// microseconds as hex digits
+#define MESSAGE_TIMESTAMP_LEN 16
+
 class abstract_protocol
 {
 protected:
@@ -178,30 +188,62 @@ protected:
     struct evbuffer *m_write_buf;
 
     bool m_keep_value;
+    unsigned int m_value_ref_threshold;
     struct protocol_response m_last_response;
 
+    void add_value(const char *value, unsigned int value_len);
+
 public:
     abstract_protocol();
     virtual ~abstract_protocol();
     virtual abstract_protocol *clone(void) = 0;
     void set_buffers(struct evbuffer *read_buf, struct evbuffer *write_buf);
     void set_keep_value(bool flag);
+    void set_value_ref_threshold(unsigned int threshold);
 
     virtual int select_db(int db) = 0;
     virtual int authenticate(const char *credentials) = 0;
     virtual int configure_protocol(enum PROTOCOL_TYPE type) = 0;
     virtual int write_command_cluster_slots() = 0;
+    virtual int write_command_client_tracking() = 0;
+    virtual int write_command_readonly() = 0;
     virtual int write_command_set(const char *key, int key_len, const char *value, int value_len, int expiry,
                                   unsigned int offset) = 0;
     virtual int write_command_get(const char *key, int key_len, unsigned int offset) = 0;
     virtual int write_command_multi_get(const keylist *keylist) = 0;
     virtual int write_command_wait(unsigned int num_slaves, unsigned int timeout) = 0;
+    virtual int write_command_publish(const char *channel, int channel_len, const char *message, int message_len,
+                                      unsigned long long sent_usec, bool sharded) = 0;
+    virtual int write_command_subscribe(const char *channel, int channel_len, bool sharded) = 0;
+    virtual int write_command_xadd(const char *stream, int stream_len, const char *message, int message_len,
+                                   unsigned long long sent_usec) = 0;
+    virtual int write_command_xgroup_create(const char *stream, int stream_len, const char *group) = 0;
+    virtual int write_command_xreadgroup(const char *stream, int stream_len, const char *group, const char *consumer,
+                                         unsigned int count, unsigned int block_msec) = 0;
+    virtual int write_command_xack(const char *stream, int stream_len, const char *group, const keylist *ids) = 0;
+    virtual int write_command_script_load(const char *script, int script_len) = 0;
+    virtual int write_command_queue_push(const char *queue, int queue_len, const char *message, int message_len,
+                                         unsigned long long sent_usec, bool sorted) = 0;
+    virtual int write_command_queue_pop(const char *queue, int queue_len, enum QUEUE_POP_TYPE pop, double timeout) = 0;
+    virtual int write_command_queue_ack(const char *queue, int queue_len, const char *message, int message_len) = 0;
+    virtual int write_command_collection_write(enum DATA_TYPE type, const char *key, int key_len, const char *value,
+                                               int value_len, unsigned int fields, const unsigned int *scores) = 0;
+    virtual int write_command_collection_read(enum DATA_TYPE type, const char *key, int key_len, unsigned int first,
+                                              unsigned int count) = 0;
+    virtual int write_command_list_trim(const char *key, int key_len, unsigned int length) = 0;
     virtual int parse_response() = 0;
+    // parse_response() stopped partway through a reply
+    virtual bool in_response() = 0;
 
     // handle arbitrary command
     virtual bool format_arbitrary_command(arbitrary_command &cmd) = 0;
     virtual int write_arbitrary_command(const command_arg *arg) = 0;
     virtual int write_arbitrary_command(const char *val, int val_len) = 0;
+    // protocols that encode keys and values differently override this one
+    virtual int write_arbitrary_command(const command_arg *arg, const char *val, int val_len)
+    {
+        return write_arbitrary_command(val, val_len);
+    }
 
     struct protocol_response *get_response(void) { return &m_last_response; }
 };
@@ -26,6 +26,7 @@
 #include <errno.h>
 #include <sys/time.h>
 #include <math.h>
+#include <limits.h>
 #include <algorithm>
 
 #ifdef HAVE_ASSERT_H
@@ -34,6 +35,7 @@
 #endif
 
 #include "run_stats.h"
+#include "cluster_client.h"
 
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
@@ -122,10 +124,41 @@ inline timeval timeval_factorial_average(timeval a, timeval b, unsigned int weig
     return (tv);
 }
 
-run_stats::run_stats(benchmark_config *config) : m_config(config), m_interrupted(false), m_totals(), m_cur_stats(0)
+run_stats::run_stats(benchmark_config *config) :
+        m_config(config), m_interrupted(false), m_totals(), m_cur_stats(0),
+        m_all_connected_usec(0),
+        m_tls_full_handshakes(0),
+        m_tls_resumed_handshakes(0),
+        m_ktls_connections(0),
+        m_invalidated_keys(0),
+        m_invalidation_flushes(0),
+        m_pubsub_delivered(0),
+        m_pubsub_published(0),
+        m_pubsub_receivers(0),
+        m_pubsub_subscribers(0),
+        m_pubsub_sub_rate_min(0),
+        m_pubsub_sub_rate_max(0),
+        m_pubsub_sub_rate_sum(0),
+        m_pubsub_sub_delivered_min(0),
+        m_stream_added(0),
+        m_stream_read(0),
+        m_stream_acked(0),
+        m_queue_pushed(0),
+        m_queue_popped(0),
+        m_queue_timeouts(0),
+        m_collection_written(0),
+        m_collection_read(0),
+        m_collection_reads(0),
+        m_collection_read_bytes(0),
+        m_collection_max_reply(0),
+        m_requests_failed(0),
+        m_requests_retried(0)
 {
     memset(&m_start_time, 0, sizeof(m_start_time));
     memset(&m_end_time, 0, sizeof(m_end_time));
+    memset(&m_first_error, 0, sizeof(m_first_error));
+    memset(&m_last_error, 0, sizeof(m_last_error));
+    memset(m_last_event, 0, sizeof(m_last_event));
     std::vector<float> quantiles_list_float = config->print_percentiles.quantile_list;
     std::sort(quantiles_list_float.begin(), quantiles_list_float.end());
     quantiles_list = std::vector<double>(quantiles_list_float.begin(), quantiles_list_float.end());
@@ -141,6 +174,7 @@ void run_stats::setup_arbitrary_commands(size_t n_arbitrary_commands)
     m_cur_stats.setup_arbitrary_commands(n_arbitrary_commands);
     m_ar_commands_latency_histograms.resize(n_arbitrary_commands);
     inst_m_ar_commands_latency_histograms.resize(n_arbitrary_commands);
+    m_ar_commands_first_byte_histograms.resize(n_arbitrary_commands);
 }
 
 void run_stats::set_start_time(struct timeval *start_time)
@@ -233,12 +267,147 @@ void run_stats::update_connection_error(struct timeval *ts)
     roll_cur_stats(ts);
     m_cur_stats.m_connection_errors++;
     m_totals.update_connection_error();
+    update_availability(ts, ae_connection_error);
+}
+
+// An error reply other than MOVED and ASK: the request failed
+void run_stats::update_error_reply(struct timeval *ts)
+{
+    roll_cur_stats(ts);
+    m_requests_failed++;
+    update_availability(ts, ae_error_reply);
+}
+
+// Keeps the first event of every burst of a kind, a burst going on as long
+// as the events are less than a second apart.
+void run_stats::update_availability(struct timeval *ts, availability_event_type type)
+{
+    if (type != ae_topology_change && type != ae_reconnected) {
+        if (!timerisset(&m_first_error)) m_first_error = *ts;
+        m_last_error = *ts;
+    }
+    if (type == ae_error_reply || type == ae_moved || type == ae_ask) m_cur_stats.m_error_replies++;
+
+    if (!timerisset(&m_last_event[type]) || ts_diff(m_last_event[type], *ts) >= 1000000) {
+        m_availability_events.push_back(availability_event(*ts, type));
+    }
+    m_last_event[type] = *ts;
+}
+
+void run_stats::update_connect_time(unsigned long long connect_usec)
+{
+    hdr_record_value_capped(m_connect_time_histogram, connect_usec);
+}
+
+void run_stats::update_tls_handshake(bool resumed, bool ktls)
+{
+    if (resumed)
+        m_tls_resumed_handshakes++;
+    else
+        m_tls_full_handshakes++;
+    if (ktls) m_ktls_connections++;
+}
+
+// latency_usec is 0 when the write time of the key is unknown
+void run_stats::update_invalidation(unsigned long long latency_usec)
+{
+    m_invalidated_keys++;
+    if (latency_usec > 0) hdr_record_value_capped(m_invalidation_latency_histogram, latency_usec);
+}
+
+// latency_usec is 0 when the message carried no valid send time
+void run_stats::update_pubsub_message(unsigned long long latency_usec)
+{
+    m_pubsub_delivered++;
+    if (latency_usec > 0) hdr_record_value_capped(m_pubsub_latency_histogram, latency_usec);
+}
+
+void run_stats::update_pubsub_publish(unsigned long long receivers)
+{
+    m_pubsub_published++;
+    m_pubsub_receivers += receivers;
+}
+
+// called once by a subscriber after its end time is set
+void run_stats::update_pubsub_subscriber_done(void)
+{
+    unsigned long int duration_usec = ts_diff(m_start_time, m_end_time);
+    double rate = duration_usec > 0 ? (double) m_pubsub_delivered / duration_usec * 1000000 : 0;
+
+    m_pubsub_subscribers = 1;
+    m_pubsub_sub_rate_min = m_pubsub_sub_rate_max = m_pubsub_sub_rate_sum = rate;
+    m_pubsub_sub_delivered_min = m_pubsub_delivered;
+}
+
+void run_stats::update_stream_add(struct timeval *ts)
+{
+    roll_cur_stats(ts);
+    m_cur_stats.m_stream_added++;
+    m_stream_added++;
+}
+
+// latency_usec is 0 when the entry carried no valid send time
+void run_stats::update_stream_read(struct timeval *ts, unsigned long long latency_usec)
+{
+    roll_cur_stats(ts);
+    m_cur_stats.m_stream_read++;
+    m_stream_read++;
+    if (latency_usec > 0) hdr_record_value_capped(m_stream_latency_histogram, latency_usec);
+}
+
+void run_stats::update_stream_ack(struct timeval *ts, unsigned long long entries)
+{
+    roll_cur_stats(ts);
+    m_cur_stats.m_stream_acked += entries;
+    m_stream_acked += entries;
+}
+
+void run_stats::update_queue_push(struct timeval *ts, unsigned long long messages)
+{
+    roll_cur_stats(ts);
+    m_cur_stats.m_queue_pushed += messages;
+    m_queue_pushed += messages;
+}
+
+// delivery_usec is 0 when the message carried no valid send time
+void run_stats::update_queue_pop(struct timeval *ts, unsigned long long delivery_usec, unsigned long long wait_usec)
+{
+    roll_cur_stats(ts);
+    m_cur_stats.m_queue_popped++;
+    m_queue_popped++;
+    if (delivery_usec > 0) hdr_record_value_capped(m_queue_delivery_histogram, delivery_usec);
+    hdr_record_value_capped(m_queue_wait_histogram, wait_usec);
+}
+
+void run_stats::update_queue_timeout(struct timeval *ts)
+{
+    roll_cur_stats(ts);
+    m_cur_stats.m_queue_timeouts++;
+    m_queue_timeouts++;
+}
+
+void run_stats::update_collection_write(struct timeval *ts, unsigned int elements)
+{
+    roll_cur_stats(ts);
+    m_cur_stats.m_collection_written += elements;
+    m_collection_written += elements;
+}
+
+void run_stats::update_collection_read(struct timeval *ts, unsigned int elements, unsigned int reply_bytes)
+{
+    roll_cur_stats(ts);
+    m_cur_stats.m_collection_read += elements;
+    m_collection_read += elements;
+    m_collection_reads++;
+    m_collection_read_bytes += reply_bytes;
+    m_collection_max_reply = std::max(m_collection_max_reply, (unsigned long long) reply_bytes);
 }
 
 void run_stats::update_moved_get_op(struct timeval *ts, unsigned int bytes_rx, unsigned int bytes_tx,
                                     unsigned int latency)
 {
     roll_cur_stats(ts);
+    update_availability(ts, ae_moved);
 
     m_cur_stats.m_get_cmd.update_moved_op(bytes_rx, bytes_tx, latency);
     m_cur_stats.m_total_cmd.update_op(bytes_rx, bytes_tx, latency);
@@ -253,6 +422,7 @@ void run_stats::update_moved_set_op(struct timeval *ts, unsigned int bytes_rx, u
                                     unsigned int latency)
 {
     roll_cur_stats(ts);
+    update_availability(ts, ae_moved);
 
     m_cur_stats.m_set_cmd.update_moved_op(bytes_rx, bytes_tx, latency);
     m_cur_stats.m_total_cmd.update_moved_op(bytes_rx, bytes_tx, latency);
@@ -263,10 +433,26 @@ void run_stats::update_moved_set_op(struct timeval *ts, unsigned int bytes_rx, u
     hdr_record_value_capped_atomic(inst_m_totals_latency_histogram, latency);
 }
 
+void run_stats::update_get_first_byte(unsigned int latency)
+{
+    hdr_record_value_capped(m_get_first_byte_histogram, latency);
+}
+
+void run_stats::update_set_first_byte(unsigned int latency)
+{
+    hdr_record_value_capped(m_set_first_byte_histogram, latency);
+}
+
+void run_stats::update_arbitrary_first_byte(unsigned int latency, size_t request_index)
+{
+    hdr_record_value_capped(m_ar_commands_first_byte_histograms.at(request_index), latency);
+}
+
 void run_stats::update_moved_arbitrary_op(struct timeval *ts, unsigned int bytes_rx, unsigned int bytes_tx,
                                           unsigned int latency, size_t request_index)
 {
     roll_cur_stats(ts);
+    update_availability(ts, ae_moved);
 
     m_cur_stats.m_ar_commands.at(request_index).update_moved_op(bytes_rx, bytes_tx, latency);
     m_cur_stats.m_total_cmd.update_op(bytes_rx, bytes_tx, latency);
@@ -282,6 +468,7 @@ void run_stats::update_ask_get_op(struct timeval *ts, unsigned int bytes_rx, uns
                                   unsigned int latency)
 {
     roll_cur_stats(ts);
+    update_availability(ts, ae_ask);
 
     m_cur_stats.m_get_cmd.update_ask_op(bytes_rx, bytes_tx, latency);
     m_cur_stats.m_total_cmd.update_ask_op(bytes_rx, bytes_tx, latency);
@@ -296,6 +483,7 @@ void run_stats::update_ask_set_op(struct timeval *ts, unsigned int bytes_rx, uns
                                   unsigned int latency)
 {
     roll_cur_stats(ts);
+    update_availability(ts, ae_ask);
 
     m_cur_stats.m_set_cmd.update_ask_op(bytes_rx, bytes_tx, latency);
     m_cur_stats.m_total_cmd.update_ask_op(bytes_rx, bytes_tx, latency);
@@ -310,6 +498,7 @@ void run_stats::update_ask_arbitrary_op(struct timeval *ts, unsigned int bytes_r
                                         unsigned int latency, size_t request_index)
 {
     roll_cur_stats(ts);
+    update_availability(ts, ae_ask);
 
     m_cur_stats.m_ar_commands.at(request_index).update_ask_op(bytes_rx, bytes_tx, latency);
     m_cur_stats.m_total_cmd.update_ask_op(bytes_rx, bytes_tx, latency);
@@ -538,6 +727,99 @@ void run_stats::save_csv_set_get_commands(FILE *f, bool cluster_mode)
     }
 }
 
+static double per_second(unsigned long long count, double duration_sec)
+{
+    return duration_sec > 0 ? count / duration_sec : 0;
+}
+
+// shard ops/sec of the busiest and idlest shards, see print_shards
+struct shard_skew
+{
+    std::string max_shard;
+    std::string min_shard;
+    double max_ops_sec;
+    double min_ops_sec;
+    double avg_ops_sec;
+
+    shard_skew(const std::map<std::string, shard_stats> &shards, double duration_sec) :
+            max_ops_sec(0), min_ops_sec(0), avg_ops_sec(0)
+    {
+        for (std::map<std::string, shard_stats>::const_iterator i = shards.begin(); i != shards.end(); i++) {
+            double ops_sec = per_second(i->second.m_ops, duration_sec);
+            if (max_shard.empty() || ops_sec > max_ops_sec) {
+                max_shard = i->first;
+                max_ops_sec = ops_sec;
+            }
+            if (min_shard.empty() || ops_sec < min_ops_sec) {
+                min_shard = i->first;
+                min_ops_sec = ops_sec;
+            }
+            avg_ops_sec += ops_sec / shards.size();
+        }
+    }
+
+    double max_min() const { return min_ops_sec > 0 ? max_ops_sec / min_ops_sec : 0; }
+    double max_avg() const { return avg_ops_sec > 0 ? max_ops_sec / avg_ops_sec : 0; }
+};
+
+void run_stats::save_csv_shards(FILE *f)
+{
+    const double duration_sec = ts_diff(m_start_time, m_end_time) / 1000000.0;
+
+    fprintf(f, "\nPer-Shard Data\n");
+    fprintf(f, "Shard,Role,Ops/sec,Hits/sec,Misses/sec,MOVED/sec,ASK/sec,Average Latency");
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        fprintf(f, ",p%.2f Latency", quantiles_list[i]);
+    }
+    fprintf(f, ",KB/sec\n");
+
+    for (std::map<std::string, shard_stats>::iterator i = m_shard_stats.begin(); i != m_shard_stats.end(); i++) {
+        const shard_stats &s = i->second;
+        fprintf(f, "%s,%s,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f", i->first.c_str(), s.m_replica ? "replica" : "primary",
+                per_second(s.m_ops, duration_sec),
+                per_second(s.m_hits, duration_sec), per_second(s.m_misses, duration_sec),
+                per_second(s.m_moved, duration_sec), per_second(s.m_ask, duration_sec),
+                hdr_mean(s.m_latency_histogram) / LATENCY_HDR_RESULTS_MULTIPLIER);
+        for (std::size_t j = 0; j < quantiles_list.size(); j++) {
+            fprintf(f, ",%.3f",
+                    hdr_value_at_percentile(s.m_latency_histogram, quantiles_list[j]) /
+                        (double) LATENCY_HDR_RESULTS_MULTIPLIER);
+        }
+        fprintf(f, ",%.2f\n", per_second(s.m_bytes, duration_sec) / 1024);
+    }
+
+    shard_skew skew(m_shard_stats, duration_sec);
+    fprintf(f, "\nShard Skew\n");
+    fprintf(f, "Max Shard,Max Ops/sec,Min Shard,Min Ops/sec,Max/Min,Max/Avg\n");
+    fprintf(f, "%s,%.2f,%s,%.2f,%.2f,%.2f\n", skew.max_shard.c_str(), skew.max_ops_sec, skew.min_shard.c_str(),
+            skew.min_ops_sec, skew.max_min(), skew.max_avg());
+}
+
+void run_stats::save_csv_fanout(FILE *f)
+{
+    const double duration_sec = ts_diff(m_start_time, m_end_time) / 1000000.0;
+
+    fprintf(f, "\nFan-out\n");
+    fprintf(f, "Nodes,Ops/sec,Keys/op,Average Latency");
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        fprintf(f, ",p%.2f Latency", quantiles_list[i]);
+    }
+    fprintf(f, "\n");
+
+    for (std::map<unsigned int, fanout_stats>::iterator i = m_fanout_stats.begin(); i != m_fanout_stats.end(); i++) {
+        const fanout_stats &s = i->second;
+        fprintf(f, "%u,%.2f,%.2f,%.3f", i->first, per_second(s.m_ops, duration_sec),
+                s.m_ops ? (double) s.m_keys / s.m_ops : 0,
+                hdr_mean(s.m_latency_histogram) / LATENCY_HDR_RESULTS_MULTIPLIER);
+        for (std::size_t j = 0; j < quantiles_list.size(); j++) {
+            fprintf(f, ",%.3f",
+                    hdr_value_at_percentile(s.m_latency_histogram, quantiles_list[j]) /
+                        (double) LATENCY_HDR_RESULTS_MULTIPLIER);
+        }
+        fprintf(f, "\n");
+    }
+}
+
 void run_stats::save_csv_arbitrary_commands_one_sec(FILE *f, arbitrary_command_list &command_list,
                                                     std::vector<unsigned long int> &total_arbitrary_commands_ops)
 {
@@ -752,6 +1034,14 @@ bool run_stats::save_csv(const char *filename, benchmark_config *config)
         save_csv_set_get_commands(f, config->cluster_mode);
     }
 
+    if (!m_shard_stats.empty()) {
+        save_csv_shards(f);
+    }
+
+    if (!m_fanout_stats.empty()) {
+        save_csv_fanout(f);
+    }
+
     fclose(f);
     return true;
 }
@@ -796,6 +1086,56 @@ void run_stats::aggregate_average(const std::vector<run_stats> &all_stats)
         for (unsigned int j = 0; j < i->m_ar_commands_latency_histograms.size(); j++) {
             hdr_add(m_ar_commands_latency_histograms.at(j), i->m_ar_commands_latency_histograms.at(j));
         }
+
+        hdr_add(m_get_first_byte_histogram, i->m_get_first_byte_histogram);
+        hdr_add(m_set_first_byte_histogram, i->m_set_first_byte_histogram);
+        for (unsigned int j = 0; j < i->m_ar_commands_first_byte_histograms.size(); j++) {
+            hdr_add(m_ar_commands_first_byte_histograms.at(j), i->m_ar_commands_first_byte_histograms.at(j));
+        }
+
+        for (std::map<std::string, shard_stats>::const_iterator s = i->m_shard_stats.begin();
+             s != i->m_shard_stats.end(); s++) {
+            m_shard_stats[s->first].merge(s->second);
+        }
+        for (std::map<unsigned int, fanout_stats>::const_iterator f = i->m_fanout_stats.begin();
+             f != i->m_fanout_stats.end(); f++) {
+            m_fanout_stats[f->first].merge(f->second);
+        }
+        // the timelines of different runs can't be averaged, only their counts
+        m_requests_failed += i->m_requests_failed;
+        m_requests_retried += i->m_requests_retried;
+
+        hdr_add(m_connect_time_histogram, i->m_connect_time_histogram);
+        m_all_connected_usec += i->m_all_connected_usec;
+        m_tls_full_handshakes += i->m_tls_full_handshakes;
+        m_tls_resumed_handshakes += i->m_tls_resumed_handshakes;
+        m_ktls_connections += i->m_ktls_connections;
+        hdr_add(m_invalidation_latency_histogram, i->m_invalidation_latency_histogram);
+        m_invalidated_keys += i->m_invalidated_keys;
+        m_invalidation_flushes += i->m_invalidation_flushes;
+        hdr_add(m_pubsub_latency_histogram, i->m_pubsub_latency_histogram);
+        m_pubsub_delivered += i->m_pubsub_delivered;
+        m_pubsub_published += i->m_pubsub_published;
+        m_pubsub_receivers += i->m_pubsub_receivers;
+        m_pubsub_subscribers = i->m_pubsub_subscribers;
+        m_pubsub_sub_rate_min += i->m_pubsub_sub_rate_min;
+        m_pubsub_sub_rate_max += i->m_pubsub_sub_rate_max;
+        m_pubsub_sub_rate_sum += i->m_pubsub_sub_rate_sum;
+        m_pubsub_sub_delivered_min += i->m_pubsub_sub_delivered_min;
+        hdr_add(m_stream_latency_histogram, i->m_stream_latency_histogram);
+        m_stream_added += i->m_stream_added;
+        m_stream_read += i->m_stream_read;
+        m_stream_acked += i->m_stream_acked;
+        hdr_add(m_queue_delivery_histogram, i->m_queue_delivery_histogram);
+        hdr_add(m_queue_wait_histogram, i->m_queue_wait_histogram);
+        m_queue_pushed += i->m_queue_pushed;
+        m_queue_popped += i->m_queue_popped;
+        m_queue_timeouts += i->m_queue_timeouts;
+        m_collection_written += i->m_collection_written;
+        m_collection_read += i->m_collection_read;
+        m_collection_reads += i->m_collection_reads;
+        m_collection_read_bytes += i->m_collection_read_bytes;
+        m_collection_max_reply = std::max(m_collection_max_reply, i->m_collection_max_reply);
     }
 
     m_totals.m_set_cmd.aggregate_average(all_stats.size());
@@ -810,6 +1150,41 @@ void run_stats::aggregate_average(const std::vector<run_stats> &all_stats)
     m_totals.m_ask_sec /= all_stats.size();
     m_totals.m_bytes_sec /= all_stats.size();
     m_totals.m_latency /= all_stats.size();
+
+    // the counters were summed over the runs
+    m_requests_failed /= all_stats.size();
+    m_requests_retried /= all_stats.size();
+    for (std::map<std::string, shard_stats>::iterator s = m_shard_stats.begin(); s != m_shard_stats.end(); s++) {
+        s->second.aggregate_average(all_stats.size());
+    }
+    for (std::map<unsigned int, fanout_stats>::iterator f = m_fanout_stats.begin(); f != m_fanout_stats.end(); f++) {
+        f->second.aggregate_average(all_stats.size());
+    }
+
+    // the counters were summed over the runs
+    m_all_connected_usec /= all_stats.size();
+    m_tls_full_handshakes /= all_stats.size();
+    m_tls_resumed_handshakes /= all_stats.size();
+    m_ktls_connections /= all_stats.size();
+    m_invalidated_keys /= all_stats.size();
+    m_invalidation_flushes /= all_stats.size();
+    m_pubsub_delivered /= all_stats.size();
+    m_pubsub_published /= all_stats.size();
+    m_pubsub_receivers /= all_stats.size();
+    m_pubsub_sub_rate_min /= all_stats.size();
+    m_pubsub_sub_rate_max /= all_stats.size();
+    m_pubsub_sub_rate_sum /= all_stats.size();
+    m_pubsub_sub_delivered_min /= all_stats.size();
+    m_stream_added /= all_stats.size();
+    m_stream_read /= all_stats.size();
+    m_stream_acked /= all_stats.size();
+    m_queue_pushed /= all_stats.size();
+    m_queue_popped /= all_stats.size();
+    m_queue_timeouts /= all_stats.size();
+    m_collection_written /= all_stats.size();
+    m_collection_read /= all_stats.size();
+    m_collection_reads /= all_stats.size();
+    m_collection_read_bytes /= all_stats.size();
 }
 
 void run_stats::merge(const run_stats &other, int iteration)
@@ -860,6 +1235,78 @@ void run_stats::merge(const run_stats &other, int iteration)
     for (unsigned int j = 0; j < other.m_ar_commands_latency_histograms.size(); j++) {
         hdr_add(m_ar_commands_latency_histograms.at(j), other.m_ar_commands_latency_histograms.at(j));
     }
+
+    hdr_add(m_get_first_byte_histogram, other.m_get_first_byte_histogram);
+    hdr_add(m_set_first_byte_histogram, other.m_set_first_byte_histogram);
+    for (unsigned int j = 0; j < other.m_ar_commands_first_byte_histograms.size(); j++) {
+        hdr_add(m_ar_commands_first_byte_histograms.at(j), other.m_ar_commands_first_byte_histograms.at(j));
+    }
+
+    for (std::map<std::string, shard_stats>::const_iterator s = other.m_shard_stats.begin();
+         s != other.m_shard_stats.end(); s++) {
+        m_shard_stats[s->first].merge(s->second);
+    }
+    for (std::map<unsigned int, fanout_stats>::const_iterator f = other.m_fanout_stats.begin();
+         f != other.m_fanout_stats.end(); f++) {
+        m_fanout_stats[f->first].merge(f->second);
+    }
+
+    if (timerisset(&other.m_first_error)) {
+        if (!timerisset(&m_first_error) || timercmp(&other.m_first_error, &m_first_error, <))
+            m_first_error = other.m_first_error;
+        if (timercmp(&other.m_last_error, &m_last_error, >)) m_last_error = other.m_last_error;
+    }
+    m_availability_events.insert(m_availability_events.end(), other.m_availability_events.begin(),
+                                 other.m_availability_events.end());
+    m_requests_failed += other.m_requests_failed;
+    m_requests_retried += other.m_requests_retried;
+
+    m_thread_overhead.insert(m_thread_overhead.end(), other.m_thread_overhead.begin(), other.m_thread_overhead.end());
+
+    hdr_add(m_connect_time_histogram, other.m_connect_time_histogram);
+
+    m_tls_full_handshakes += other.m_tls_full_handshakes;
+    m_tls_resumed_handshakes += other.m_tls_resumed_handshakes;
+    m_ktls_connections += other.m_ktls_connections;
+
+    hdr_add(m_invalidation_latency_histogram, other.m_invalidation_latency_histogram);
+    m_invalidated_keys += other.m_invalidated_keys;
+    m_invalidation_flushes += other.m_invalidation_flushes;
+
+    hdr_add(m_pubsub_latency_histogram, other.m_pubsub_latency_histogram);
+    m_pubsub_delivered += other.m_pubsub_delivered;
+    m_pubsub_published += other.m_pubsub_published;
+    m_pubsub_receivers += other.m_pubsub_receivers;
+    if (other.m_pubsub_subscribers > 0) {
+        if (m_pubsub_subscribers == 0) {
+            m_pubsub_sub_rate_min = other.m_pubsub_sub_rate_min;
+            m_pubsub_sub_rate_max = other.m_pubsub_sub_rate_max;
+            m_pubsub_sub_delivered_min = other.m_pubsub_sub_delivered_min;
+        } else {
+            m_pubsub_sub_rate_min = std::min(m_pubsub_sub_rate_min, other.m_pubsub_sub_rate_min);
+            m_pubsub_sub_rate_max = std::max(m_pubsub_sub_rate_max, other.m_pubsub_sub_rate_max);
+            m_pubsub_sub_delivered_min = std::min(m_pubsub_sub_delivered_min, other.m_pubsub_sub_delivered_min);
+        }
+        m_pubsub_subscribers += other.m_pubsub_subscribers;
+        m_pubsub_sub_rate_sum += other.m_pubsub_sub_rate_sum;
+    }
+
+    hdr_add(m_stream_latency_histogram, other.m_stream_latency_histogram);
+    m_stream_added += other.m_stream_added;
+    m_stream_read += other.m_stream_read;
+    m_stream_acked += other.m_stream_acked;
+
+    hdr_add(m_queue_delivery_histogram, other.m_queue_delivery_histogram);
+    hdr_add(m_queue_wait_histogram, other.m_queue_wait_histogram);
+    m_queue_pushed += other.m_queue_pushed;
+    m_queue_popped += other.m_queue_popped;
+    m_queue_timeouts += other.m_queue_timeouts;
+
+    m_collection_written += other.m_collection_written;
+    m_collection_read += other.m_collection_read;
+    m_collection_reads += other.m_collection_reads;
+    m_collection_read_bytes += other.m_collection_read_bytes;
+    m_collection_max_reply = std::max(m_collection_max_reply, other.m_collection_max_reply);
 }
 
 void run_stats::summarize(totals &result) const
@@ -1608,6 +2055,866 @@ void run_stats::print_histogram(FILE *out, json_handler *jsonhandler, arbitrary_
     }
 }
 
+void run_stats::print_thread_overhead(FILE *out, json_handler *jsonhandler)
+{
+    static const char *phase_names[overhead_phase_max] = {"Create Request", "Parse Response", "Stats Update"};
+
+    fprintf(out,
+            "\n\n"
+            "Thread Overhead (msec)\n"
+            "%-6s %8s %12s %12s %12s %12s %12s %12s\n"
+            "------------------------------------------------------------------------------------------------\n",
+            "Thread", "CPU %", "User", "System", "Idle", "Create Req", "Parse Resp", "Stats Upd");
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Thread Overhead");
+        jsonhandler->write_obj("Time unit", "\"%s\"", "MICROSECONDS");
+    }
+
+    for (std::size_t i = 0; i < m_thread_overhead.size(); i++) {
+        const thread_overhead_stats &t = m_thread_overhead[i];
+
+        fprintf(out, "%-6u %8.2f %12.3f %12.3f %12.3f %12.3f %12.3f %12.3f\n", t.m_thread_id, t.cpu_utilization(),
+                t.m_user_usec / 1000.0, t.m_sys_usec / 1000.0, t.idle_usec() / 1000.0,
+                t.m_phase_usec[overhead_create_request] / 1000.0, t.m_phase_usec[overhead_parse_response] / 1000.0,
+                t.m_phase_usec[overhead_stats_update] / 1000.0);
+
+        if (jsonhandler != NULL) {
+            char thread_str[16];
+            snprintf(thread_str, sizeof(thread_str), "%u", t.m_thread_id);
+            jsonhandler->open_nesting(thread_str);
+            jsonhandler->write_obj("CPU Utilization", "%.2f", t.cpu_utilization());
+            jsonhandler->write_obj("Wall Time", "%llu", t.m_wall_usec);
+            jsonhandler->write_obj("User Time", "%llu", t.m_user_usec);
+            jsonhandler->write_obj("System Time", "%llu", t.m_sys_usec);
+            jsonhandler->write_obj("Idle Time", "%llu", t.idle_usec());
+            for (int p = 0; p < overhead_phase_max; p++) {
+                char name[32];
+                snprintf(name, sizeof(name), "%s Time", phase_names[p]);
+                jsonhandler->write_obj(name, "%llu", t.m_phase_usec[p]);
+            }
+            jsonhandler->close_nesting();
+        }
+    }
+
+    if (jsonhandler != NULL) {
+        jsonhandler->close_nesting();
+    }
+}
+
+void run_stats::print_connection_setup(FILE *out, json_handler *jsonhandler)
+{
+    const double multiplier = LATENCY_HDR_RESULTS_MULTIPLIER;
+    const double all_connected = m_all_connected_usec / multiplier;
+    const double avg = hdr_mean(m_connect_time_histogram) / multiplier;
+    const double min = hdr_min(m_connect_time_histogram) / multiplier;
+    const double max = hdr_max(m_connect_time_histogram) / multiplier;
+
+    fprintf(out, "\n\nConnection Setup (msec)\n%-10s %14s %12s %12s", "Connects", "All Connected", "Avg", "Min");
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        char quantile_header[16];
+        snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.2f", quantiles_list[i]);
+        fprintf(out, " %12s", quantile_header);
+    }
+    fprintf(out, " %12s\n", "Max");
+    fprintf(out, "%-10lld %14.3f %12.3f %12.3f", (long long) hdr_total_count(m_connect_time_histogram), all_connected,
+            avg, min);
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        fprintf(out, " %12.3f", hdr_value_at_percentile(m_connect_time_histogram, quantiles_list[i]) / multiplier);
+    }
+    fprintf(out, " %12.3f\n", max);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Connection Setup");
+        jsonhandler->write_obj("Time unit", "\"%s\"", "MILLISECONDS");
+        jsonhandler->write_obj("Connects", "%lld", (long long) hdr_total_count(m_connect_time_histogram));
+        jsonhandler->write_obj("Time To All Connected", "%.3f", all_connected);
+        jsonhandler->write_obj("Average Connect Time", "%.3f", avg);
+        jsonhandler->write_obj("Min Connect Time", "%.3f", min);
+        jsonhandler->write_obj("Max Connect Time", "%.3f", max);
+        jsonhandler->open_nesting("Percentile Connect Times");
+        for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+            char quantile_header[16];
+            snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.3f", quantiles_list[i]);
+            jsonhandler->write_obj(quantile_header, "%.3f",
+                                   hdr_value_at_percentile(m_connect_time_histogram, quantiles_list[i]) / multiplier);
+        }
+        jsonhandler->close_nesting();
+        jsonhandler->close_nesting();
+    }
+}
+
+void run_stats::print_tls_handshakes(FILE *out, json_handler *jsonhandler)
+{
+    unsigned long long total = m_tls_full_handshakes + m_tls_resumed_handshakes;
+    double resumption_ratio = total > 0 ? (double) m_tls_resumed_handshakes / total : 0;
+
+    fprintf(out, "\n\nTLS Handshakes\n%-12s %12s %12s %18s %16s\n", "Handshakes", "Full", "Resumed",
+            "Resumption Ratio", "kTLS Connections");
+    fprintf(out, "%-12llu %12llu %12llu %18.3f %16llu\n", total, m_tls_full_handshakes, m_tls_resumed_handshakes,
+            resumption_ratio, m_ktls_connections);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("TLS Handshakes");
+        jsonhandler->write_obj("Handshakes", "%llu", total);
+        jsonhandler->write_obj("Full", "%llu", m_tls_full_handshakes);
+        jsonhandler->write_obj("Resumed", "%llu", m_tls_resumed_handshakes);
+        jsonhandler->write_obj("Resumption Ratio", "%.3f", resumption_ratio);
+        jsonhandler->write_obj("kTLS Connections", "%llu", m_ktls_connections);
+        jsonhandler->close_nesting();
+    }
+}
+
+void run_stats::print_invalidations(FILE *out, json_handler *jsonhandler)
+{
+    const double multiplier = LATENCY_HDR_RESULTS_MULTIPLIER;
+    const unsigned long int duration_usec = ts_diff(m_start_time, m_end_time);
+    const double per_sec = duration_usec > 0 ? (double) m_invalidated_keys / duration_usec * 1000000 : 0;
+    const double avg = hdr_mean(m_invalidation_latency_histogram) / multiplier;
+    const double min = hdr_min(m_invalidation_latency_histogram) / multiplier;
+    const double max = hdr_max(m_invalidation_latency_histogram) / multiplier;
+
+    fprintf(out, "\n\nClient Tracking Invalidations (msec)\n%-14s %18s %10s %12s %12s", "Invalidations",
+            "Invalidations/sec", "Flushes", "Avg", "Min");
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        char quantile_header[16];
+        snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.2f", quantiles_list[i]);
+        fprintf(out, " %12s", quantile_header);
+    }
+    fprintf(out, " %12s\n", "Max");
+    fprintf(out, "%-14llu %18.2f %10llu %12.3f %12.3f", m_invalidated_keys, per_sec, m_invalidation_flushes, avg,
+            min);
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        fprintf(out, " %12.3f",
+                hdr_value_at_percentile(m_invalidation_latency_histogram, quantiles_list[i]) / multiplier);
+    }
+    fprintf(out, " %12.3f\n", max);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Client Tracking Invalidations");
+        jsonhandler->write_obj("Time unit", "\"%s\"", "MILLISECONDS");
+        jsonhandler->write_obj("Invalidations", "%llu", m_invalidated_keys);
+        jsonhandler->write_obj("Invalidations/sec", "%.2f", per_sec);
+        jsonhandler->write_obj("Flushes", "%llu", m_invalidation_flushes);
+        jsonhandler->write_obj("Timed Invalidations", "%lld",
+                               (long long) hdr_total_count(m_invalidation_latency_histogram));
+        jsonhandler->write_obj("Average Latency", "%.3f", avg);
+        jsonhandler->write_obj("Min Latency", "%.3f", min);
+        jsonhandler->write_obj("Max Latency", "%.3f", max);
+        jsonhandler->open_nesting("Percentile Latencies");
+        for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+            char quantile_header[16];
+            snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.3f", quantiles_list[i]);
+            jsonhandler->write_obj(
+                quantile_header, "%.3f",
+                hdr_value_at_percentile(m_invalidation_latency_histogram, quantiles_list[i]) / multiplier);
+        }
+        jsonhandler->close_nesting();
+        jsonhandler->close_nesting();
+    }
+}
+
+// Every subscriber is subscribed to all channels, so each one should get
+// every published message: its backlog is what it's still missing.
+void run_stats::print_pubsub(FILE *out, json_handler *jsonhandler)
+{
+    const double multiplier = LATENCY_HDR_RESULTS_MULTIPLIER;
+    const unsigned long int duration_usec = ts_diff(m_start_time, m_end_time);
+    const double delivered_sec = duration_usec > 0 ? (double) m_pubsub_delivered / duration_usec * 1000000 : 0;
+    const unsigned long long undelivered =
+        m_pubsub_receivers > m_pubsub_delivered ? m_pubsub_receivers - m_pubsub_delivered : 0;
+    const unsigned long long max_backlog =
+        m_pubsub_published > m_pubsub_sub_delivered_min ? m_pubsub_published - m_pubsub_sub_delivered_min : 0;
+    const double sub_rate_avg = m_pubsub_subscribers > 0 ? m_pubsub_sub_rate_sum / m_pubsub_subscribers : 0;
+    const double avg = hdr_mean(m_pubsub_latency_histogram) / multiplier;
+    const double min = hdr_min(m_pubsub_latency_histogram) / multiplier;
+    const double max = hdr_max(m_pubsub_latency_histogram) / multiplier;
+
+    fprintf(out, "\n\nPub/Sub Delivery\n%-12s %12s %12s %14s %12s %14s %14s %14s %12s\n", "Subscribers",
+            "Published", "Delivered", "Delivered/sec", "Undelivered", "Min Sub Msg/s", "Avg Sub Msg/s",
+            "Max Sub Msg/s", "Max Backlog");
+    fprintf(out, "%-12u %12llu %12llu %14.2f %12llu %14.2f %14.2f %14.2f %12llu\n", m_pubsub_subscribers,
+            m_pubsub_published, m_pubsub_delivered, delivered_sec, undelivered, m_pubsub_sub_rate_min, sub_rate_avg,
+            m_pubsub_sub_rate_max, max_backlog);
+
+    fprintf(out, "\nPub/Sub Latency (msec)\n%-12s %12s %12s", "Messages", "Avg", "Min");
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        char quantile_header[16];
+        snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.2f", quantiles_list[i]);
+        fprintf(out, " %12s", quantile_header);
+    }
+    fprintf(out, " %12s\n", "Max");
+    fprintf(out, "%-12lld %12.3f %12.3f", (long long) hdr_total_count(m_pubsub_latency_histogram), avg, min);
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        fprintf(out, " %12.3f", hdr_value_at_percentile(m_pubsub_latency_histogram, quantiles_list[i]) / multiplier);
+    }
+    fprintf(out, " %12.3f\n", max);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Pub/Sub");
+        jsonhandler->write_obj("Subscribers", "%u", m_pubsub_subscribers);
+        jsonhandler->write_obj("Published", "%llu", m_pubsub_published);
+        jsonhandler->write_obj("Receivers", "%llu", m_pubsub_receivers);
+        jsonhandler->write_obj("Delivered", "%llu", m_pubsub_delivered);
+        jsonhandler->write_obj("Delivered/sec", "%.2f", delivered_sec);
+        jsonhandler->write_obj("Undelivered", "%llu", undelivered);
+        jsonhandler->write_obj("Min Subscriber Msg/sec", "%.2f", m_pubsub_sub_rate_min);
+        jsonhandler->write_obj("Avg Subscriber Msg/sec", "%.2f", sub_rate_avg);
+        jsonhandler->write_obj("Max Subscriber Msg/sec", "%.2f", m_pubsub_sub_rate_max);
+        jsonhandler->write_obj("Max Subscriber Backlog", "%llu", max_backlog);
+        jsonhandler->write_obj("Time unit", "\"%s\"", "MILLISECONDS");
+        jsonhandler->write_obj("Average Latency", "%.3f", avg);
+        jsonhandler->write_obj("Min Latency", "%.3f", min);
+        jsonhandler->write_obj("Max Latency", "%.3f", max);
+        jsonhandler->open_nesting("Percentile Latencies");
+        for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+            char quantile_header[16];
+            snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.3f", quantiles_list[i]);
+            jsonhandler->write_obj(quantile_header, "%.3f",
+                                   hdr_value_at_percentile(m_pubsub_latency_histogram, quantiles_list[i]) / multiplier);
+        }
+        jsonhandler->close_nesting();
+        jsonhandler->close_nesting();
+    }
+}
+
+// All consumers share one group, so every entry added is to be read once:
+// the lag is what's added but not read yet, and the pending entries what's
+// read but not acknowledged yet.  Both are also reported for every second.
+void run_stats::print_streams(FILE *out, json_handler *jsonhandler)
+{
+    const double multiplier = LATENCY_HDR_RESULTS_MULTIPLIER;
+    const unsigned long int duration_usec = ts_diff(m_start_time, m_end_time);
+    const double added_sec = duration_usec > 0 ? (double) m_stream_added / duration_usec * 1000000 : 0;
+    const double read_sec = duration_usec > 0 ? (double) m_stream_read / duration_usec * 1000000 : 0;
+    const long long lag = (long long) m_stream_added - (long long) m_stream_read;
+    const long long pending = (long long) m_stream_read - (long long) m_stream_acked;
+    const double avg = hdr_mean(m_stream_latency_histogram) / multiplier;
+    const double min = hdr_min(m_stream_latency_histogram) / multiplier;
+    const double max = hdr_max(m_stream_latency_histogram) / multiplier;
+
+    // running totals, in the order of the seconds
+    long long max_lag = 0;
+    long long max_pending = 0;
+    long long cur_lag = 0;
+    long long cur_pending = 0;
+    for (std::list<one_second_stats>::const_iterator i = m_stats.begin(); i != m_stats.end(); i++) {
+        cur_lag += (long long) i->m_stream_added - (long long) i->m_stream_read;
+        cur_pending += (long long) i->m_stream_read - (long long) i->m_stream_acked;
+        max_lag = std::max(max_lag, cur_lag);
+        max_pending = std::max(max_pending, cur_pending);
+    }
+
+    fprintf(out, "\n\nStreams\n%-12s %12s %12s %12s %12s %12s %12s %12s %12s\n", "Added", "Read", "Acked",
+            "Added/sec", "Read/sec", "Lag", "Max Lag", "Pending", "Max Pending");
+    fprintf(out, "%-12llu %12llu %12llu %12.2f %12.2f %12lld %12lld %12lld %12lld\n", m_stream_added, m_stream_read,
+            m_stream_acked, added_sec, read_sec, lag, max_lag, pending, max_pending);
+
+    fprintf(out, "\nStreams Latency (msec)\n%-12s %12s %12s", "Entries", "Avg", "Min");
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        char quantile_header[16];
+        snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.2f", quantiles_list[i]);
+        fprintf(out, " %12s", quantile_header);
+    }
+    fprintf(out, " %12s\n", "Max");
+    fprintf(out, "%-12lld %12.3f %12.3f", (long long) hdr_total_count(m_stream_latency_histogram), avg, min);
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        fprintf(out, " %12.3f", hdr_value_at_percentile(m_stream_latency_histogram, quantiles_list[i]) / multiplier);
+    }
+    fprintf(out, " %12.3f\n", max);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Streams");
+        jsonhandler->write_obj("Added", "%llu", m_stream_added);
+        jsonhandler->write_obj("Read", "%llu", m_stream_read);
+        jsonhandler->write_obj("Acked", "%llu", m_stream_acked);
+        jsonhandler->write_obj("Added/sec", "%.2f", added_sec);
+        jsonhandler->write_obj("Read/sec", "%.2f", read_sec);
+        jsonhandler->write_obj("Lag", "%lld", lag);
+        jsonhandler->write_obj("Max Lag", "%lld", max_lag);
+        jsonhandler->write_obj("Pending", "%lld", pending);
+        jsonhandler->write_obj("Max Pending", "%lld", max_pending);
+        jsonhandler->write_obj("Time unit", "\"%s\"", "MILLISECONDS");
+        jsonhandler->write_obj("Average Latency", "%.3f", avg);
+        jsonhandler->write_obj("Min Latency", "%.3f", min);
+        jsonhandler->write_obj("Max Latency", "%.3f", max);
+        jsonhandler->open_nesting("Percentile Latencies");
+        for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+            char quantile_header[16];
+            snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.3f", quantiles_list[i]);
+            jsonhandler->write_obj(quantile_header, "%.3f",
+                                   hdr_value_at_percentile(m_stream_latency_histogram, quantiles_list[i]) / multiplier);
+        }
+        jsonhandler->close_nesting();
+
+        jsonhandler->open_nesting("Time-Serie");
+        cur_lag = cur_pending = 0;
+        for (std::list<one_second_stats>::const_iterator i = m_stats.begin(); i != m_stats.end(); i++) {
+            char second[16];
+            snprintf(second, sizeof(second) - 1, "%u", i->m_second);
+
+            cur_lag += (long long) i->m_stream_added - (long long) i->m_stream_read;
+            cur_pending += (long long) i->m_stream_read - (long long) i->m_stream_acked;
+            jsonhandler->open_nesting(second);
+            jsonhandler->write_obj("Added", "%lu", i->m_stream_added);
+            jsonhandler->write_obj("Read", "%lu", i->m_stream_read);
+            jsonhandler->write_obj("Acked", "%lu", i->m_stream_acked);
+            jsonhandler->write_obj("Lag", "%lld", cur_lag);
+            jsonhandler->write_obj("Pending", "%lld", cur_pending);
+            jsonhandler->write_obj("Pending Growth", "%lld",
+                                   (long long) i->m_stream_read - (long long) i->m_stream_acked);
+            jsonhandler->close_nesting();
+        }
+        jsonhandler->close_nesting();
+        jsonhandler->close_nesting();
+    }
+}
+
+// One row of a latency table: count, average, min, percentiles and max
+static void print_latency_row(FILE *out, json_handler *jsonhandler, const char *name, hdr_histogram *histogram,
+                                const std::vector<double> &quantiles_list)
+{
+    const double multiplier = LATENCY_HDR_RESULTS_MULTIPLIER;
+    const double avg = hdr_mean(histogram) / multiplier;
+    const double min = hdr_min(histogram) / multiplier;
+    const double max = hdr_max(histogram) / multiplier;
+
+    fprintf(out, "%-12s %12lld %12.3f %12.3f", name, (long long) hdr_total_count(histogram), avg, min);
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        fprintf(out, " %12.3f", hdr_value_at_percentile(histogram, quantiles_list[i]) / multiplier);
+    }
+    fprintf(out, " %12.3f\n", max);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting(name);
+        jsonhandler->write_obj("Count", "%lld", (long long) hdr_total_count(histogram));
+        jsonhandler->write_obj("Average Latency", "%.3f", avg);
+        jsonhandler->write_obj("Min Latency", "%.3f", min);
+        jsonhandler->write_obj("Max Latency", "%.3f", max);
+        jsonhandler->open_nesting("Percentile Latencies");
+        for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+            char quantile_header[16];
+            snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.3f", quantiles_list[i]);
+            jsonhandler->write_obj(quantile_header, "%.3f",
+                                   hdr_value_at_percentile(histogram, quantiles_list[i]) / multiplier);
+        }
+        jsonhandler->close_nesting();
+        jsonhandler->close_nesting();
+    }
+}
+
+// The queues start empty, so their depth is what's pushed but not popped
+// yet, also reported for every second.  A pop's latency includes the time
+// it was blocked before a message arrived, so the delivery latency (push to
+// pop) and the blocked time of the pops that got a message are reported
+// apart; pops that timed out are only counted.
+void run_stats::print_queues(FILE *out, json_handler *jsonhandler)
+{
+    const unsigned long int duration_usec = ts_diff(m_start_time, m_end_time);
+    const double pushed_sec = duration_usec > 0 ? (double) m_queue_pushed / duration_usec * 1000000 : 0;
+    const double popped_sec = duration_usec > 0 ? (double) m_queue_popped / duration_usec * 1000000 : 0;
+    const long long depth = (long long) m_queue_pushed - (long long) m_queue_popped;
+
+    // running total, in the order of the seconds
+    long long max_depth = 0;
+    long long cur_depth = 0;
+    for (std::list<one_second_stats>::const_iterator i = m_stats.begin(); i != m_stats.end(); i++) {
+        cur_depth += (long long) i->m_queue_pushed - (long long) i->m_queue_popped;
+        max_depth = std::max(max_depth, cur_depth);
+    }
+
+    fprintf(out, "\n\nQueues\n%-12s %12s %12s %12s %12s %12s %12s\n", "Pushed", "Popped", "Timeouts", "Pushed/sec",
+            "Popped/sec", "Depth", "Max Depth");
+    fprintf(out, "%-12llu %12llu %12llu %12.2f %12.2f %12lld %12lld\n", m_queue_pushed, m_queue_popped,
+            m_queue_timeouts, pushed_sec, popped_sec, depth, max_depth);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Queues");
+        jsonhandler->write_obj("Pushed", "%llu", m_queue_pushed);
+        jsonhandler->write_obj("Popped", "%llu", m_queue_popped);
+        jsonhandler->write_obj("Timeouts", "%llu", m_queue_timeouts);
+        jsonhandler->write_obj("Pushed/sec", "%.2f", pushed_sec);
+        jsonhandler->write_obj("Popped/sec", "%.2f", popped_sec);
+        jsonhandler->write_obj("Depth", "%lld", depth);
+        jsonhandler->write_obj("Max Depth", "%lld", max_depth);
+        jsonhandler->write_obj("Time unit", "\"%s\"", "MILLISECONDS");
+    }
+
+    fprintf(out, "\nQueues Latency (msec)\n%-12s %12s %12s %12s", "Type", "Messages", "Avg", "Min");
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        char quantile_header[16];
+        snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.2f", quantiles_list[i]);
+        fprintf(out, " %12s", quantile_header);
+    }
+    fprintf(out, " %12s\n", "Max");
+    print_latency_row(out, jsonhandler, "Delivery", m_queue_delivery_histogram, quantiles_list);
+    print_latency_row(out, jsonhandler, "Blocked", m_queue_wait_histogram, quantiles_list);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Time-Serie");
+        cur_depth = 0;
+        for (std::list<one_second_stats>::const_iterator i = m_stats.begin(); i != m_stats.end(); i++) {
+            char second[16];
+            snprintf(second, sizeof(second) - 1, "%u", i->m_second);
+
+            cur_depth += (long long) i->m_queue_pushed - (long long) i->m_queue_popped;
+            jsonhandler->open_nesting(second);
+            jsonhandler->write_obj("Pushed", "%lu", i->m_queue_pushed);
+            jsonhandler->write_obj("Popped", "%lu", i->m_queue_popped);
+            jsonhandler->write_obj("Timeouts", "%lu", i->m_queue_timeouts);
+            jsonhandler->write_obj("Depth", "%lld", cur_depth);
+            jsonhandler->close_nesting();
+        }
+        jsonhandler->close_nesting();
+        jsonhandler->close_nesting();
+    }
+}
+
+// Writes and reads of a hash, set, sorted set or list are reported as SETs
+// and GETs of one key each; this reports the elements they carried and the
+// size of the read replies, which grows with the fields read.
+void run_stats::print_collections(FILE *out, json_handler *jsonhandler)
+{
+    const unsigned long int duration_usec = ts_diff(m_start_time, m_end_time);
+    const double written_sec = duration_usec > 0 ? (double) m_collection_written / duration_usec * 1000000 : 0;
+    const double read_sec = duration_usec > 0 ? (double) m_collection_read / duration_usec * 1000000 : 0;
+    const double per_read = m_collection_reads > 0 ? (double) m_collection_read / m_collection_reads : 0;
+    const double avg_reply = m_collection_reads > 0 ? (double) m_collection_read_bytes / m_collection_reads : 0;
+
+    fprintf(out, "\n\nData Type Elements (%s, %u fields)\n%-12s %12s %12s %12s %12s %12s %12s %12s\n",
+            get_data_type_name(m_config->data_type), m_config->data_fields, "Written", "Read", "Written/sec",
+            "Read/sec", "Reads", "Per Read", "Avg Reply", "Max Reply");
+    fprintf(out, "%-12llu %12llu %12.2f %12.2f %12llu %12.2f %12.2f %12llu\n", m_collection_written,
+            m_collection_read, written_sec, read_sec, m_collection_reads, per_read, avg_reply, m_collection_max_reply);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Data Type Elements");
+        jsonhandler->write_obj("Type", "\"%s\"", get_data_type_name(m_config->data_type));
+        jsonhandler->write_obj("Fields", "%u", m_config->data_fields);
+        jsonhandler->write_obj("Written", "%llu", m_collection_written);
+        jsonhandler->write_obj("Read", "%llu", m_collection_read);
+        jsonhandler->write_obj("Written/sec", "%.2f", written_sec);
+        jsonhandler->write_obj("Read/sec", "%.2f", read_sec);
+        jsonhandler->write_obj("Reads", "%llu", m_collection_reads);
+        jsonhandler->write_obj("Per Read", "%.2f", per_read);
+        jsonhandler->write_obj("Avg Reply Bytes", "%.2f", avg_reply);
+        jsonhandler->write_obj("Max Reply Bytes", "%llu", m_collection_max_reply);
+
+        jsonhandler->open_nesting("Time-Serie");
+        for (std::list<one_second_stats>::const_iterator i = m_stats.begin(); i != m_stats.end(); i++) {
+            char second[16];
+            snprintf(second, sizeof(second) - 1, "%u", i->m_second);
+
+            jsonhandler->open_nesting(second);
+            jsonhandler->write_obj("Written", "%lu", i->m_collection_written);
+            jsonhandler->write_obj("Read", "%lu", i->m_collection_read);
+            jsonhandler->close_nesting();
+        }
+        jsonhandler->close_nesting();
+        jsonhandler->close_nesting();
+    }
+}
+
+// The time to first byte of a reply is mostly the server's time, the rest
+// of its latency up to the last byte the transfer of a large reply.  Each
+// command gets a TTFB row and a TTLB row, from its latency histogram.
+void run_stats::print_first_byte(FILE *out, json_handler *jsonhandler, arbitrary_command_list &command_list)
+{
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Time To First Byte");
+        jsonhandler->write_obj("Time unit", "\"%s\"", "MILLISECONDS");
+    }
+
+    fprintf(out, "\n\nTime To First/Last Byte (msec)\n%-12s %12s %12s %12s", "Type", "Count", "Avg", "Min");
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        char quantile_header[16];
+        snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.2f", quantiles_list[i]);
+        fprintf(out, " %12s", quantile_header);
+    }
+    fprintf(out, " %12s\n", "Max");
+
+    if (print_arbitrary_commands_results()) {
+        for (unsigned int i = 0; i < command_list.size(); i++) {
+            if (hdr_total_count(m_ar_commands_latency_histograms[i]) == 0) continue;
+
+            std::string name = command_list[i].command_name;
+            print_latency_row(out, jsonhandler, (name + " TTFB").c_str(), m_ar_commands_first_byte_histograms[i],
+                              quantiles_list);
+            print_latency_row(out, jsonhandler, (name + " TTLB").c_str(), m_ar_commands_latency_histograms[i],
+                              quantiles_list);
+        }
+    } else {
+        if (hdr_total_count(m_set_latency_histogram) > 0) {
+            print_latency_row(out, jsonhandler, "Sets TTFB", m_set_first_byte_histogram, quantiles_list);
+            print_latency_row(out, jsonhandler, "Sets TTLB", m_set_latency_histogram, quantiles_list);
+        }
+        if (hdr_total_count(m_get_latency_histogram) > 0) {
+            print_latency_row(out, jsonhandler, "Gets TTFB", m_get_first_byte_histogram, quantiles_list);
+            print_latency_row(out, jsonhandler, "Gets TTLB", m_get_latency_histogram, quantiles_list);
+        }
+    }
+
+    if (jsonhandler != NULL) jsonhandler->close_nesting();
+}
+
+// One row of the "Shards" table, see print_shards
+static void print_shard_row(FILE *out, json_handler *jsonhandler, const char *name, const shard_stats &s,
+                            double duration_sec, const std::vector<double> &quantiles_list)
+{
+    const double multiplier = LATENCY_HDR_RESULTS_MULTIPLIER;
+    const char *role = s.m_replica ? "replica" : "primary";
+    const double ops_sec = per_second(s.m_ops, duration_sec);
+    const double hits_sec = per_second(s.m_hits, duration_sec);
+    const double misses_sec = per_second(s.m_misses, duration_sec);
+    const double moved_sec = per_second(s.m_moved, duration_sec);
+    const double ask_sec = per_second(s.m_ask, duration_sec);
+    const double avg_latency = hdr_mean(s.m_latency_histogram) / multiplier;
+    const double kb_sec = per_second(s.m_bytes, duration_sec) / 1024;
+
+    fprintf(out, "%-22s %-8s %12.2f %12.2f %12.2f %12.2f %12.2f %12.3f", name, role, ops_sec, hits_sec, misses_sec,
+            moved_sec, ask_sec, avg_latency);
+    for (std::size_t j = 0; j < quantiles_list.size(); j++) {
+        fprintf(out, " %12.3f", hdr_value_at_percentile(s.m_latency_histogram, quantiles_list[j]) / multiplier);
+    }
+    fprintf(out, " %12.2f\n", kb_sec);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting(name);
+        jsonhandler->write_obj("Role", "\"%s\"", role);
+        jsonhandler->write_obj("Count", "%llu", s.m_ops);
+        jsonhandler->write_obj("Ops/sec", "%.2f", ops_sec);
+        jsonhandler->write_obj("Hits/sec", "%.2f", hits_sec);
+        jsonhandler->write_obj("Misses/sec", "%.2f", misses_sec);
+        jsonhandler->write_obj("MOVED/sec", "%.2f", moved_sec);
+        jsonhandler->write_obj("ASK/sec", "%.2f", ask_sec);
+        jsonhandler->write_obj("Average Latency", "%.3f", avg_latency);
+        jsonhandler->open_nesting("Percentile Latencies");
+        for (std::size_t j = 0; j < quantiles_list.size(); j++) {
+            char quantile_header[16];
+            snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.3f", quantiles_list[j]);
+            jsonhandler->write_obj(quantile_header, "%.3f",
+                                   hdr_value_at_percentile(s.m_latency_histogram, quantiles_list[j]) / multiplier);
+        }
+        jsonhandler->close_nesting();
+        jsonhandler->write_obj("KB/sec", "%.2f", kb_sec);
+        jsonhandler->close_nesting();
+    }
+}
+
+// A hot or slow shard is lost in the totals, so every shard endpoint gets
+// its own row, followed by how far the busiest shard is from the idlest
+// one and from the average, as a hint of slot imbalance.  When replicas
+// serve reads, the primaries and the replicas are also summed up apart.
+void run_stats::print_shards(FILE *out, json_handler *jsonhandler)
+{
+    const double duration_sec = ts_diff(m_start_time, m_end_time) / 1000000.0;
+
+    char header[256];
+    int header_len = snprintf(header, sizeof(header), "%-22s %-8s %12s %12s %12s %12s %12s %12s", "Shard", "Role",
+                              "Ops/sec", "Hits/sec", "Misses/sec", "MOVED/sec", "ASK/sec", "Avg Latency");
+    std::string columns(header, header_len);
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        char quantile_header[16];
+        snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.2f", quantiles_list[i]);
+        snprintf(header, sizeof(header), " %12s", quantile_header);
+        columns += header;
+    }
+    snprintf(header, sizeof(header), " %12s", "KB/sec");
+    columns += header;
+
+    fprintf(out, "\n\nShards\n%s\n", columns.c_str());
+    if (jsonhandler != NULL) jsonhandler->open_nesting("Shards");
+
+    // index 0 sums up the primaries, 1 the replicas
+    shard_stats roles[2];
+    roles[1].m_replica = true;
+    for (std::map<std::string, shard_stats>::iterator i = m_shard_stats.begin(); i != m_shard_stats.end(); i++) {
+        print_shard_row(out, jsonhandler, i->first.c_str(), i->second, duration_sec, quantiles_list);
+        roles[i->second.m_replica ? 1 : 0].merge(i->second);
+    }
+
+    if (roles[1].m_ops > 0) {
+        fprintf(out, "\nShard Roles\n%s\n", columns.c_str());
+        if (jsonhandler != NULL) jsonhandler->open_nesting("Roles");
+        print_shard_row(out, jsonhandler, "Primaries", roles[0], duration_sec, quantiles_list);
+        print_shard_row(out, jsonhandler, "Replicas", roles[1], duration_sec, quantiles_list);
+        if (jsonhandler != NULL) jsonhandler->close_nesting();
+    }
+
+    shard_skew skew(m_shard_stats, duration_sec);
+    fprintf(out, "\nShard Skew\n%-22s %12s %-22s %12s %12s %12s\n", "Max Shard", "Ops/sec", "Min Shard", "Ops/sec",
+            "Max/Min", "Max/Avg");
+    fprintf(out, "%-22s %12.2f %-22s %12.2f %12.2f %12.2f\n", skew.max_shard.c_str(), skew.max_ops_sec,
+            skew.min_shard.c_str(), skew.min_ops_sec, skew.max_min(), skew.max_avg());
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Skew");
+        jsonhandler->write_obj("Max Shard", "\"%s\"", skew.max_shard.c_str());
+        jsonhandler->write_obj("Max Ops/sec", "%.2f", skew.max_ops_sec);
+        jsonhandler->write_obj("Min Shard", "\"%s\"", skew.min_shard.c_str());
+        jsonhandler->write_obj("Min Ops/sec", "%.2f", skew.min_ops_sec);
+        jsonhandler->write_obj("Max/Min", "%.2f", skew.max_min());
+        jsonhandler->write_obj("Max/Avg", "%.2f", skew.max_avg());
+        jsonhandler->close_nesting();
+        jsonhandler->close_nesting();
+    }
+}
+
+// throughput is back once a second reaches this share of the baseline, and
+// a second below the other share counts as unavailable
+#define AVAILABILITY_RECOVERED_RATIO 0.9
+#define AVAILABILITY_DOWN_RATIO 0.1
+
+static const char *availability_event_name(availability_event_type type)
+{
+    switch (type) {
+    case ae_connection_error:
+        return "Connection errors";
+    case ae_error_reply:
+        return "Error replies";
+    case ae_moved:
+        return "MOVED storm";
+    case ae_ask:
+        return "ASK redirects";
+    case ae_topology_change:
+        return "Topology change";
+    case ae_reconnected:
+        return "Reconnected";
+    default:
+        return "Unknown";
+    }
+}
+
+static void print_availability_event(FILE *out, json_handler *jsonhandler, double at, const char *event,
+                                     const char *detail)
+{
+    if (detail != NULL)
+        fprintf(out, "%12.3f  %s (%s)\n", at, event, detail);
+    else
+        fprintf(out, "%12.3f  %s\n", at, event);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting(NULL);
+        jsonhandler->write_obj("Time (sec)", "%.3f", at);
+        jsonhandler->write_obj("Event", "\"%s\"", event);
+        if (detail != NULL) jsonhandler->write_obj("Detail", "\"%s\"", detail);
+        jsonhandler->close_nesting();
+    }
+}
+
+static bool availability_event_predicate(const availability_event &a, const availability_event &b)
+{
+    return timercmp(&a.m_time, &b.m_time, <);
+}
+
+// The run is seen through its successful requests per second: the baseline
+// is their rate before the first disruption, and throughput has recovered
+// at the first second after the last disruption that gets back close to
+// it.  Every connection keeps its own events, so the merged timeline only
+// keeps the first event of a kind within a second.  The timelines of
+// several runs can't be averaged, so their average only has the counters.
+void run_stats::print_availability(FILE *out, json_handler *jsonhandler)
+{
+    if (m_availability_events.empty()) {
+        fprintf(out, "\n\nAvailability\n%12s %12s\n", "Failed", "Retried");
+        fprintf(out, "%12llu %12llu\n", m_requests_failed, m_requests_retried);
+
+        if (jsonhandler != NULL) {
+            jsonhandler->open_nesting("Availability");
+            jsonhandler->write_obj("Requests Failed", "%llu", m_requests_failed);
+            jsonhandler->write_obj("Requests Retried", "%llu", m_requests_retried);
+            jsonhandler->close_nesting();
+        }
+        return;
+    }
+
+    const long long first_error = MAX(0, ts_diff(m_start_time, m_first_error));
+    const long long last_error = MAX(0, ts_diff(m_start_time, m_last_error));
+    const unsigned int first_second = first_error / 1000000;
+    const unsigned int last_second = last_error / 1000000;
+
+    // successful requests of every second, including the ones without any
+    std::vector<double> ops;
+    for (std::list<one_second_stats>::iterator i = m_stats.begin(); i != m_stats.end(); i++) {
+        if (i->m_second >= ops.size()) ops.resize(i->m_second + 1, 0);
+        ops[i->m_second] += i->m_total_cmd.m_ops - MIN(i->m_total_cmd.m_ops, i->m_error_replies);
+    }
+
+    double baseline = 0;
+    for (unsigned int i = 0; i < first_second && i < ops.size(); i++) {
+        baseline += ops[i] / first_second;
+    }
+
+    // without a baseline, any successful request counts
+    long long recovered = -1;
+    unsigned int unavailable = 0;
+    for (unsigned int i = first_second; i < ops.size(); i++) {
+        if (i > last_second && ops[i] > 0 && ops[i] >= AVAILABILITY_RECOVERED_RATIO * baseline) {
+            recovered = i;
+            break;
+        }
+        if (ops[i] == 0 || ops[i] < AVAILABILITY_DOWN_RATIO * baseline) unavailable++;
+    }
+
+    std::vector<availability_event> events(m_availability_events);
+    std::stable_sort(events.begin(), events.end(), availability_event_predicate);
+
+    fprintf(out, "\n\nAvailability\n%16s %12s %12s %12s %12s %12s %12s\n", "Baseline Ops/sec", "First Error",
+            "Last Error", "Recovered", "Unavailable", "Failed", "Retried");
+    fprintf(out, "%16.2f %12.3f %12.3f ", baseline, first_error / 1000000.0, last_error / 1000000.0);
+    if (recovered >= 0)
+        fprintf(out, "%12.3f", (double) recovered);
+    else
+        fprintf(out, "%12s", "never");
+    fprintf(out, " %12u %12llu %12llu\n", unavailable, m_requests_failed, m_requests_retried);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Availability");
+        jsonhandler->write_obj("Baseline Ops/sec", "%.2f", baseline);
+        jsonhandler->write_obj("First Error (sec)", "%.3f", first_error / 1000000.0);
+        jsonhandler->write_obj("Last Error (sec)", "%.3f", last_error / 1000000.0);
+        if (recovered >= 0) {
+            jsonhandler->write_obj("Recovered (sec)", "%lld", recovered);
+            jsonhandler->write_obj("Recovery Time (sec)", "%.3f", recovered - first_error / 1000000.0);
+        } else {
+            jsonhandler->write_obj("Recovered (sec)", "null");
+            jsonhandler->write_obj("Recovery Time (sec)", "null");
+        }
+        jsonhandler->write_obj("Seconds Unavailable", "%u", unavailable);
+        jsonhandler->write_obj("Requests Failed", "%llu", m_requests_failed);
+        jsonhandler->write_obj("Requests Retried", "%llu", m_requests_retried);
+        jsonhandler->open_nesting("Timeline", NESTED_ARRAY);
+    }
+
+    fprintf(out, "\n%12s  %s\n", "Time (sec)", "Event");
+    struct timeval last_event[ae_count];
+    memset(last_event, 0, sizeof(last_event));
+    bool first = true;
+    bool last = false;
+    bool back = recovered < 0;
+    for (std::vector<availability_event>::iterator i = events.begin(); i != events.end(); i++) {
+        struct timeval &prev = last_event[i->m_type];
+        bool repeated = timerisset(&prev) && ts_diff(prev, i->m_time) < 1000000;
+        prev = i->m_time;
+        if (repeated) continue;
+
+        long long at = MAX(0, ts_diff(m_start_time, i->m_time));
+        if (!last && at > last_error) {
+            print_availability_event(out, jsonhandler, last_error / 1000000.0, "Last error", NULL);
+            last = true;
+        }
+        if (!back && at > recovered * 1000000) {
+            print_availability_event(out, jsonhandler, recovered, "Throughput recovered", NULL);
+            back = true;
+        }
+
+        const char *name = availability_event_name(i->m_type);
+        if (first && i->m_type != ae_topology_change && i->m_type != ae_reconnected) {
+            print_availability_event(out, jsonhandler, at / 1000000.0, "First error", name);
+            first = false;
+        }
+        print_availability_event(out, jsonhandler, at / 1000000.0, name, NULL);
+    }
+    if (!last) print_availability_event(out, jsonhandler, last_error / 1000000.0, "Last error", NULL);
+    if (!back) print_availability_event(out, jsonhandler, recovered, "Throughput recovered", NULL);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->close_nesting();
+        jsonhandler->close_nesting();
+    }
+}
+
+// The latency of a scattered request is the one of its slowest part, so
+// the more nodes it fans out to, the more their tail latency shows.
+void run_stats::print_fanout(FILE *out, json_handler *jsonhandler)
+{
+    const double duration_sec = ts_diff(m_start_time, m_end_time) / 1000000.0;
+    const double multiplier = LATENCY_HDR_RESULTS_MULTIPLIER;
+
+    fprintf(out, "\n\nFan-out\n%-8s %12s %12s %12s", "Nodes", "Ops/sec", "Keys/op", "Avg Latency");
+    for (std::size_t i = 0; i < quantiles_list.size(); i++) {
+        char quantile_header[16];
+        snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.2f", quantiles_list[i]);
+        fprintf(out, " %12s", quantile_header);
+    }
+    fprintf(out, "\n");
+    if (jsonhandler != NULL) jsonhandler->open_nesting("Fan-out");
+
+    for (std::map<unsigned int, fanout_stats>::iterator i = m_fanout_stats.begin(); i != m_fanout_stats.end(); i++) {
+        const fanout_stats &f = i->second;
+        const double ops_sec = per_second(f.m_ops, duration_sec);
+        const double keys_op = f.m_ops ? (double) f.m_keys / f.m_ops : 0;
+        const double avg_latency = hdr_mean(f.m_latency_histogram) / multiplier;
+
+        fprintf(out, "%-8u %12.2f %12.2f %12.3f", i->first, ops_sec, keys_op, avg_latency);
+        for (std::size_t j = 0; j < quantiles_list.size(); j++) {
+            fprintf(out, " %12.3f", hdr_value_at_percentile(f.m_latency_histogram, quantiles_list[j]) / multiplier);
+        }
+        fprintf(out, "\n");
+
+        if (jsonhandler != NULL) {
+            char width[16];
+            snprintf(width, sizeof(width), "%u", i->first);
+            jsonhandler->open_nesting(width);
+            jsonhandler->write_obj("Count", "%llu", f.m_ops);
+            jsonhandler->write_obj("Ops/sec", "%.2f", ops_sec);
+            jsonhandler->write_obj("Keys/op", "%.2f", keys_op);
+            jsonhandler->write_obj("Average Latency", "%.3f", avg_latency);
+            jsonhandler->open_nesting("Percentile Latencies");
+            for (std::size_t j = 0; j < quantiles_list.size(); j++) {
+                char quantile_header[16];
+                snprintf(quantile_header, sizeof(quantile_header) - 1, "p%.3f", quantiles_list[j]);
+                jsonhandler->write_obj(quantile_header, "%.3f",
+                                       hdr_value_at_percentile(f.m_latency_histogram, quantiles_list[j]) / multiplier);
+            }
+            jsonhandler->close_nesting();
+            jsonhandler->close_nesting();
+        }
+    }
+
+    if (jsonhandler != NULL) jsonhandler->close_nesting();
+}
+
+// How evenly the key range falls into the cluster's hash slots, out of the
+// slot of every key cached at startup.  The heaviest slot bounds how evenly
+// the keys can spread over the shards, whatever the slots' assignment.
+void run_stats::print_keyspace_slots(FILE *out, json_handler *jsonhandler, const slot_key_map *slot_keys)
+{
+    const unsigned long long keys = slot_keys->get_key_maximum() - slot_keys->get_key_minimum() + 1;
+    unsigned int used_slots = 0;
+    unsigned int min_keys = UINT_MAX;
+    unsigned int max_keys = 0;
+    unsigned int max_slot = 0;
+
+    for (unsigned int slot = 0; slot < slot_keys->get_slots(); slot++) {
+        unsigned int slot_size = slot_keys->get_slot_size(slot);
+        if (slot_size > 0) used_slots++;
+        if (slot_size < min_keys) min_keys = slot_size;
+        if (slot_size > max_keys) {
+            max_keys = slot_size;
+            max_slot = slot;
+        }
+    }
+    const double avg_keys = (double) keys / slot_keys->get_slots();
+
+    fprintf(out, "\n\nKeyspace Slots\n%-14s %12s %12s %12s %12s %12s %14s\n", "Keys", "Slots Used", "Min/Slot",
+            "Avg/Slot", "Max/Slot", "Max/Avg", "Heaviest Slot");
+    fprintf(out, "%-14llu %12u %12u %12.2f %12u %12.2f %14u\n", keys, used_slots, min_keys, avg_keys, max_keys,
+            max_keys / avg_keys, max_slot);
+
+    if (jsonhandler != NULL) {
+        jsonhandler->open_nesting("Keyspace Slots");
+        jsonhandler->write_obj("Keys", "%llu", keys);
+        jsonhandler->write_obj("Slots Used", "%u", used_slots);
+        jsonhandler->write_obj("Min Keys/Slot", "%u", min_keys);
+        jsonhandler->write_obj("Avg Keys/Slot", "%.2f", avg_keys);
+        jsonhandler->write_obj("Max Keys/Slot", "%u", max_keys);
+        jsonhandler->write_obj("Max/Avg", "%.2f", max_keys / avg_keys);
+        jsonhandler->write_obj("Heaviest Slot", "%u", max_slot);
+        jsonhandler->close_nesting();
+    }
+}
+
 void run_stats::print(FILE *out, benchmark_config *config, const char *header /*=NULL*/,
                       json_handler *jsonhandler /*=NULL*/)
 {
@@ -1691,6 +2998,58 @@ void run_stats::print(FILE *out, benchmark_config *config, const char *header /*
         print_histogram(out, jsonhandler, *config->arbitrary_commands, aggregated_ptr);
     }
 
+    if (hdr_total_count(m_connect_time_histogram) > 0) {
+        print_connection_setup(out, jsonhandler);
+    }
+
+    if (m_tls_full_handshakes + m_tls_resumed_handshakes > 0) {
+        print_tls_handshakes(out, jsonhandler);
+    }
+
+    if (m_invalidated_keys + m_invalidation_flushes > 0) {
+        print_invalidations(out, jsonhandler);
+    }
+
+    if (m_pubsub_subscribers > 0) {
+        print_pubsub(out, jsonhandler);
+    }
+
+    if (m_stream_added + m_stream_read > 0) {
+        print_streams(out, jsonhandler);
+    }
+
+    if (m_queue_pushed + m_queue_popped + m_queue_timeouts > 0) {
+        print_queues(out, jsonhandler);
+    }
+
+    if (m_collection_written + m_collection_reads > 0) {
+        print_collections(out, jsonhandler);
+    }
+
+    if (config->first_byte_stats) {
+        print_first_byte(out, jsonhandler, *config->arbitrary_commands);
+    }
+
+    if (!m_shard_stats.empty()) {
+        print_shards(out, jsonhandler);
+    }
+
+    if (!m_fanout_stats.empty()) {
+        print_fanout(out, jsonhandler);
+    }
+
+    if (config->slot_keys != NULL) {
+        print_keyspace_slots(out, jsonhandler, config->slot_keys);
+    }
+
+    if (!m_availability_events.empty() || m_requests_failed > 0 || m_requests_retried > 0) {
+        print_availability(out, jsonhandler);
+    }
+
+    if (config->thread_stats && !m_thread_overhead.empty()) {
+        print_thread_overhead(out, jsonhandler);
+    }
+
     // This close_nesting closes either:
     //      jsonhandler->open_nesting(header); or
     //      jsonhandler->open_nesting("UNKNOWN STATS");
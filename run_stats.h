@@ -42,6 +42,7 @@ struct reinit_mutex_t
 #include "memtier_benchmark.h"
 #include "run_stats_types.h"
 #include "JSON_handler.h"
+#include "thread_overhead.h"
 #include "deps/hdr_histogram/hdr_histogram.h"
 #include "deps/hdr_histogram/hdr_histogram_log.h"
 
@@ -153,6 +154,12 @@ protected:
     std::vector<safe_hdr_histogram> m_ar_commands_latency_histograms;
     safe_hdr_histogram m_totals_latency_histogram;
 
+    // time to first byte of the replies, with --first-byte-stats; the
+    // latency histograms above hold their time to last byte
+    safe_hdr_histogram m_get_first_byte_histogram;
+    safe_hdr_histogram m_set_first_byte_histogram;
+    std::vector<safe_hdr_histogram> m_ar_commands_first_byte_histograms;
+
     // instantaneous command stats ( used in the per second latencies )
     safe_hdr_histogram inst_m_get_latency_histogram;
     safe_hdr_histogram inst_m_set_latency_histogram;
@@ -165,7 +172,84 @@ protected:
     // this mutex serializes hdr_reset and hdr_add from the main thread.
     reinit_mutex_t m_inst_histogram_mutex;
 
+    // per-thread self-overhead, filled in by run_benchmark() after the threads join
+    std::vector<thread_overhead_stats> m_thread_overhead;
+
+    // connection bring-up: time of every successful connect, and how long it
+    // took from preparing the run until all clients were connected (0 if never)
+    safe_hdr_histogram m_connect_time_histogram;
+    unsigned long long m_all_connected_usec;
+
+    // TLS handshakes completed, split by whether the session was resumed,
+    // and how many connections ended up with kernel TLS in both directions
+    unsigned long long m_tls_full_handshakes;
+    unsigned long long m_tls_resumed_handshakes;
+    unsigned long long m_ktls_connections;
+
+    // client tracking: delay from the SET of a key to the delivery of its
+    // invalidation, keys invalidated and whole-cache flushes received
+    safe_hdr_histogram m_invalidation_latency_histogram;
+    unsigned long long m_invalidated_keys;
+    unsigned long long m_invalidation_flushes;
+
+    // pub/sub: publish-to-receive latency and deliveries on the subscriber
+    // side; publishes and the receivers counted by the server on the
+    // publisher side.  Every subscriber adds its own delivery rate and count
+    // once it's done, so merged stats know the spread between subscribers.
+    safe_hdr_histogram m_pubsub_latency_histogram;
+    unsigned long long m_pubsub_delivered;
+    unsigned long long m_pubsub_published;
+    unsigned long long m_pubsub_receivers;
+    unsigned int m_pubsub_subscribers;
+    double m_pubsub_sub_rate_min;
+    double m_pubsub_sub_rate_max;
+    double m_pubsub_sub_rate_sum;
+    unsigned long long m_pubsub_sub_delivered_min;
+
+    // streams: add-to-read latency of the entries read by the consumers, and
+    // the entries added, read and acknowledged.  Per second counts are kept
+    // in one_second_stats, for the consumer lag and pending entries over time.
+    safe_hdr_histogram m_stream_latency_histogram;
+    unsigned long long m_stream_added;
+    unsigned long long m_stream_read;
+    unsigned long long m_stream_acked;
+
+    // blocking queues: push-to-pop delivery latency and the time each pop
+    // that got a message was blocked, kept apart since a consumer may wait
+    // long before a message is even pushed.  Per second counts are kept in
+    // one_second_stats, for the queue depth over time.
+    safe_hdr_histogram m_queue_delivery_histogram;
+    safe_hdr_histogram m_queue_wait_histogram;
+    unsigned long long m_queue_pushed;
+    unsigned long long m_queue_popped;
+    unsigned long long m_queue_timeouts;
+
+    // hash, set, sorted set and list workloads: elements written and read,
+    // which are also kept per second, and the size of the read replies
+    unsigned long long m_collection_written;
+    unsigned long long m_collection_read;
+    unsigned long long m_collection_reads;
+    unsigned long long m_collection_read_bytes;
+    unsigned long long m_collection_max_reply;
+
+    // cluster mode and --servers: requests per shard endpoint (address:port), and
+    // multi-key requests by the number of shards they were scattered over
+    std::map<std::string, shard_stats> m_shard_stats;
+    std::map<unsigned int, fanout_stats> m_fanout_stats;
+
+    // availability: the first and last disruption of any kind (connection
+    // error, error reply, MOVED or ASK), the start of every burst of each
+    // kind and the topology changes, for the recovery timeline, and the
+    // requests that failed or were sent again
+    struct timeval m_first_error;
+    struct timeval m_last_error;
+    struct timeval m_last_event[ae_count];
+    std::vector<availability_event> m_availability_events;
+    unsigned long long m_requests_failed;
+    unsigned long long m_requests_retried;
+
     void roll_cur_stats(struct timeval *ts);
+    void update_availability(struct timeval *ts, availability_event_type type);
 
 public:
     run_stats(benchmark_config *config);
@@ -174,11 +258,41 @@ public:
     void set_end_time(struct timeval *end_time);
     void set_interrupted(bool interrupted) { m_interrupted = interrupted; }
     bool get_interrupted() const { return m_interrupted; }
+    void add_thread_overhead(const thread_overhead_stats &stats) { m_thread_overhead.push_back(stats); }
+    void set_all_connected_usec(unsigned long long usec) { m_all_connected_usec = usec; }
 
     void update_get_op(struct timeval *ts, unsigned int bytes_rx, unsigned int bytes_tx, unsigned int latency,
                        unsigned int hits, unsigned int misses);
     void update_set_op(struct timeval *ts, unsigned int bytes_rx, unsigned int bytes_tx, unsigned int latency);
+    void update_get_first_byte(unsigned int latency);
+    void update_set_first_byte(unsigned int latency);
+    void update_arbitrary_first_byte(unsigned int latency, size_t request_index);
+    shard_stats *get_shard_stats(const char *endpoint) { return &m_shard_stats[endpoint]; }
+    void update_fanout_op(unsigned int width, unsigned int keys, unsigned int latency)
+    {
+        m_fanout_stats[width].update_op(keys, latency);
+    }
     void update_connection_error(struct timeval *ts);
+    void update_error_reply(struct timeval *ts);
+    void update_topology_change(struct timeval *ts) { update_availability(ts, ae_topology_change); }
+    void update_reconnect(struct timeval *ts) { update_availability(ts, ae_reconnected); }
+    void update_request_retried(void) { m_requests_retried++; }
+    void update_connect_time(unsigned long long connect_usec);
+    void update_tls_handshake(bool resumed, bool ktls);
+    void update_invalidation(unsigned long long latency_usec);
+    void update_invalidation_flush(void) { m_invalidation_flushes++; }
+    void update_pubsub_message(unsigned long long latency_usec);
+    void update_pubsub_publish(unsigned long long receivers);
+    void update_pubsub_subscriber_done(void);
+    void update_stream_add(struct timeval *ts);
+    void update_stream_read(struct timeval *ts, unsigned long long latency_usec);
+    void update_stream_ack(struct timeval *ts, unsigned long long entries);
+    unsigned long long get_stream_read(void) const { return m_stream_read; }
+    void update_queue_push(struct timeval *ts, unsigned long long messages);
+    void update_queue_pop(struct timeval *ts, unsigned long long delivery_usec, unsigned long long wait_usec);
+    void update_queue_timeout(struct timeval *ts);
+    void update_collection_write(struct timeval *ts, unsigned int elements);
+    void update_collection_read(struct timeval *ts, unsigned int elements, unsigned int reply_bytes);
 
     void update_moved_get_op(struct timeval *ts, unsigned int bytes_rx, unsigned int bytes_tx, unsigned int latency);
     void update_moved_set_op(struct timeval *ts, unsigned int bytes_rx, unsigned int bytes_tx, unsigned int latency);
@@ -211,6 +325,8 @@ public:
     // Use this instead of a raw pointer getter to avoid data races with worker threads.
     void copy_inst_histogram(hdr_histogram *target) const;
     void save_csv_one_sec_cluster(FILE *f);
+    void save_csv_shards(FILE *f);
+    void save_csv_fanout(FILE *f);
     void save_csv_set_get_commands(FILE *f, bool cluster_mode);
     void save_csv_arbitrary_commands_one_sec(FILE *f, arbitrary_command_list &command_list,
                                              std::vector<unsigned long int> &total_arbitrary_commands_ops);
@@ -251,6 +367,19 @@ public:
                     const std::vector<aggregated_command_type_stats> *aggregated = nullptr);
     void print_histogram(FILE *out, json_handler *jsonhandler, arbitrary_command_list &command_list,
                          const std::vector<aggregated_command_type_stats> *aggregated = nullptr);
+    void print_thread_overhead(FILE *out, json_handler *jsonhandler);
+    void print_connection_setup(FILE *out, json_handler *jsonhandler);
+    void print_tls_handshakes(FILE *out, json_handler *jsonhandler);
+    void print_invalidations(FILE *out, json_handler *jsonhandler);
+    void print_pubsub(FILE *out, json_handler *jsonhandler);
+    void print_streams(FILE *out, json_handler *jsonhandler);
+    void print_queues(FILE *out, json_handler *jsonhandler);
+    void print_collections(FILE *out, json_handler *jsonhandler);
+    void print_first_byte(FILE *out, json_handler *jsonhandler, arbitrary_command_list &command_list);
+    void print_shards(FILE *out, json_handler *jsonhandler);
+    void print_fanout(FILE *out, json_handler *jsonhandler);
+    void print_availability(FILE *out, json_handler *jsonhandler);
+    void print_keyspace_slots(FILE *out, json_handler *jsonhandler, const slot_key_map *slot_keys);
     void print(FILE *file, benchmark_config *config, const char *header = NULL, json_handler *jsonhandler = NULL);
 
     unsigned int get_duration(void);
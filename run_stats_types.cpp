@@ -180,7 +180,21 @@ size_t ar_one_sec_cmd_stats::size() const
 
 
 one_second_stats::one_second_stats(unsigned int second) :
-        m_set_cmd(), m_get_cmd(), m_wait_cmd(), m_total_cmd(), m_ar_commands(), m_connection_errors(0)
+        m_set_cmd(),
+        m_get_cmd(),
+        m_wait_cmd(),
+        m_total_cmd(),
+        m_ar_commands(),
+        m_connection_errors(0),
+        m_error_replies(0),
+        m_stream_added(0),
+        m_stream_read(0),
+        m_stream_acked(0),
+        m_queue_pushed(0),
+        m_queue_popped(0),
+        m_queue_timeouts(0),
+        m_collection_written(0),
+        m_collection_read(0)
 {
     reset(second);
 }
@@ -199,6 +213,15 @@ void one_second_stats::reset(unsigned int second)
     m_total_cmd.reset();
     m_ar_commands.reset();
     m_connection_errors = 0;
+    m_error_replies = 0;
+    m_stream_added = 0;
+    m_stream_read = 0;
+    m_stream_acked = 0;
+    m_queue_pushed = 0;
+    m_queue_popped = 0;
+    m_queue_timeouts = 0;
+    m_collection_written = 0;
+    m_collection_read = 0;
 }
 
 void one_second_stats::merge(const one_second_stats &other)
@@ -209,6 +232,15 @@ void one_second_stats::merge(const one_second_stats &other)
     m_total_cmd.merge(other.m_total_cmd);
     m_ar_commands.merge(other.m_ar_commands);
     m_connection_errors += other.m_connection_errors;
+    m_error_replies += other.m_error_replies;
+    m_stream_added += other.m_stream_added;
+    m_stream_read += other.m_stream_read;
+    m_stream_acked += other.m_stream_acked;
+    m_queue_pushed += other.m_queue_pushed;
+    m_queue_popped += other.m_queue_popped;
+    m_queue_timeouts += other.m_queue_timeouts;
+    m_collection_written += other.m_collection_written;
+    m_collection_read += other.m_collection_read;
 }
 
 ///////////////////////////////////////////////////////////////////////////
@@ -368,3 +400,71 @@ void totals::update_connection_error()
 {
     m_connection_errors++;
 }
+
+shard_stats::shard_stats() : m_ops(0), m_hits(0), m_misses(0), m_moved(0), m_ask(0), m_bytes(0), m_replica(false) {}
+
+void shard_stats::update_op(unsigned int bytes, unsigned int latency, unsigned int hits, unsigned int misses)
+{
+    m_ops++;
+    m_hits += hits;
+    m_misses += misses;
+    m_bytes += bytes;
+    hdr_record_value_capped(m_latency_histogram, latency);
+}
+
+void shard_stats::update_moved_op(unsigned int bytes, unsigned int latency)
+{
+    m_moved++;
+    update_op(bytes, latency, 0, 0);
+}
+
+void shard_stats::update_ask_op(unsigned int bytes, unsigned int latency)
+{
+    m_ask++;
+    update_op(bytes, latency, 0, 0);
+}
+
+void shard_stats::merge(const shard_stats &other)
+{
+    m_ops += other.m_ops;
+    m_hits += other.m_hits;
+    m_misses += other.m_misses;
+    m_moved += other.m_moved;
+    m_ask += other.m_ask;
+    m_bytes += other.m_bytes;
+    m_replica = other.m_replica;
+    hdr_add(m_latency_histogram, other.m_latency_histogram);
+}
+
+// the counters of several runs merged, averaged over them
+void shard_stats::aggregate_average(size_t stats_size)
+{
+    m_ops /= stats_size;
+    m_hits /= stats_size;
+    m_misses /= stats_size;
+    m_moved /= stats_size;
+    m_ask /= stats_size;
+    m_bytes /= stats_size;
+}
+
+fanout_stats::fanout_stats() : m_ops(0), m_keys(0) {}
+
+void fanout_stats::update_op(unsigned int keys, unsigned int latency)
+{
+    m_ops++;
+    m_keys += keys;
+    hdr_record_value_capped(m_latency_histogram, latency);
+}
+
+void fanout_stats::merge(const fanout_stats &other)
+{
+    m_ops += other.m_ops;
+    m_keys += other.m_keys;
+    hdr_add(m_latency_histogram, other.m_latency_histogram);
+}
+
+void fanout_stats::aggregate_average(size_t stats_size)
+{
+    m_ops /= stats_size;
+    m_keys /= stats_size;
+}
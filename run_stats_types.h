@@ -140,6 +140,15 @@ public:
     one_sec_cmd_stats m_total_cmd;
     ar_one_sec_cmd_stats m_ar_commands;
     unsigned int m_connection_errors;
+    unsigned int m_error_replies; // MOVED and ASK included, counted in the ops too
+    unsigned long m_stream_added;
+    unsigned long m_stream_read;
+    unsigned long m_stream_acked;
+    unsigned long m_queue_pushed;
+    unsigned long m_queue_popped;
+    unsigned long m_queue_timeouts;
+    unsigned long m_collection_written;
+    unsigned long m_collection_read;
     one_second_stats(unsigned int second);
     void setup_arbitrary_commands(size_t n_arbitrary_commands);
     void reset(unsigned int second);
@@ -218,5 +227,59 @@ public:
     void update_connection_error();
 };
 
+// Requests answered by one shard endpoint, in cluster mode.  MOVED and ASK
+// replies are counted as ops too, as in the totals.
+class shard_stats
+{
+public:
+    unsigned long long m_ops;
+    unsigned long long m_hits;
+    unsigned long long m_misses;
+    unsigned long long m_moved;
+    unsigned long long m_ask;
+    unsigned long long m_bytes;
+    safe_hdr_histogram m_latency_histogram;
+    bool m_replica; // the endpoint's role when last seen
+    shard_stats();
+    void update_op(unsigned int bytes, unsigned int latency, unsigned int hits, unsigned int misses);
+    void update_moved_op(unsigned int bytes, unsigned int latency);
+    void update_ask_op(unsigned int bytes, unsigned int latency);
+    void merge(const shard_stats &other);
+    void aggregate_average(size_t stats_size);
+};
+
+// What disrupted the requests during the run, for the availability timeline
+enum availability_event_type
+{
+    ae_connection_error,
+    ae_error_reply,
+    ae_moved,
+    ae_ask,
+    ae_topology_change,
+    ae_reconnected,
+    ae_count
+};
+
+struct availability_event
+{
+    struct timeval m_time;
+    availability_event_type m_type;
+    availability_event(struct timeval time, availability_event_type type) : m_time(time), m_type(type) {}
+};
+
+// Multi-key requests scattered over several shards in cluster mode, by the
+// number of nodes they went to.  An op is done when its last part replied.
+class fanout_stats
+{
+public:
+    unsigned long long m_ops;
+    unsigned long long m_keys;
+    safe_hdr_histogram m_latency_histogram;
+    fanout_stats();
+    void update_op(unsigned int keys, unsigned int latency);
+    void merge(const fanout_stats &other);
+    void aggregate_average(size_t stats_size);
+};
+
 
 #endif // MEMTIER_BENCHMARK_RUN_STATS_TYPES_H
@@ -42,6 +42,7 @@
 
 #ifdef HAVE_ASSERT_H
 #include <assert.h>
+#include <algorithm>
 #endif
 
 #include "shard_connection.h"
@@ -92,9 +93,31 @@ void cluster_client_event_handler(bufferevent *bev, short events, void *ctx)
     sc->handle_event(events);
 }
 
+void shared_socket_read_handler(bufferevent *bev, void *ctx)
+{
+    shared_socket *s = (shared_socket *) ctx;
+    assert(s != NULL);
+    s->handle_read();
+}
+
+void shared_socket_event_handler(bufferevent *bev, short events, void *ctx)
+{
+    shared_socket *s = (shared_socket *) ctx;
+    assert(s != NULL);
+    s->handle_event(events);
+}
+
+void shared_socket_announce_handler(evutil_socket_t fd, short what, void *ctx)
+{
+    shared_socket *s = (shared_socket *) ctx;
+    assert(s != NULL);
+    s->announce_connected();
+}
+
 request::request(request_type type, unsigned int size, struct timeval *sent_time, unsigned int keys) :
         m_type(type), m_size(size), m_keys(keys)
 {
+    timerclear(&m_first_byte_time);
     if (sent_time != NULL)
         m_sent_time = *sent_time;
     else {
@@ -103,8 +126,14 @@ request::request(request_type type, unsigned int size, struct timeval *sent_time
 }
 
 arbitrary_request::arbitrary_request(size_t request_index, request_type type, unsigned int size,
-                                     struct timeval *sent_time) :
-        request(type, size, sent_time, 1), index(request_index)
+                                     struct timeval *sent_time, unsigned int replies) :
+        request(type, size, sent_time, 1), index(request_index), m_replies_left(replies), m_replies_len(0)
+{
+}
+
+queue_request::queue_request(request_type type, unsigned int size, struct timeval *sent_time, const char *queue,
+                             unsigned int queue_len) :
+        request(type, size, sent_time, 1), m_queue(queue, queue_len)
 {
 }
 
@@ -139,6 +168,7 @@ shard_connection::shard_connection(unsigned int id, connections_manager *conns_m
         m_port(NULL),
         m_unix_sockaddr(NULL),
         m_bev(NULL),
+        m_socket(NULL),
         m_event_timer(NULL),
         m_request_per_cur_interval(0),
         m_pending_resp(0),
@@ -147,6 +177,10 @@ shard_connection::shard_connection(unsigned int id, connections_manager *conns_m
         m_authentication(setup_done),
         m_db_selection(setup_done),
         m_cluster_slots(setup_done),
+        m_client_tracking(setup_done),
+        m_script_load(setup_done),
+        m_readonly(setup_done),
+        m_subscribed(false),
         m_reconnect_attempts(0),
         m_current_backoff_delay(1.0),
         m_reconnect_timer(NULL),
@@ -157,6 +191,7 @@ shard_connection::shard_connection(unsigned int id, connections_manager *conns_m
     m_conns_manager = conns_man;
     m_config = config;
     m_event_base = event_base;
+    memset(&m_connect_start, 0, sizeof(m_connect_start));
 
     if (m_config->unix_socket) {
         m_unix_sockaddr = (struct sockaddr_un *) malloc(sizeof(struct sockaddr_un));
@@ -169,6 +204,7 @@ shard_connection::shard_connection(unsigned int id, connections_manager *conns_m
 
     m_protocol = abs_protocol->clone();
     assert(m_protocol != NULL);
+    m_protocol->set_value_ref_threshold(m_config->zero_copy_threshold);
 
     m_pipeline = new std::queue<request *>;
     assert(m_pipeline != NULL);
@@ -191,10 +227,13 @@ shard_connection::~shard_connection()
         m_unix_sockaddr = NULL;
     }
 
-    if (m_bev != NULL) {
+    if (m_socket != NULL) {
+        m_socket->detach(this);
+        m_socket = NULL;
+    } else if (m_bev != NULL) {
         bufferevent_free(m_bev);
-        m_bev = NULL;
     }
+    m_bev = NULL;
 
     if (m_event_timer != NULL) {
         event_free(m_event_timer);
@@ -237,6 +276,13 @@ void shard_connection::setup_event(int sockfd)
             SSL_set_tlsext_host_name(ctx, m_config->tls_sni);
         }
 
+        if (m_config->tls_session_reuse) {
+            tls_session_cache *sessions = m_conns_manager->get_tls_session_cache();
+            if (sessions != NULL) {
+                sessions->attach(ctx, get_readable_id());
+            }
+        }
+
         m_bev = bufferevent_openssl_socket_new(m_event_base, sockfd, ctx, BUFFEREVENT_SSL_CONNECTING,
                                                BEV_OPT_CLOSE_ON_FREE);
     } else {
@@ -247,7 +293,12 @@ void shard_connection::setup_event(int sockfd)
 #endif
 
     assert(m_bev != NULL);
-    bufferevent_setcb(m_bev, cluster_client_read_handler, NULL, cluster_client_event_handler, (void *) this);
+    if (m_socket != NULL) {
+        bufferevent_setcb(m_bev, shared_socket_read_handler, NULL, shared_socket_event_handler, (void *) m_socket);
+        m_socket->set_bev(m_bev, this);
+    } else {
+        bufferevent_setcb(m_bev, cluster_client_read_handler, NULL, cluster_client_event_handler, (void *) this);
+    }
     m_protocol->set_buffers(bufferevent_get_input(m_bev), bufferevent_get_output(m_bev));
 }
 
@@ -285,6 +336,38 @@ int shard_connection::setup_socket(struct connect_info *addr)
 
         error = setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (void *) &flags, sizeof(flags));
         assert(error == 0);
+
+#ifdef TCP_FASTOPEN_CONNECT
+        // connect() completes at once and the first write is sent along with the SYN
+        if (m_config->tcp_fast_open) {
+            int on = 1;
+            if (setsockopt(sockfd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, (void *) &on, sizeof(on)) < 0) {
+                close(sockfd);
+                return -1;
+            }
+        }
+#endif
+
+        if (m_config->source_addrs != NULL) {
+            struct sockaddr_storage local_addr;
+            socklen_t local_addrlen;
+
+            if (!m_config->source_addrs->get_next(addr->ci_family, &local_addr, &local_addrlen)) {
+                close(sockfd);
+                errno = EAFNOSUPPORT;
+                return -1;
+            }
+#ifdef IP_BIND_ADDRESS_NO_PORT
+            // leave the port choice to connect(), so every source address gets
+            // the whole ephemeral port range towards each destination
+            int on = 1;
+            setsockopt(sockfd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, (void *) &on, sizeof(on));
+#endif
+            if (bind(sockfd, (struct sockaddr *) &local_addr, local_addrlen) < 0) {
+                close(sockfd);
+                return -1;
+            }
+        }
     }
 
     // set non-blocking behavior
@@ -303,29 +386,48 @@ int shard_connection::connect(struct connect_info *addr)
     m_authentication = m_config->authenticate ? setup_none : setup_done;
     m_db_selection = m_config->select_db ? setup_none : setup_done;
     m_hello = (m_config->protocol == PROTOCOL_RESP2 || m_config->protocol == PROTOCOL_RESP3) ? setup_none : setup_done;
+    m_client_tracking = m_config->client_tracking ? setup_none : setup_done;
+    m_script_load = m_config->arbitrary_commands->has_scripts() ? setup_none : setup_done;
+    m_readonly = m_config->read_from != READ_FROM_PRIMARY ? setup_none : setup_done;
+    m_subscribed = false;
 
-    // setup socket
-    int sockfd = setup_socket(addr);
-    if (sockfd < 0) {
-        fprintf(stderr, "Failed to setup socket: %s\n", strerror(errno));
-        return -1;
-    }
+    // set readable id; also keys the TLS session cache in setup_event() and
+    // the sockets shared by the thread's clients
+    set_readable_id();
 
-    // set up bufferevent
-    setup_event(sockfd);
+    m_socket = m_conns_manager->get_shared_socket(get_readable_id());
+    if (m_socket != NULL && m_socket->get_bev() != NULL) {
+        // another client of the thread opened it already
+        m_bev = m_socket->get_bev();
+        m_protocol->set_buffers(bufferevent_get_input(m_bev), bufferevent_get_output(m_bev));
 
-    // set readable id
-    set_readable_id();
+        m_connection_state = conn_in_progress;
+        gettimeofday(&m_connect_start, NULL);
+        m_socket->attach(this);
+    } else {
+        // setup socket
+        int sockfd = setup_socket(addr);
+        if (sockfd < 0) {
+            fprintf(stderr, "Failed to setup socket: %s\n", strerror(errno));
+            m_socket = NULL;
+            return -1;
+        }
 
-    // call connect
-    m_connection_state = conn_in_progress;
+        // set up bufferevent
+        setup_event(sockfd);
 
-    if (bufferevent_socket_connect(m_bev, m_unix_sockaddr ? (struct sockaddr *) m_unix_sockaddr : addr->ci_addr,
-                                   m_unix_sockaddr ? sizeof(struct sockaddr_un) : addr->ci_addrlen) == -1) {
-        disconnect();
+        // call connect
+        m_connection_state = conn_in_progress;
+        gettimeofday(&m_connect_start, NULL);
+        if (m_socket != NULL) m_socket->attach(this);
 
-        benchmark_error_log("connect failed, error = %s\n", strerror(errno));
-        return -1;
+        if (bufferevent_socket_connect(m_bev, m_unix_sockaddr ? (struct sockaddr *) m_unix_sockaddr : addr->ci_addr,
+                                       m_unix_sockaddr ? sizeof(struct sockaddr_un) : addr->ci_addrlen) == -1) {
+            disconnect();
+
+            benchmark_error_log("connect failed, error = %s\n", strerror(errno));
+            return -1;
+        }
     }
 
     // Start connection timeout timer (only if enabled)
@@ -344,10 +446,14 @@ int shard_connection::connect(struct connect_info *addr)
 
 void shard_connection::disconnect()
 {
-    if (m_bev) {
+    if (m_socket != NULL) {
+        // the socket stays open while other clients use it
+        m_socket->detach(this);
+        m_socket = NULL;
+    } else if (m_bev) {
         bufferevent_free(m_bev);
-        m_bev = NULL;
     }
+    m_bev = NULL;
 
     if (m_event_timer != NULL) {
         event_free(m_event_timer);
@@ -365,6 +471,7 @@ void shard_connection::disconnect()
     }
 
     // empty pipeline
+    bool requests_lost = m_pending_resp > 0;
     while (m_pending_resp)
         delete pop_req();
 
@@ -378,6 +485,11 @@ void shard_connection::disconnect()
     m_db_selection = setup_done;
     m_cluster_slots = setup_done;
     m_hello = setup_done;
+    m_client_tracking = setup_done;
+    m_script_load = setup_done;
+    m_readonly = setup_done;
+
+    if (requests_lost) m_conns_manager->handle_requests_lost(m_id);
 }
 
 void shard_connection::set_address_port(const char *address, const char *port)
@@ -393,6 +505,22 @@ void shard_connection::set_address_port(const char *address, const char *port)
     m_port = strdup(port);
 }
 
+#ifdef USE_TLS
+void shard_connection::record_tls_handshake()
+{
+    SSL *ssl = bufferevent_openssl_get_ssl(m_bev);
+    if (ssl == NULL) return;
+
+    bool ktls = false;
+#ifdef BIO_get_ktls_send
+    ktls = BIO_get_ktls_send(SSL_get_wbio(ssl)) && BIO_get_ktls_recv(SSL_get_rbio(ssl));
+#endif
+
+    client *c = static_cast<client *>(m_conns_manager);
+    c->get_stats()->update_tls_handshake(SSL_session_reused(ssl), ktls);
+}
+#endif
+
 void shard_connection::set_readable_id()
 {
     if (m_unix_sockaddr != NULL) {
@@ -469,6 +597,24 @@ const char *shard_connection::get_last_request_type()
         return "CLUSTER_SLOTS";
     case rt_hello:
         return "HELLO";
+    case rt_client_tracking:
+        return "CLIENT_TRACKING";
+    case rt_stream_group:
+        return "XGROUP";
+    case rt_stream_read:
+        return "XREADGROUP";
+    case rt_stream_ack:
+        return "XACK";
+    case rt_script_load:
+        return "SCRIPT_LOAD";
+    case rt_queue_pop:
+        return get_queue_pop_name(m_config->queue_pop);
+    case rt_queue_ack:
+        return "LREM";
+    case rt_list_trim:
+        return "LTRIM";
+    case rt_readonly:
+        return "READONLY";
     default:
         return "unknown";
     }
@@ -489,6 +635,11 @@ void shard_connection::push_req(request *req)
 {
     m_pipeline->push(req);
     m_pending_resp++;
+    if (m_socket != NULL) {
+        unsigned int replies =
+            req->m_type == rt_arbitrary ? static_cast<arbitrary_request *>(req)->m_replies_left : 1;
+        while (replies--) m_socket->push_reply_owner(this);
+    }
     if (m_config->request_rate) {
         // Handle race condition during reconnection - don't assert if interval is 0
         if (m_request_per_cur_interval > 0) {
@@ -503,7 +654,8 @@ void shard_connection::push_req(request *req)
 bool shard_connection::is_conn_setup_done()
 {
     return m_authentication == setup_done && m_db_selection == setup_done && m_cluster_slots == setup_done &&
-           m_hello == setup_done;
+           m_hello == setup_done && m_client_tracking == setup_done && m_script_load == setup_done &&
+           m_readonly == setup_done;
 }
 
 void shard_connection::send_conn_setup_commands(struct timeval timestamp)
@@ -529,6 +681,34 @@ void shard_connection::send_conn_setup_commands(struct timeval timestamp)
         m_hello = setup_sent;
     }
 
+    // tracking needs RESP3 for the invalidation pushes, so it must follow HELLO
+    if (m_client_tracking == setup_none) {
+        benchmark_debug_log("sending CLIENT TRACKING command.\n");
+        m_protocol->write_command_client_tracking();
+        push_req(new request(rt_client_tracking, 0, &timestamp, 0));
+        m_client_tracking = setup_sent;
+    }
+
+    // sent to the primaries too, so a connection keeps serving reads when its node changes role
+    if (m_readonly == setup_none) {
+        benchmark_debug_log("sending READONLY command.\n");
+        m_protocol->write_command_readonly();
+        push_req(new request(rt_readonly, 0, &timestamp, 0));
+        m_readonly = setup_sent;
+    }
+
+    if (m_script_load == setup_none) {
+        benchmark_debug_log("sending SCRIPT LOAD commands.\n");
+        for (size_t i = 0; i < m_config->arbitrary_commands->size(); i++) {
+            const arbitrary_command &cmd = m_config->arbitrary_commands->at(i);
+            for (size_t j = 0; j < cmd.scripts.size(); j++) {
+                m_protocol->write_command_script_load(cmd.scripts[j].c_str(), cmd.scripts[j].length());
+                push_req(new request(rt_script_load, 0, &timestamp, 0));
+            }
+        }
+        m_script_load = setup_sent;
+    }
+
     if (m_cluster_slots == setup_none) {
         benchmark_debug_log("sending cluster slots command.\n");
 
@@ -542,17 +722,52 @@ void shard_connection::send_conn_setup_commands(struct timeval timestamp)
 
 void shard_connection::process_response(void)
 {
-    int ret;
+    int ret = 0;
     bool responses_handled = false;
+    bool shared = m_socket != NULL;
 
     struct timeval now;
     gettimeofday(&now, NULL);
 
-    while ((ret = m_protocol->parse_response()) > 0) {
+    thread_overhead *overhead = m_conns_manager->get_thread_overhead();
+    if (overhead != NULL) overhead->sample(&now);
+
+    mark_first_byte(&now);
+    // on a shared socket, only up to the first reply to another client
+    while ((!shared || (m_socket != NULL && m_socket->get_reply_owner() == this)) &&
+           (ret = parse_response(overhead)) > 0) {
         bool error = false;
         protocol_response *r = m_protocol->get_response();
+        if (shared) m_socket->pop_reply_owner();
+
+        // out-of-band pushes don't answer any request in the pipeline
+        if (r->is_push() || (m_subscribed && m_pipeline->empty())) {
+            m_conns_manager->handle_push(m_id, now, r);
+            continue;
+        }
+
+        if (m_pipeline->front()->m_type == rt_arbitrary) {
+            arbitrary_request *ar = static_cast<arbitrary_request *>(m_pipeline->front());
+
+            // the server lost our scripts (restart, failover, SCRIPT FLUSH), load them again
+            if (r->is_error() && strncmp(r->get_status(), "-NOSCRIPT", 9) == 0 &&
+                m_config->arbitrary_commands->has_scripts()) {
+                m_script_load = setup_none;
+            }
+
+            // a compound request is done with the reply to its last command
+            if (ar->m_replies_left > 1) {
+                if (r->is_error()) {
+                    benchmark_error_log("server %s handle error response: %s\n", get_readable_id(), r->get_status());
+                }
+                ar->m_replies_left--;
+                ar->m_replies_len += r->get_total_len();
+                continue;
+            }
+        }
 
         request *req = pop_req();
+        mark_first_byte(&now);
         switch (req->m_type) {
         case rt_auth:
             if (r->is_error()) {
@@ -594,11 +809,53 @@ void shard_connection::process_response(void)
                 benchmark_debug_log("HELLO successful.\n");
             }
             break;
+        case rt_client_tracking:
+            if (r->is_error()) {
+                benchmark_error_log("error: CLIENT TRACKING failed [%s]\n", r->get_status());
+                error = true;
+            } else {
+                m_client_tracking = setup_done;
+                benchmark_debug_log("CLIENT TRACKING successful.\n");
+            }
+            break;
+        case rt_readonly:
+            if (r->is_error()) {
+                benchmark_error_log("error: READONLY failed [%s]\n", r->get_status());
+                error = true;
+            } else {
+                m_readonly = setup_done;
+                benchmark_debug_log("READONLY successful.\n");
+            }
+            break;
+        case rt_script_load:
+            if (r->is_error()) {
+                benchmark_error_log("error: SCRIPT LOAD failed [%s]\n", r->get_status());
+                error = true;
+            } else {
+                m_script_load = setup_done;
+                benchmark_debug_log("SCRIPT LOAD successful.\n");
+            }
+            break;
+        case rt_stream_group:
+            // every client creates the groups it uses, the first one wins
+            if (r->is_error() && strncmp(r->get_status(), "-BUSYGROUP", 10) != 0) {
+                benchmark_error_log("error: XGROUP CREATE failed [%s]\n", r->get_status());
+                error = true;
+            }
+            break;
+        case rt_list_trim:
+            if (r->is_error()) {
+                benchmark_error_log("server %s handle error response: %s\n", get_readable_id(), r->get_status());
+            }
+            break;
         default:
             benchmark_debug_log("server %s: handled response (first line): %s, %d hits, %d misses\n", get_readable_id(),
                                 r->get_status(), r->get_hits(), req->m_keys - r->get_hits());
 
-            m_conns_manager->handle_response(m_id, now, req, r);
+            {
+                overhead_scope scope(overhead, overhead_stats_update);
+                m_conns_manager->handle_response(m_id, now, req, r);
+            }
             m_conns_manager->inc_reqs_processed();
             responses_handled = true;
             break;
@@ -637,17 +894,54 @@ void shard_connection::process_response(void)
     }
 }
 
+// The reply to the oldest request started to arrive if there's anything
+// left to read, with the time resolution of the read events.
+void shard_connection::mark_first_byte(struct timeval *now)
+{
+    if (m_pipeline->empty() || timerisset(&m_pipeline->front()->m_first_byte_time)) return;
+    // what a shared socket has to read may be another client's reply
+    if (m_socket != NULL && m_socket->get_reply_owner() != this) return;
+    if (evbuffer_get_length(bufferevent_get_input(m_bev)) == 0) return;
+
+    m_pipeline->front()->m_first_byte_time = *now;
+}
+
+int shard_connection::parse_response(thread_overhead *overhead)
+{
+    overhead_scope scope(overhead, overhead_parse_response);
+    return m_protocol->parse_response();
+}
+
 void shard_connection::process_first_request()
 {
     m_conns_manager->set_start_time();
     fill_pipeline();
 }
 
+// Resumes sending on a connection that went idle, once it has requests again
+void shard_connection::wake_up(void)
+{
+    if (m_connection_state != conn_connected || m_bev == NULL) return;
+
+    resume_io();
+    fill_pipeline();
+}
+
+// Flushes a request another connection queued here while this one was idle
+void shard_connection::resume_io(void)
+{
+    if (m_connection_state != conn_connected || m_bev == NULL) return;
+
+    bufferevent_enable(m_bev, EV_READ | EV_WRITE);
+}
+
 void shard_connection::fill_pipeline(void)
 {
     struct timeval now;
     gettimeofday(&now, NULL);
 
+    thread_overhead *overhead = m_conns_manager->get_thread_overhead();
+
     while (!m_conns_manager->finished() && m_pipeline->size() < m_config->pipeline) {
         if (!is_conn_setup_done()) {
             send_conn_setup_commands(now);
@@ -659,6 +953,11 @@ void shard_connection::fill_pipeline(void)
             break;
         }
 
+        // a subscribed connection only receives messages
+        if (m_subscribed) {
+            break;
+        }
+
         // that's enough, we reached the rate limit
         if (m_config->request_rate && m_request_per_cur_interval == 0) {
             // return and skip on update events
@@ -666,18 +965,20 @@ void shard_connection::fill_pipeline(void)
         }
 
         // client manage requests logic
+        overhead_scope scope(overhead, overhead_create_request);
         m_conns_manager->create_request(now, m_id);
     }
 
     // Check if done: no pending responses and output buffer empty
     if (m_bev != NULL) {
-        if ((m_pending_resp == 0) && (evbuffer_get_length(bufferevent_get_output(m_bev)) == 0)) {
+        if ((m_pending_resp == 0) && (m_socket != NULL || evbuffer_get_length(bufferevent_get_output(m_bev)) == 0)) {
             benchmark_debug_log("%s Done, no requests to send no response to wait for\n", get_readable_id());
 
             if (m_conns_manager->finished() && m_conns_manager->all_connections_idle()) {
                 m_conns_manager->set_end_time();
                 m_conns_manager->disconnect_all();
-            } else if (!m_config->request_rate) {
+            } else if (!m_config->request_rate && !m_subscribed && m_socket == NULL) {
+                // a shared socket keeps serving the other clients
                 bufferevent_disable(m_bev, EV_WRITE | EV_READ);
             }
         }
@@ -691,8 +992,17 @@ void shard_connection::handle_event(short events)
     // to do any I/O from the client::connect() call...
 
     if ((get_connection_state() == conn_in_progress) && (events & BEV_EVENT_CONNECTED)) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+
         m_connection_state = conn_connected;
         bufferevent_enable(m_bev, EV_READ | EV_WRITE);
+        m_conns_manager->handle_connect_result(m_id, true, ts_diff(m_connect_start, now));
+#ifdef USE_TLS
+        if (m_config->openssl_ctx && (m_socket == NULL || m_socket->is_opener(this))) {
+            record_tls_handshake();
+        }
+#endif
 
         // Cancel connection timeout timer on successful connection
         if (m_connection_timeout_timer != NULL) {
@@ -704,6 +1014,7 @@ void shard_connection::handle_event(short events)
         if (m_reconnect_attempts > 0) {
             benchmark_debug_log("Connection established successfully after %u reconnection attempts.\n",
                                 m_reconnect_attempts);
+            static_cast<client *>(m_conns_manager)->get_stats()->update_reconnect(&now);
         }
         m_reconnect_attempts = 0;
         m_current_backoff_delay = 1.0;
@@ -766,6 +1077,10 @@ void shard_connection::handle_timer_event(void)
 
 void shard_connection::attempt_reconnect(const char *error_context)
 {
+    if (m_connection_state == conn_in_progress) {
+        m_conns_manager->handle_connect_result(m_id, false, 0);
+    }
+
     // Update connection error statistics
     struct timeval now;
     gettimeofday(&now, NULL);
@@ -849,9 +1164,7 @@ void shard_connection::handle_reconnect_timer_event()
         }
     } else {
         benchmark_error_log("Reconnection successful after %u attempts.\n", m_reconnect_attempts);
-        // Reset reconnection state
-        m_reconnect_attempts = 0;
-        m_current_backoff_delay = 1.0;
+        // reconnection state is reset once the connection is established
     }
 }
 
@@ -877,6 +1190,168 @@ void shard_connection::send_wait_command(struct timeval *sent_time, unsigned int
     push_req(new request(rt_wait, cmd_size, sent_time, 0));
 }
 
+// PUBLISH is accounted as a SET, SPUBLISH is used in cluster mode
+void shard_connection::send_publish_command(struct timeval *sent_time, const char *channel, int channel_len,
+                                            const char *value, int value_len)
+{
+    int cmd_size = 0;
+    unsigned long long sent_usec = (unsigned long long) sent_time->tv_sec * 1000000 + sent_time->tv_usec;
+
+    benchmark_debug_log("server %s: PUBLISH channel=[%.*s] value_len=%u\n", get_readable_id(), channel_len, channel,
+                        value_len);
+
+    cmd_size = m_protocol->write_command_publish(channel, channel_len, value, value_len, sent_usec,
+                                                 m_config->cluster_mode);
+
+    push_req(new request(rt_set, cmd_size, sent_time, 1));
+}
+
+// Subscribes to the channels, which may be none in cluster mode when this
+// shard owns none of them.  Confirmations and messages are then all
+// delivered to the connections manager as pushes.
+void shard_connection::send_subscribe_commands(const keylist *channels)
+{
+    for (unsigned int i = 0; i < channels->get_keys_count(); i++) {
+        unsigned int channel_len;
+        const char *channel = channels->get_key(i, &channel_len);
+
+        benchmark_debug_log("server %s: SUBSCRIBE channel=[%.*s]\n", get_readable_id(), channel_len, channel);
+        m_protocol->write_command_subscribe(channel, channel_len, m_config->cluster_mode);
+    }
+
+    // message frames are inspected by the client
+    m_protocol->set_keep_value(true);
+    m_subscribed = true;
+}
+
+// XADD is accounted as a SET
+void shard_connection::send_xadd_command(struct timeval *sent_time, const char *stream, int stream_len,
+                                         const char *value, int value_len)
+{
+    int cmd_size = 0;
+    unsigned long long sent_usec = (unsigned long long) sent_time->tv_sec * 1000000 + sent_time->tv_usec;
+
+    benchmark_debug_log("server %s: XADD stream=[%.*s] value_len=%u\n", get_readable_id(), stream_len, stream,
+                        value_len);
+
+    cmd_size = m_protocol->write_command_xadd(stream, stream_len, value, value_len, sent_usec);
+    push_req(new request(rt_set, cmd_size, sent_time, 1));
+}
+
+void shard_connection::send_xgroup_create_command(const char *stream, int stream_len)
+{
+    int cmd_size = 0;
+
+    benchmark_debug_log("server %s: XGROUP CREATE stream=[%.*s]\n", get_readable_id(), stream_len, stream);
+
+    cmd_size = m_protocol->write_command_xgroup_create(stream, stream_len, STREAM_GROUP_NAME);
+    push_req(new request(rt_stream_group, cmd_size, NULL, 0));
+}
+
+// XREADGROUP is accounted as a GET of up to stream_count entries
+void shard_connection::send_xreadgroup_command(struct timeval *sent_time, const char *stream, int stream_len,
+                                               const char *consumer)
+{
+    int cmd_size = 0;
+
+    benchmark_debug_log("server %s: XREADGROUP stream=[%.*s] consumer=%s\n", get_readable_id(), stream_len, stream,
+                        consumer);
+
+    cmd_size = m_protocol->write_command_xreadgroup(stream, stream_len, STREAM_GROUP_NAME, consumer,
+                                                    m_config->stream_count, m_config->stream_block);
+
+    // the entries are inspected by the client
+    m_protocol->set_keep_value(true);
+    push_req(new request(rt_stream_read, cmd_size, sent_time, m_config->stream_count));
+}
+
+void shard_connection::send_xack_command(struct timeval *sent_time, const char *stream, int stream_len,
+                                         const keylist *ids)
+{
+    int cmd_size = 0;
+
+    benchmark_debug_log("server %s: XACK stream=[%.*s] ids=%u\n", get_readable_id(), stream_len, stream,
+                        ids->get_keys_count());
+
+    cmd_size = m_protocol->write_command_xack(stream, stream_len, STREAM_GROUP_NAME, ids);
+    push_req(new request(rt_stream_ack, cmd_size, sent_time, ids->get_keys_count()));
+}
+
+// a queue push is accounted as a SET
+void shard_connection::send_queue_push_command(struct timeval *sent_time, const char *queue, int queue_len,
+                                               const char *value, int value_len)
+{
+    int cmd_size = 0;
+    unsigned long long sent_usec = (unsigned long long) sent_time->tv_sec * 1000000 + sent_time->tv_usec;
+
+    benchmark_debug_log("server %s: queue push queue=[%.*s] value_len=%u\n", get_readable_id(), queue_len, queue,
+                        value_len);
+
+    cmd_size = m_protocol->write_command_queue_push(queue, queue_len, value, value_len, sent_usec,
+                                                    m_config->queue_pop == QUEUE_POP_BZPOPMIN);
+    push_req(new request(rt_set, cmd_size, sent_time, 1));
+}
+
+// a blocking pop is accounted as a GET, which misses when it times out
+void shard_connection::send_queue_pop_command(struct timeval *sent_time, const char *queue, int queue_len)
+{
+    int cmd_size = 0;
+
+    benchmark_debug_log("server %s: %s queue=[%.*s]\n", get_readable_id(), get_queue_pop_name(m_config->queue_pop),
+                        queue_len, queue);
+
+    cmd_size = m_protocol->write_command_queue_pop(queue, queue_len, m_config->queue_pop, m_config->queue_timeout);
+
+    // the message is inspected by the client
+    m_protocol->set_keep_value(true);
+    push_req(new queue_request(rt_queue_pop, cmd_size, sent_time, queue, queue_len));
+}
+
+void shard_connection::send_queue_ack_command(struct timeval *sent_time, const char *queue, int queue_len,
+                                              const char *message, int message_len)
+{
+    int cmd_size = 0;
+
+    benchmark_debug_log("server %s: LREM queue=[%.*s]\n", get_readable_id(), queue_len, queue);
+
+    cmd_size = m_protocol->write_command_queue_ack(queue, queue_len, message, message_len);
+    push_req(new request(rt_queue_ack, cmd_size, sent_time, 1));
+}
+
+// Writing a hash, set, sorted set or list is accounted as a SET.  Lists are
+// trimmed back to data_fields elements right after the push, which isn't
+// accounted.
+void shard_connection::send_collection_write_command(struct timeval *sent_time, const char *key, int key_len,
+                                                     const char *value, int value_len, const unsigned int *scores)
+{
+    int cmd_size = 0;
+
+    benchmark_debug_log("server %s: %s write key=[%.*s] fields=%u value_len=%u\n", get_readable_id(),
+                        get_data_type_name(m_config->data_type), key_len, key, m_config->data_fields, value_len);
+
+    cmd_size = m_protocol->write_command_collection_write(m_config->data_type, key, key_len, value, value_len,
+                                                          m_config->data_fields, scores);
+    push_req(new request(rt_set, cmd_size, sent_time, 1));
+
+    if (m_config->data_type == DATA_TYPE_LIST) {
+        cmd_size = m_protocol->write_command_list_trim(key, key_len, m_config->data_fields);
+        push_req(new request(rt_list_trim, cmd_size, sent_time, 0));
+    }
+}
+
+// reading a hash, set, sorted set or list is accounted as a GET of one key
+void shard_connection::send_collection_read_command(struct timeval *sent_time, const char *key, int key_len,
+                                                    unsigned int first, unsigned int count)
+{
+    int cmd_size = 0;
+
+    benchmark_debug_log("server %s: %s read key=[%.*s] first=%u count=%u\n", get_readable_id(),
+                        get_data_type_name(m_config->data_type), key_len, key, first, count);
+
+    cmd_size = m_protocol->write_command_collection_read(m_config->data_type, key, key_len, first, count);
+    push_req(new request(rt_get, cmd_size, sent_time, 1));
+}
+
 void shard_connection::send_set_command(struct timeval *sent_time, const char *key, int key_len, const char *value,
                                         int value_len, int expiry, unsigned int offset)
 {
@@ -959,12 +1434,148 @@ int shard_connection::send_arbitrary_command(const command_arg *arg, const char
         benchmark_debug_log("value_len=%u\n", val_len);
     }
 
-    cmd_size = m_protocol->write_arbitrary_command(val, val_len);
+    cmd_size = m_protocol->write_arbitrary_command(arg, val, val_len);
 
     return cmd_size;
 }
 
-void shard_connection::send_arbitrary_command_end(size_t command_index, struct timeval *sent_time, int cmd_size)
+void shard_connection::send_arbitrary_command_end(size_t command_index, struct timeval *sent_time, int cmd_size,
+                                                  unsigned int replies)
+{
+    push_req(new arbitrary_request(command_index, rt_arbitrary, cmd_size, sent_time, replies));
+}
+
+shared_socket::shared_socket(abstract_protocol *abs_protocol) :
+        m_bev(NULL),
+        m_announce_event(NULL),
+        m_protocol_proto(abs_protocol),
+        m_protocol(NULL),
+        m_connected(false),
+        m_opener(NULL),
+        m_replies_read(0)
+{
+}
+
+shared_socket::~shared_socket()
+{
+    close();
+}
+
+void shared_socket::set_bev(struct bufferevent *bev, shard_connection *opener)
+{
+    m_bev = bev;
+    m_opener = opener;
+    m_announce_event = event_new(bufferevent_get_base(bev), -1, 0, shared_socket_announce_handler, (void *) this);
+
+    m_protocol = m_protocol_proto->clone();
+    m_protocol->set_buffers(bufferevent_get_input(m_bev), bufferevent_get_output(m_bev));
+}
+
+void shared_socket::close(void)
+{
+    if (m_bev != NULL) {
+        bufferevent_free(m_bev);
+        m_bev = NULL;
+    }
+
+    if (m_announce_event != NULL) {
+        event_free(m_announce_event);
+        m_announce_event = NULL;
+    }
+
+    if (m_protocol != NULL) {
+        delete m_protocol;
+        m_protocol = NULL;
+    }
+
+    m_connected = false;
+    m_opener = NULL;
+    m_reply_owners.clear();
+}
+
+bool shared_socket::is_attached(shard_connection *conn)
+{
+    return std::find(m_conns.begin(), m_conns.end(), conn) != m_conns.end() ||
+           std::find(m_pending.begin(), m_pending.end(), conn) != m_pending.end();
+}
+
+// A connection is told it's connected from the event loop, as it would be by
+// a socket of its own
+void shared_socket::attach(shard_connection *conn)
+{
+    m_pending.push_back(conn);
+    if (m_connected) event_active(m_announce_event, EV_TIMEOUT, 0);
+}
+
+// The replies of a detached connection are dropped as they arrive.  One it
+// was partway through can't be parsed from its middle though, so the socket
+// is closed then, and the other connections reconnect.
+void shared_socket::detach(shard_connection *conn)
+{
+    bool in_response = get_reply_owner() == conn && conn->get_protocol()->in_response();
+
+    m_conns.erase(std::remove(m_conns.begin(), m_conns.end(), conn), m_conns.end());
+    m_pending.erase(std::remove(m_pending.begin(), m_pending.end(), conn), m_pending.end());
+    if (m_opener == conn) m_opener = NULL;
+
+    std::replace(m_reply_owners.begin(), m_reply_owners.end(), conn, (shard_connection *) NULL);
+
+    if (m_conns.empty() && m_pending.empty()) {
+        close();
+    } else if (in_response) {
+        close();
+        handle_event(BEV_EVENT_EOF);
+    }
+}
+
+void shared_socket::pop_reply_owner(void)
+{
+    m_reply_owners.pop_front();
+    m_replies_read++;
+}
+
+void shared_socket::announce_connected(void)
+{
+    while (m_connected && !m_pending.empty()) {
+        shard_connection *conn = m_pending.front();
+        m_pending.erase(m_pending.begin());
+        m_conns.push_back(conn);
+
+        conn->handle_event(BEV_EVENT_CONNECTED);
+    }
+}
+
+// Every reply goes to the connection that sent its request, which stops
+// parsing at the first reply that isn't its own
+void shared_socket::handle_read(void)
+{
+    while (m_bev != NULL && !m_reply_owners.empty() && evbuffer_get_length(bufferevent_get_input(m_bev)) > 0) {
+        shard_connection *owner = m_reply_owners.front();
+        unsigned long long replies_read = m_replies_read;
+
+        if (owner == NULL) {
+            if (m_protocol->parse_response() <= 0) break;
+            pop_reply_owner();
+            continue;
+        }
+
+        owner->process_response();
+        if (m_replies_read == replies_read) break;
+    }
+}
+
+void shared_socket::handle_event(short events)
 {
-    push_req(new arbitrary_request(command_index, rt_arbitrary, cmd_size, sent_time));
+    if (events & BEV_EVENT_CONNECTED) {
+        m_connected = true;
+        announce_connected();
+        return;
+    }
+
+    // every connection on it reconnects on its own
+    std::vector<shard_connection *> conns(m_conns);
+    conns.insert(conns.end(), m_pending.begin(), m_pending.end());
+    for (size_t i = 0; i < conns.size(); i++) {
+        if (is_attached(conns[i])) conns[i]->handle_event(events);
+    }
 }
@@ -19,7 +19,9 @@
 #ifndef MEMTIER_BENCHMARK_SHARD_CONNECTION_H
 #define MEMTIER_BENCHMARK_SHARD_CONNECTION_H
 
+#include <deque>
 #include <queue>
+#include <vector>
 #include <string>
 #include <netdb.h>
 #include <sys/socket.h>
@@ -35,6 +37,8 @@ class connections_manager;
 struct benchmark_config;
 class abstract_protocol;
 class object_generator;
+class thread_overhead;
+class shared_socket;
 
 enum connection_state
 {
@@ -59,12 +63,26 @@ enum request_type
     rt_auth,
     rt_select_db,
     rt_cluster_slots,
-    rt_hello
+    rt_hello,
+    rt_client_tracking,
+    rt_stream_group,
+    rt_stream_read,
+    rt_stream_ack,
+    rt_script_load,
+    rt_queue_pop,
+    rt_queue_ack,
+    rt_list_trim,
+    rt_readonly
 };
+
+// consumer group shared by all the stream consumers
+#define STREAM_GROUP_NAME "memtier"
+
 struct request
 {
     request_type m_type;
     struct timeval m_sent_time;
+    struct timeval m_first_byte_time; // when its reply started to arrive, zero until then
     unsigned int m_size;
     unsigned int m_keys;
 
@@ -75,11 +93,25 @@ struct request
 struct arbitrary_request : public request
 {
     size_t index;
+    // a compound request waits for one reply per command
+    unsigned int m_replies_left;
+    unsigned int m_replies_len;
 
-    arbitrary_request(size_t request_index, request_type type, unsigned int size, struct timeval *sent_time);
+    arbitrary_request(size_t request_index, request_type type, unsigned int size, struct timeval *sent_time,
+                      unsigned int replies = 1);
     virtual ~arbitrary_request(void) {}
 };
 
+// a blocking pop keeps its queue, to which BLMOVE messages are acknowledged
+struct queue_request : public request
+{
+    std::string m_queue;
+
+    queue_request(request_type type, unsigned int size, struct timeval *sent_time, const char *queue,
+                  unsigned int queue_len);
+    virtual ~queue_request(void) {}
+};
+
 struct verify_request : public request
 {
     char *m_key;
@@ -97,6 +129,7 @@ class shard_connection
     friend void cluster_client_timer_handler(evutil_socket_t fd, short what, void *ctx);
     friend void cluster_client_read_handler(bufferevent *bev, void *ctx);
     friend void cluster_client_event_handler(bufferevent *bev, short events, void *ctx);
+    friend class shared_socket;
 
 public:
     shard_connection(unsigned int id, connections_manager *conn_man, benchmark_config *config,
@@ -114,11 +147,29 @@ public:
                           int expiry, unsigned int offset);
     void send_get_command(struct timeval *sent_time, const char *key, int key_len, unsigned int offset);
     void send_mget_command(struct timeval *sent_time, const keylist *key_list);
+    void send_publish_command(struct timeval *sent_time, const char *channel, int channel_len, const char *value,
+                              int value_len);
+    void send_subscribe_commands(const keylist *channels);
+    void send_xadd_command(struct timeval *sent_time, const char *stream, int stream_len, const char *value,
+                           int value_len);
+    void send_xgroup_create_command(const char *stream, int stream_len);
+    void send_xreadgroup_command(struct timeval *sent_time, const char *stream, int stream_len, const char *consumer);
+    void send_xack_command(struct timeval *sent_time, const char *stream, int stream_len, const keylist *ids);
+    void send_queue_push_command(struct timeval *sent_time, const char *queue, int queue_len, const char *value,
+                                 int value_len);
+    void send_queue_pop_command(struct timeval *sent_time, const char *queue, int queue_len);
+    void send_queue_ack_command(struct timeval *sent_time, const char *queue, int queue_len, const char *message,
+                                int message_len);
+    void send_collection_write_command(struct timeval *sent_time, const char *key, int key_len, const char *value,
+                                       int value_len, const unsigned int *scores);
+    void send_collection_read_command(struct timeval *sent_time, const char *key, int key_len, unsigned int first,
+                                      unsigned int count);
     void send_verify_get_command(struct timeval *sent_time, const char *key, int key_len, const char *value,
                                  int value_len, unsigned int offset);
     int send_arbitrary_command(const command_arg *arg);
     int send_arbitrary_command(const command_arg *arg, const char *val, int val_len);
-    void send_arbitrary_command_end(size_t command_index, struct timeval *sent_time, int cmd_size);
+    void send_arbitrary_command_end(size_t command_index, struct timeval *sent_time, int cmd_size,
+                                    unsigned int replies = 1);
 
     void set_cluster_slots() { m_cluster_slots = setup_none; }
 
@@ -136,6 +187,10 @@ public:
 
     int get_pending_resp() { return m_pending_resp; }
 
+    request *get_last_request() { return m_pipeline->empty() ? NULL : m_pipeline->back(); }
+
+    bool is_subscribed() { return m_subscribed; }
+
     // Get local port for crash reporting
     int get_local_port();
 
@@ -143,12 +198,17 @@ public:
     const char *get_last_request_type();
 
     void handle_reconnect_timer_event();
+    void wake_up(void);
+    void resume_io(void);
     void handle_connection_timeout_event();
 
 private:
     void setup_event(int sockfd);
     int setup_socket(struct connect_info *addr);
     void set_readable_id();
+#ifdef USE_TLS
+    void record_tls_handshake();
+#endif
 
     bool is_conn_setup_done();
     void send_conn_setup_commands(struct timeval timestamp);
@@ -156,7 +216,9 @@ private:
     request *pop_req();
     void push_req(request *req);
 
+    int parse_response(thread_overhead *overhead);
     void process_response(void);
+    void mark_first_byte(struct timeval *now);
     void process_subsequent_requests(void);
     void process_first_request();
     void fill_pipeline(void);
@@ -175,6 +237,7 @@ private:
 
     struct sockaddr_un *m_unix_sockaddr;
     struct bufferevent *m_bev;
+    shared_socket *m_socket; // the socket shared with other clients, if any
     struct event_base *m_event_base;
     struct event *m_event_timer;
 
@@ -190,6 +253,13 @@ private:
     enum setup_state m_authentication;
     enum setup_state m_db_selection;
     enum setup_state m_cluster_slots;
+    enum setup_state m_client_tracking;
+    enum setup_state m_script_load;
+    enum setup_state m_readonly;
+
+    // once subscribed, every reply that doesn't answer a pending request
+    // is a pub/sub message
+    bool m_subscribed;
 
     // Reconnection state tracking
     unsigned int m_reconnect_attempts;
@@ -199,6 +269,50 @@ private:
 
     // Connection timeout tracking
     struct event *m_connection_timeout_timer;
+
+    // when the pending connect() was issued, for connect time stats
+    struct timeval m_connect_start;
+};
+
+// A socket to a server that the connections of several clients of a thread
+// share (--shared-connections).  Replies arrive in the order the requests
+// were written, so every request written records the connection its reply
+// is handed to.
+class shared_socket
+{
+public:
+    shared_socket(abstract_protocol *abs_protocol);
+    ~shared_socket();
+
+    struct bufferevent *get_bev() { return m_bev; }
+    void set_bev(struct bufferevent *bev, shard_connection *opener);
+    bool is_opener(shard_connection *conn) { return m_opener == conn; }
+
+    void attach(shard_connection *conn);
+    void detach(shard_connection *conn);
+
+    shard_connection *get_reply_owner() { return m_reply_owners.empty() ? NULL : m_reply_owners.front(); }
+    void push_reply_owner(shard_connection *conn) { m_reply_owners.push_back(conn); }
+    void pop_reply_owner();
+
+    void handle_read(void);
+    void handle_event(short events);
+    void announce_connected(void);
+
+private:
+    void close(void);
+    bool is_attached(shard_connection *conn);
+
+    struct bufferevent *m_bev;
+    struct event *m_announce_event;
+    abstract_protocol *m_protocol_proto;
+    abstract_protocol *m_protocol; // drops the replies of detached connections
+    bool m_connected;
+    shard_connection *m_opener;
+    std::vector<shard_connection *> m_conns;       // connected
+    std::vector<shard_connection *> m_pending;     // waiting to be told they are connected
+    std::deque<shard_connection *> m_reply_owners; // NULL once its connection detached
+    unsigned long long m_replies_read;
 };
 
 #endif // MEMTIER_BENCHMARK_SHARD_CONNECTION_H
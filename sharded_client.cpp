@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2011-2026 Redis Labs Ltd.
+ *
+ * This file is part of memtier_benchmark.
+ *
+ * memtier_benchmark is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * memtier_benchmark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with memtier_benchmark.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef HAVE_ASSERT_H
+#include <assert.h>
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "sharded_client.h"
+#include "memtier_benchmark.h"
+#include "obj_gen.h"
+#include "shard_connection.h"
+
+// FNV-1a, with a final avalanche so that keys differing only in their last
+// characters still land far apart
+static uint32_t hash32(const char *buf, size_t len)
+{
+    uint32_t h = 2166136261U;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) buf[i];
+        h *= 16777619U;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint64_t hash64(const char *buf, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) buf[i];
+        h *= 1099511628211ULL;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Jump consistent hash (Lamping and Veach)
+static unsigned int jump_hash(uint64_t key, unsigned int buckets)
+{
+    int64_t b = -1;
+    int64_t j = 0;
+
+    while (j < (int64_t) buckets) {
+        b = j;
+        key = key * 2862933555777941757ULL + 1;
+        j = (int64_t) ((b + 1) * ((double) (1LL << 31) / (double) ((key >> 33) + 1)));
+    }
+
+    return (unsigned int) b;
+}
+
+server_ring::server_ring(const char *servers, enum SHARDING sharding, int resolution, bool resolve_on_connect) :
+        m_sharding(sharding)
+{
+    std::string str(servers);
+    size_t pos = 0;
+
+    while (pos <= str.length()) {
+        size_t end = str.find(',', pos);
+        if (end == std::string::npos) end = str.length();
+
+        add_server(str.substr(pos, end - pos), resolution, resolve_on_connect);
+
+        pos = end + 1;
+    }
+
+    // every server owns the arcs of the ring ending at its points
+    if (m_sharding == SHARDING_KETAMA) {
+        for (unsigned int i = 0; i < m_names.size(); i++) {
+            for (unsigned int j = 0; j < ketama_points; j++) {
+                char point[300];
+                int len = snprintf(point, sizeof(point), "%s-%u", m_names[i].c_str(), j);
+                m_ring.push_back(std::make_pair(hash32(point, len), i));
+            }
+        }
+        std::sort(m_ring.begin(), m_ring.end());
+    }
+}
+
+server_ring::~server_ring()
+{
+    for (unsigned int i = 0; i < m_servers.size(); i++) {
+        delete m_servers[i];
+    }
+    m_servers.clear();
+}
+
+// host_port is host:port, or [address]:port for an IPv6 address
+void server_ring::add_server(const std::string &host_port, int resolution, bool resolve_on_connect)
+{
+    size_t colon = host_port.rfind(':');
+    if (colon == std::string::npos || colon == 0) {
+        throw std::runtime_error("'" + host_port + "' is not host:port");
+    }
+
+    std::string host = host_port.substr(0, colon);
+    if (host.length() > 2 && host[0] == '[' && host[host.length() - 1] == ']') {
+        host = host.substr(1, host.length() - 2);
+    }
+
+    char *endptr = NULL;
+    unsigned long port = strtoul(host_port.c_str() + colon + 1, &endptr, 10);
+    if (!endptr || *endptr != '\0' || port == 0 || port > 65535) {
+        throw std::runtime_error("'" + host_port + "' has no valid port");
+    }
+
+    if (std::find(m_names.begin(), m_names.end(), host_port) != m_names.end()) {
+        throw std::runtime_error("'" + host_port + "' is listed twice");
+    }
+
+    try {
+        m_servers.push_back(new server_addr(host.c_str(), port, resolution, resolve_on_connect));
+    } catch (std::runtime_error &e) {
+        throw std::runtime_error(host_port + ": " + e.what());
+    }
+    m_ports.push_back(port);
+    m_names.push_back(host_port);
+}
+
+unsigned int server_ring::get_server(const char *key, unsigned int key_len) const
+{
+    switch (m_sharding) {
+    case SHARDING_KETAMA: {
+        // the first point at or after the key's hash, wrapping around
+        std::vector<std::pair<unsigned int, unsigned int> >::const_iterator i =
+            std::lower_bound(m_ring.begin(), m_ring.end(), std::make_pair(hash32(key, key_len), 0U));
+        if (i == m_ring.end()) i = m_ring.begin();
+        return i->second;
+    }
+    case SHARDING_JUMP:
+        return jump_hash(hash64(key, key_len), m_servers.size());
+    default:
+        return hash32(key, key_len) % m_servers.size();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+sharded_client::sharded_client(client_group *group) : client(group)
+{
+    if (!m_initialized) return;
+
+    // the main connection goes to the first server, one more to every other
+    for (unsigned int i = 0; i < m_config->servers_ring->size(); i++) {
+        if (i > 0) {
+            m_connections.push_back(
+                new shard_connection(i, this, m_config, m_event_base, MAIN_CONNECTION->get_protocol()));
+        }
+        m_key_index_pools.push_back(new key_index_pool);
+    }
+}
+
+sharded_client::~sharded_client()
+{
+    for (unsigned int i = 0; i < m_key_index_pools.size(); i++) {
+        delete m_key_index_pools[i];
+    }
+    m_key_index_pools.clear();
+}
+
+// Connects every connection that is not connected yet: all of them at first,
+// then the ones that dropped when they reconnect
+int sharded_client::connect(void)
+{
+    int ret = 0;
+
+    for (unsigned int i = 0; i < m_connections.size(); i++) {
+        shard_connection *sc = m_connections[i];
+        if (sc->get_connection_state() != conn_disconnected) continue;
+
+        if (connect_conn(sc, m_config->servers_ring->get_server_addr(i), m_config->servers_ring->get_port(i)) != 0)
+            ret = -1;
+    }
+
+    return ret;
+}
+
+bool sharded_client::hold_pipeline(unsigned int conn_id)
+{
+    if (m_connections[conn_id]->get_connection_state() == conn_disconnected) return true;
+
+    // keys handed over by the other connections were counted already
+    if (!m_key_index_pools[conn_id]->empty()) return false;
+
+    return client::hold_pipeline(conn_id);
+}
+
+get_key_response sharded_client::get_key_for_conn(unsigned int command_index, unsigned int conn_id,
+                                                  unsigned long long *key_index)
+{
+    // first check if we already have a key in the pool
+    if (!m_key_index_pools[conn_id]->empty()) {
+        *key_index = m_key_index_pools[conn_id]->front();
+        m_obj_gen->generate_key(*key_index);
+
+        m_key_index_pools[conn_id]->pop();
+        return available_for_conn;
+    }
+
+    client::get_key_for_conn(command_index, conn_id, key_index);
+
+    unsigned int other_conn_id = m_config->servers_ring->get_server(m_obj_gen->get_key(), m_obj_gen->get_key_len());
+    if (other_conn_id == conn_id) return available_for_conn;
+
+    // keys of a server that is down wait for it only as long as its pool has room
+    key_index_pool *key_idx_pool = m_key_index_pools[other_conn_id];
+    if (key_idx_pool->size() >= KEY_INDEX_QUEUE_MAX_SIZE) return not_available;
+
+    benchmark_debug_log("%s generated key=[%.*s] for %s\n", m_connections[conn_id]->get_readable_id(),
+                        m_obj_gen->get_key_len(), m_obj_gen->get_key(),
+                        m_connections[other_conn_id]->get_readable_id());
+
+    key_idx_pool->push(command_index);
+    key_idx_pool->push(*key_index);
+    return available_for_other_conn;
+}
+
+bool sharded_client::create_arbitrary_request(unsigned int command_index, struct timeval &timestamp,
+                                              unsigned int conn_id)
+{
+    /* keyless command can be used by any connection */
+    if (get_arbitrary_command(command_index).keys_count == 0) {
+        client::create_arbitrary_request(command_index, timestamp, conn_id);
+        return true;
+    }
+
+    unsigned long long key_index;
+    get_key_response res = get_key_for_conn(command_index, conn_id, &key_index);
+
+    if (res == not_available) return false;
+
+    /* If we generated a key for a different connection, it sends it later */
+    if (res == available_for_other_conn) return true;
+
+    /* Put the key back for client::create_arbitrary_request() to use */
+    m_key_index_pools[conn_id]->push(key_index);
+    client::create_arbitrary_request(command_index, timestamp, conn_id);
+
+    return true;
+}
+
+void sharded_client::create_request(struct timeval timestamp, unsigned int conn_id)
+{
+    /* If pool is empty continue with base class */
+    if (m_key_index_pools[conn_id]->empty()) {
+        client::create_request(timestamp, conn_id);
+        return;
+    }
+
+    unsigned int command_index = m_key_index_pools[conn_id]->front();
+    m_key_index_pools[conn_id]->pop();
+
+    if (m_config->arbitrary_commands->is_defined())
+        client::create_arbitrary_request(command_index, timestamp, conn_id);
+    else if (command_index == SET_CMD_IDX)
+        create_set_request(timestamp, conn_id);
+    else
+        create_get_request(timestamp, conn_id);
+}
+
+shard_stats *sharded_client::get_shard_stats(unsigned int conn_id)
+{
+    if (conn_id >= m_shard_stats.size()) m_shard_stats.resize(m_connections.size(), NULL);
+    if (m_shard_stats[conn_id] == NULL) {
+        m_shard_stats[conn_id] = m_stats.get_shard_stats(m_connections[conn_id]->get_readable_id());
+    }
+
+    return m_shard_stats[conn_id];
+}
+
+void sharded_client::handle_response(unsigned int conn_id, struct timeval timestamp, request *request,
+                                     protocol_response *response)
+{
+    if (request->m_type == rt_get || request->m_type == rt_set || request->m_type == rt_arbitrary) {
+        unsigned int hits = 0;
+        unsigned int misses = 0;
+        if (request->m_type == rt_get) {
+            hits = std::min(response->get_hits(), request->m_keys);
+            misses = request->m_keys - hits;
+        }
+        get_shard_stats(conn_id)->update_op(response->get_total_len() + request->m_size,
+                                            ts_diff(request->m_sent_time, timestamp), hits, misses);
+    }
+
+    // continue with base class
+    client::handle_response(conn_id, timestamp, request, response);
+}
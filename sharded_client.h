@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2011-2026 Redis Labs Ltd.
+ *
+ * This file is part of memtier_benchmark.
+ *
+ * memtier_benchmark is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * memtier_benchmark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with memtier_benchmark.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEMTIER_BENCHMARK_SHARDED_CLIENT_H
+#define MEMTIER_BENCHMARK_SHARDED_CLIENT_H
+
+#include <string>
+#include <utility>
+#include "client.h"
+
+// The standalone servers of --servers, and the server every key goes to:
+// by ketama consistent hashing, jump consistent hashing or the key hash
+// modulo the number of servers.  Built once and shared read-only by all the
+// threads.
+class server_ring
+{
+public:
+    // servers is a comma separated list of host:port
+    server_ring(const char *servers, enum SHARDING sharding, int resolution, bool resolve_on_connect);
+    ~server_ring();
+
+    unsigned int size() const { return m_servers.size(); }
+    struct server_addr *get_server_addr(unsigned int server) const { return m_servers[server]; }
+    unsigned int get_port(unsigned int server) const { return m_ports[server]; }
+
+    unsigned int get_server(const char *key, unsigned int key_len) const;
+
+    // points of every server on the ketama ring
+    static const unsigned int ketama_points = 160;
+
+protected:
+    void add_server(const std::string &host_port, int resolution, bool resolve_on_connect);
+
+    enum SHARDING m_sharding;
+    std::vector<struct server_addr *> m_servers;
+    std::vector<unsigned int> m_ports;
+    std::vector<std::string> m_names;                           // host:port as given
+    std::vector<std::pair<unsigned int, unsigned int> > m_ring; // (point, server), by point
+};
+
+// A client with a connection to every server of --servers, each key sent to
+// the server it is distributed to.  Keys generated by a connection for
+// another server are handed over to that server's connection.
+class sharded_client : public client
+{
+protected:
+    std::vector<key_index_pool *> m_key_index_pools;
+
+    // per server stats of every connection, looked up on its first reply
+    std::vector<shard_stats *> m_shard_stats;
+
+    virtual int connect(void);
+    shard_stats *get_shard_stats(unsigned int conn_id);
+
+public:
+    sharded_client(client_group *group);
+    virtual ~sharded_client();
+
+    virtual get_key_response get_key_for_conn(unsigned int command_index, unsigned int conn_id,
+                                              unsigned long long *key_index);
+    virtual bool create_arbitrary_request(unsigned int command_index, struct timeval &timestamp, unsigned int conn_id);
+
+    // client manager api's
+    virtual void create_request(struct timeval timestamp, unsigned int conn_id);
+    virtual bool hold_pipeline(unsigned int conn_id);
+    virtual void handle_response(unsigned int conn_id, struct timeval timestamp, request *request,
+                                 protocol_response *response);
+};
+
+#endif // MEMTIER_BENCHMARK_SHARDED_CLIENT_H
@@ -1,6 +1,9 @@
 import glob
 import os
 import logging
+import socketserver
+import struct
+import threading
 
 MEMTIER_BINARY = os.environ.get("MEMTIER_BINARY", "memtier_benchmark")
 TLS_CERT = os.environ.get("TLS_CERT", "")
@@ -185,4 +188,124 @@ def get_column_csv(filename,column_name):
         if found is True:
             for line in data_lines:
                 column_data.append(line[col_pos])
-    return found, column_data
\ No newline at end of file
+    return found, column_data
+
+class FakeMemcached(object):
+    """
+    A memcached standing in for the protocols the test servers don't speak,
+    counting the requests it answers.  The binary protocol answers SET, GET
+    and quiet GETKQ requests ended by a NOOP, the meta one ms, mg and mn.
+    Gets of error_keys are answered with a SERVER_ERROR (meta only), and an
+    mn following any of them counts a failed batch.
+    """
+
+    def __init__(self, protocol, error_keys=()):
+        self.protocol = protocol
+        self.error_keys = set(error_keys)
+        self.store = {}
+        self.counts = {'set': 0, 'get': 0, 'batches': 0, 'hits': 0, 'misses': 0, 'failed_batches': 0}
+        self.lock = threading.Lock()
+
+        fake = self
+
+        class Handler(socketserver.StreamRequestHandler):
+            def handle(self):
+                try:
+                    if fake.protocol == 'binary':
+                        fake.handle_binary(self.rfile, self.wfile)
+                    else:
+                        fake.handle_meta(self.rfile, self.wfile)
+                except ConnectionError:
+                    pass
+
+        self.server = socketserver.ThreadingTCPServer(('127.0.0.1', 0), Handler)
+        self.server.daemon_threads = True
+        self.port = self.server.server_address[1]
+        self.thread = threading.Thread(target=self.server.serve_forever)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def stop(self):
+        self.server.shutdown()
+        self.server.server_close()
+
+    def count(self, name, n=1):
+        with self.lock:
+            self.counts[name] += n
+
+    @staticmethod
+    def binary_response(opcode, status=0, key=b'', value=b'', extras=b'', opaque=0):
+        body = extras + key + value
+        return struct.pack('>BBHBBHIIQ', 0x81, opcode, len(key), len(extras), 0, status, len(body), opaque, 0) + body
+
+    def handle_binary(self, rfile, wfile):
+        while True:
+            header = rfile.read(24)
+            if len(header) < 24:
+                return
+            _, opcode, key_len, extras_len, _, _, body_len, opaque, _ = struct.unpack('>BBHBBHIIQ', header)
+            body = rfile.read(body_len)
+            key = body[extras_len:extras_len + key_len]
+            value = body[extras_len + key_len:]
+
+            if opcode == 0x01:  # SET
+                self.store[key] = value
+                self.count('set')
+                wfile.write(self.binary_response(opcode, opaque=opaque))
+            elif opcode in (0x00, 0x0c):  # GET, GETK
+                self.count('get')
+                if key in self.store:
+                    wfile.write(self.binary_response(opcode, value=self.store[key], extras=b'\0' * 4, opaque=opaque))
+                else:
+                    wfile.write(self.binary_response(opcode, status=1, opaque=opaque))
+            elif opcode == 0x0d:  # GETKQ, only hits are answered
+                hit = key in self.store
+                self.count('hits' if hit else 'misses')
+                if hit:
+                    wfile.write(self.binary_response(opcode, key=key, value=self.store[key], extras=b'\0' * 4,
+                                                     opaque=opaque))
+            elif opcode == 0x0a:  # NOOP
+                self.count('batches')
+                wfile.write(self.binary_response(opcode, opaque=opaque))
+            else:
+                wfile.write(self.binary_response(opcode, status=0x81, opaque=opaque))
+            wfile.flush()
+
+    def handle_meta(self, rfile, wfile):
+        failed = False
+        while True:
+            line = rfile.readline()
+            if not line:
+                return
+            tokens = line.split()
+            if not tokens:
+                continue
+
+            if tokens[0] == b'ms':
+                self.store[tokens[1]] = rfile.read(int(tokens[2]) + 2)[:-2]
+                self.count('set')
+                if b'q' not in tokens[3:]:
+                    wfile.write(b'HD\r\n')
+            elif tokens[0] == b'mg':
+                quiet = b'q' in tokens[2:]
+                if quiet:
+                    self.count('hits' if tokens[1] in self.store else 'misses')
+                else:
+                    self.count('get')
+                if tokens[1] in self.error_keys:
+                    failed = True
+                    wfile.write(b'SERVER_ERROR out of memory\r\n')
+                elif tokens[1] in self.store:
+                    value = self.store[tokens[1]]
+                    wfile.write(b'VA %d\r\n%s\r\n' % (len(value), value))
+                elif not quiet:
+                    wfile.write(b'EN\r\n')
+            elif tokens[0] == b'mn':
+                self.count('batches')
+                if failed:
+                    self.count('failed_batches')
+                failed = False
+                wfile.write(b'MN\r\n')
+            else:
+                wfile.write(b'ERROR\r\n')
+            wfile.flush()
@@ -1,4 +1,5 @@
 import tempfile
+import json
 import time
 import threading
 from include import *
@@ -148,6 +149,16 @@ def test_reconnect_on_connection_kill(env):
                 env.debugPrint("WARNING: No reconnection messages found in stderr", True)
             env.assertTrue(has_reconnect_msg)
 
+        # The dropped connections are reported in the availability timeline
+        with open("{0}/mb.json".format(config.results_dir)) as results_json:
+            results_dict = json.load(results_json)
+            env.assertTrue("Availability" in results_dict["ALL STATS"])
+            availability = results_dict["ALL STATS"]["Availability"]
+            env.assertTrue(availability["First Error (sec)"] <= availability["Last Error (sec)"])
+            events = [event["Event"] for event in availability["Timeline"]]
+            env.assertEqual(events[0], "First error")
+            env.assertTrue("Connection errors" in events)
+
         # Verify that some requests were completed
         # (we may not get the exact expected count due to reconnections, but should get some)
         merged_command_stats = {
@@ -268,3 +279,95 @@ def test_reconnect_disabled_by_default(env):
     if not killed:
         env.debugPrint("WARNING: No connections were killed", True)
     env.assertTrue(killed)
+
+
+def test_reconnect_during_scatter_gather_multi_key_get(env):
+    """
+    Test that a multi-key get scattered over the shards still completes when
+    the connections to one of them are killed while its parts are in flight.
+
+    A request that lost a part is processed once, as a failed request, so the
+    run neither stalls nor needs its threads restarted.
+    """
+    if not env.isCluster():
+        env.skip()
+
+    requests = 50000
+    benchmark_specs = {
+        "name": env.testName,
+        "args": [
+            "--ratio=0:1",
+            "--multi-key-get=5",
+            "--pipeline=4",
+            "--key-maximum=1000",
+            "--reconnect-on-error",
+            "--max-reconnect-attempts=10",
+        ],
+    }
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests=requests)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # the node whose connections are killed
+    master_connection = env.getOSSMasterNodesConnectionList()[0]
+    killed = [0]
+
+    def memtier_client_ids():
+        clients = master_connection.execute_command("CLIENT", "LIST")
+        if isinstance(clients, bytes):
+            clients = clients.decode('utf-8')
+
+        ids = []
+        for client_line in clients.split("\n"):
+            client_info = dict(part.split("=", 1) for part in client_line.split() if "=" in part)
+            if "id" in client_info and client_info.get("cmd") == "mget":
+                ids.append(client_info["id"])
+        return ids
+
+    def node_killer():
+        # once every client sends its gets, all at once
+        deadline = time.time() + 10
+        while time.time() < deadline:
+            ids = memtier_client_ids()
+            if len(ids) >= 4:
+                for client_id in ids:
+                    try:
+                        master_connection.execute_command("CLIENT", "KILL", "ID", client_id)
+                        killed[0] += 1
+                    except Exception:
+                        pass
+                return
+            time.sleep(0.05)
+
+    killer_thread = threading.Thread(target=node_killer)
+    killer_thread.daemon = True
+    killer_thread.start()
+
+    memtier_ok = benchmark.run()
+    killer_thread.join(timeout=5)
+
+    debugPrintMemtierOnError(config, env)
+    env.assertTrue(memtier_ok == True)
+    env.assertTrue(killed[0] > 0)
+
+    with open("{0}/mb.stderr".format(config.results_dir)) as stderr:
+        env.assertFalse("requesting restart" in stderr.read())
+
+    with open("{0}/mb.json".format(config.results_dir)) as results_json:
+        all_stats = json.load(results_json)["ALL STATS"]
+        failed = all_stats["Availability"]["Requests Failed"]
+        env.assertTrue(failed > 0)
+
+        # every request is done once, whether its parts replied or one was lost
+        env.assertEqual(all_stats["Totals"]["Count"] + failed, 2 * 2 * requests)
+        fanout = all_stats["Fan-out"]
+        env.assertEqual(sum(width["Count"] for width in fanout.values()), all_stats["Gets"]["Count"])
@@ -5,6 +5,8 @@ import signal
 import subprocess
 import shutil
 import os
+import sys
+import threading
 from include import *
 from mb import Benchmark, RunConfig
 
@@ -1158,3 +1160,986 @@ def test_interrupt_signal_handling(env):
         env.assertTrue("Count" in totals_metrics)
         total_count = totals_metrics["Count"]
         env.assertTrue(total_count > 0)
+
+
+def test_thread_stats(env):
+    benchmark_specs = {"name": env.testName, "args": ['--thread-stats']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config()
+    master_nodes_list = env.getMasterNodesList()
+    overall_expected_request_count = get_expected_request_count(config)
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+
+    master_nodes_connections = env.getOSSMasterNodesConnectionList()
+    merged_command_stats = {'cmdstat_set': {'calls': 0}, 'cmdstat_get': {'calls': 0}}
+    overall_request_count = agg_info_commandstats(master_nodes_connections, merged_command_stats)
+    assert_minimum_memtier_outcomes(config, env, memtier_ok, overall_expected_request_count, overall_request_count)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        overhead = results_dict['ALL STATS']['Thread Overhead']
+        env.assertEqual(overhead['Time unit'], 'MICROSECONDS')
+        for thread_id in range(config.mb_threads):
+            env.assertTrue(str(thread_id) in overhead)
+            thread = overhead[str(thread_id)]
+            for metric in ['CPU Utilization', 'Wall Time', 'User Time', 'System Time', 'Idle Time',
+                           'Create Request Time', 'Parse Response Time', 'Stats Update Time']:
+                env.assertTrue(metric in thread)
+            env.assertTrue(thread['Wall Time'] > 0)
+            env.assertTrue(thread['Create Request Time'] > 0)
+            env.assertTrue(thread['Parse Response Time'] > 0)
+
+
+def test_connect_wave_size(env):
+    benchmark_specs = {"name": env.testName, "args": ['--connect-wave-size=2']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config()
+    master_nodes_list = env.getMasterNodesList()
+    overall_expected_request_count = get_expected_request_count(config)
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+
+    master_nodes_connections = env.getOSSMasterNodesConnectionList()
+    merged_command_stats = {'cmdstat_set': {'calls': 0}, 'cmdstat_get': {'calls': 0}}
+    overall_request_count = agg_info_commandstats(master_nodes_connections, merged_command_stats)
+    assert_minimum_memtier_outcomes(config, env, memtier_ok, overall_expected_request_count, overall_request_count)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        setup = results_dict['ALL STATS']['Connection Setup']
+        env.assertEqual(setup['Time unit'], 'MILLISECONDS')
+        # cluster mode adds one connection per shard on top of the main ones
+        env.assertTrue(setup['Connects'] >= config.mb_threads * config.mb_clients)
+        env.assertTrue(setup['Time To All Connected'] > 0)
+        env.assertTrue(setup['Max Connect Time'] >= setup['Min Connect Time'])
+
+
+def test_tls_session_reuse(env):
+    if not env.useTLS:
+        env.skip()
+    # reconnect often so that later connections have a session to resume
+    benchmark_specs = {"name": env.testName, "args": ['--tls-session-reuse', '--reconnect-interval=100']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config()
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        handshakes = results_dict['ALL STATS']['TLS Handshakes']
+        env.assertEqual(handshakes['Handshakes'], handshakes['Full'] + handshakes['Resumed'])
+        env.assertTrue(handshakes['Full'] >= 1)
+        env.assertTrue(handshakes['Resumed'] > 0)
+        env.assertTrue(handshakes['Resumption Ratio'] > 0)
+
+
+def test_multi_key_get(env):
+    # every GET turn is a single MGET of up to 5 keys
+    benchmark_specs = {"name": env.testName, "args": ['--ratio=1:5', '--multi-key-get=5', '--key-maximum=1000']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests=500)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    master_nodes_connections = env.getOSSMasterNodesConnectionList()
+    merged_command_stats = {'cmdstat_mget': {'calls': 0}, 'cmdstat_get': {'calls': 0}}
+    agg_info_commandstats(master_nodes_connections, merged_command_stats)
+    env.assertTrue(merged_command_stats['cmdstat_mget']['calls'] > 0)
+    env.assertEqual(merged_command_stats['cmdstat_get']['calls'], 0)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        get_metrics = results_dict['ALL STATS']['Gets']
+        # hits and misses are per key, so together they cover 1 to 5 keys per request
+        keys_sec = get_metrics['Hits/sec'] + get_metrics['Misses/sec']
+        env.assertTrue(keys_sec >= get_metrics['Ops/sec'])
+        env.assertTrue(keys_sec <= 5 * get_metrics['Ops/sec'] * 1.01)
+        env.assertTrue(get_metrics['Hits/sec'] > 0)
+
+
+def test_scatter_gather_multi_key_get(env):
+    if not env.isCluster():
+        env.skip()
+
+    # every MGET of 5 keys is split by slot and done when all its parts replied
+    benchmark_specs = {"name": env.testName, "args": ['--ratio=1:5', '--multi-key-get=5', '--key-maximum=1000']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests=500)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        env.assertEqual(results_dict['ALL STATS']['Totals']['Count'], 2 * 2 * 500)
+
+        fanout = results_dict['ALL STATS']['Fan-out']
+        env.assertEqual(sum(width['Count'] for width in fanout.values()), results_dict['ALL STATS']['Gets']['Count'])
+        for nodes, width in fanout.items():
+            env.assertTrue(1 <= int(nodes) <= len(master_nodes_list))
+            # a slot whose shard is not connected yet is left out
+            env.assertTrue(0 < width['Keys/op'] <= 5)
+
+
+def test_key_group_size_multi_key_get(env):
+    if not env.isCluster():
+        env.skip()
+
+    # the keys of a group share a hash tag, so every MGET stays on one shard
+    benchmark_specs = {"name": env.testName,
+                       "args": ['--ratio=1:5', '--multi-key-get=5', '--key-maximum=1000', '--key-group-size=10',
+                                '--key-prefix=user:{tag}:']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests=500)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        env.assertEqual(results_dict['ALL STATS']['Totals']['Count'], 2 * 2 * 500)
+
+        fanout = results_dict['ALL STATS']['Fan-out']
+        env.assertEqual(list(fanout.keys()), ['1'])
+        env.assertEqual(fanout['1']['Keys/op'], 5)
+
+    # keys are named after their group
+    for master_connection in env.getOSSMasterNodesConnectionList():
+        for key in master_connection.keys('user:*'):
+            if isinstance(key, bytes):
+                key = key.decode('utf-8')
+            index = int(key.split(':')[2])
+            env.assertEqual(key, 'user:{%d}:%d' % (index // 10, index))
+
+def test_client_tracking(env):
+    # a small key range so SETs keep hitting keys other connections have read
+    benchmark_specs = {"name": env.testName,
+                       "args": ['-P', 'resp3', '--client-tracking', '--ratio=1:1', '--key-maximum=100']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests=1000)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        invalidations = results_dict['ALL STATS']['Client Tracking Invalidations']
+        env.assertTrue(invalidations['Invalidations'] > 0)
+        env.assertTrue(invalidations['Timed Invalidations'] > 0)
+        env.assertTrue(invalidations['Max Latency'] >= invalidations['Min Latency'])
+
+
+def test_pubsub(env):
+    # 2 subscribers and 2 publishers per thread, SPUBLISH in cluster mode
+    benchmark_specs = {"name": env.testName, "args": ['--pubsub-channels=10', '--pubsub-subscribers=2']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=4, requests=1000)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        pubsub = results_dict['ALL STATS']['Pub/Sub']
+        env.assertEqual(pubsub['Subscribers'], 4)
+        env.assertEqual(pubsub['Published'], 2 * 2 * 1000)
+        env.assertTrue(pubsub['Delivered'] > 0)
+        env.assertTrue(pubsub['Delivered'] <= pubsub['Published'] * pubsub['Subscribers'])
+
+
+def test_compound_command(env):
+    # a transaction and a script, each counted as a single operation
+    benchmark_specs = {"name": env.testName, "args": []}
+    addTLSArgs(benchmark_specs, env)
+    # on arbitrary command args should be the last one
+    benchmark_specs["args"].append('--command=MULTI ; INCR __key__ ; EXEC')
+    benchmark_specs["args"].append("--command=EVAL 'return 1' 0")
+    config = get_default_memtier_config(threads=2, clients=2, requests=1000)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        env.assertEqual(results_dict['ALL STATS']['Multi+incr+execs']['Count'], 2 * 2 * 500)
+        env.assertEqual(results_dict['ALL STATS']['Evals']['Count'], 2 * 2 * 500)
+
+
+def test_streams(env):
+    # 1 consumer and 3 producers per thread, all consumers in one group
+    benchmark_specs = {"name": env.testName, "args": ['--streams=10', '--stream-consumers=1', '--stream-count=20']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=4, requests=1000)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        streams = results_dict['ALL STATS']['Streams']
+        env.assertEqual(streams['Added'], 2 * 3 * 1000)
+        env.assertTrue(streams['Read'] > 0)
+        env.assertTrue(streams['Read'] <= streams['Added'])
+        env.assertEqual(streams['Lag'], streams['Added'] - streams['Read'])
+        env.assertTrue(len(streams['Time-Serie']) > 0)
+
+
+def test_queues(env):
+    # 1 consumer and 3 producers per thread, consumers pop with a short timeout
+    benchmark_specs = {"name": env.testName, "args": ['--queues=10', '--queue-consumers=1', '--queue-timeout=0.1']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=4, requests=1000)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        queues = results_dict['ALL STATS']['Queues']
+        env.assertEqual(queues['Pushed'], 2 * 3 * 1000)
+        env.assertTrue(queues['Popped'] > 0)
+        env.assertTrue(queues['Popped'] <= queues['Pushed'])
+        env.assertEqual(queues['Depth'], queues['Pushed'] - queues['Popped'])
+        env.assertEqual(queues['Delivery']['Count'], queues['Popped'])
+        env.assertTrue(len(queues['Time-Serie']) > 0)
+
+
+def test_data_types(env):
+    # every Set writes a 20 field hash, Gets read 5 fields of it
+    benchmark_specs = {"name": env.testName, "args": ['--data-type=hash', '--data-fields=20',
+                                                      '--data-read-fields=5', '--ratio=1:1', '--key-maximum=100']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests=1000)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        elements = results_dict['ALL STATS']['Data Type Elements']
+        env.assertEqual(elements['Type'], 'hash')
+        env.assertEqual(elements['Written'], 2 * 2 * 500 * 20)
+        env.assertEqual(elements['Reads'], 2 * 2 * 500)
+        env.assertTrue(elements['Read'] > 0)
+        env.assertTrue(elements['Read'] <= elements['Reads'] * 5)
+        env.assertTrue(elements['Max Reply Bytes'] > 0)
+
+
+def test_first_byte_stats(env):
+    # large values, so that replies take more than a read to arrive
+    benchmark_specs = {"name": env.testName, "args": ['--first-byte-stats', '--data-size=100000', '--ratio=1:1',
+                                                      '--key-maximum=100']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests=200)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        first_byte = results_dict['ALL STATS']['Time To First Byte']
+        for command in ['Sets', 'Gets']:
+            ttfb = first_byte['{} TTFB'.format(command)]
+            ttlb = first_byte['{} TTLB'.format(command)]
+            env.assertEqual(ttfb['Count'], 2 * 2 * 100)
+            env.assertEqual(ttfb['Count'], ttlb['Count'])
+            env.assertTrue(ttfb['Average Latency'] <= ttlb['Average Latency'])
+
+
+def test_shard_stats(env):
+    if not env.isCluster():
+        env.skip()
+
+    benchmark_specs = {"name": env.testName, "args": []}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests=1000)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        shards = results_dict['ALL STATS']['Shards']
+        skew = shards.pop('Skew')
+
+        # every request is answered by one of the shards
+        env.assertEqual(len(shards), len(master_nodes_list))
+        env.assertEqual(sum(shard['Count'] for shard in shards.values()), 2 * 2 * 1000)
+        env.assertTrue(skew['Max Ops/sec'] >= skew['Min Ops/sec'])
+        env.assertTrue(skew['Max/Avg'] >= 1)
+
+
+def test_read_from_replica(env):
+    if not env.isCluster():
+        env.skip()
+
+    benchmark_specs = {"name": env.testName, "args": ['--read-from=replica', '--ratio=1:3']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests=1000)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        all_stats = results_dict['ALL STATS']
+        shards = all_stats['Shards']
+        shards.pop('Skew')
+        roles = shards.pop('Roles', None)
+
+        # every request is still answered, the reads by a replica when the shard has one
+        env.assertEqual(sum(shard['Count'] for shard in shards.values()), 2 * 2 * 1000)
+        if roles is not None:
+            env.assertEqual(roles['Primaries']['Count'], all_stats['Sets']['Count'])
+            env.assertEqual(roles['Replicas']['Count'], all_stats['Gets']['Count'])
+        else:
+            env.assertEqual(len(shards), len(master_nodes_list))
+
+
+def test_slot_aware_keys(env):
+    if not env.isCluster():
+        env.skip()
+
+    # every connection draws keys of its own slots, so the shards get an even share
+    benchmark_specs = {"name": env.testName, "args": ['--key-pattern=R:R', '--key-maximum=100000']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=4, requests=2000)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        shards = results_dict['ALL STATS']['Shards']
+        skew = shards.pop('Skew')
+
+        env.assertEqual(len(shards), len(master_nodes_list))
+        env.assertEqual(sum(shard['Count'] for shard in shards.values()), 2 * 4 * 2000)
+        env.assertTrue(skew['Max/Min'] < 1.5)
+
+
+def test_slot_cache_keyspace_slots(env):
+    if not env.isCluster():
+        env.skip()
+
+    # a cache too small for the keys of every slot still looks the slots up,
+    # and reports how the key range falls into them
+    benchmark_specs = {"name": env.testName, "args": ['--key-maximum=200000', '--slot-cache-mb=1']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=4, requests=2000)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        env.assertEqual(results_dict['configuration']['slot_cache_mb'], 1)
+
+        slots = results_dict['ALL STATS']['Keyspace Slots']
+        env.assertEqual(slots['Keys'], 200001)
+        env.assertTrue(slots['Slots Used'] <= 16384)
+        env.assertTrue(slots['Min Keys/Slot'] <= slots['Avg Keys/Slot'] <= slots['Max Keys/Slot'])
+
+        shards = results_dict['ALL STATS']['Shards']
+        shards.pop('Skew')
+        env.assertEqual(sum(shard['Count'] for shard in shards.values()), 2 * 4 * 2000)
+
+
+def test_cluster_refresh_interval(env):
+    if not env.isCluster():
+        env.skip()
+
+    # the topology is refreshed on a connection of its own, not reported as a shard
+    benchmark_specs = {"name": env.testName, "args": ['--cluster-refresh-interval=1', '--rate-limiting=1000']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests=2000)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        shards = results_dict['ALL STATS']['Shards']
+        shards.pop('Skew')
+
+        env.assertEqual(len(shards), len(master_nodes_list))
+        env.assertEqual(sum(shard['Count'] for shard in shards.values()), 2 * 2 * 2000)
+
+
+def test_zero_copy_threshold(env):
+    # values of 4KB are attached by reference, each still written in full and
+    # each a different window of the random data
+    key_max = 1000
+    benchmark_specs = {"name": env.testName, "args": ['--ratio=1:0', '--key-pattern=P:P', '--key-minimum=1',
+                                                      '--key-maximum={}'.format(key_max), '--data-size=4096',
+                                                      '--random-data', '--zero-copy-threshold=1024']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests='allkeys')
+    master_nodes_list = env.getMasterNodesList()
+    overall_expected_request_count = get_expected_request_count(config, 1, key_max)
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+
+    master_nodes_connections = env.getOSSMasterNodesConnectionList()
+    merged_command_stats = {'cmdstat_set': {'calls': 0}, 'cmdstat_get': {'calls': 0}}
+    overall_request_count = agg_info_commandstats(master_nodes_connections, merged_command_stats)
+    assert_minimum_memtier_outcomes(config, env, memtier_ok, overall_expected_request_count, overall_request_count)
+    assert_keyspace_range(env, key_max, 1, master_nodes_connections)
+
+    values = set()
+    for conn in master_nodes_connections:
+        for key in conn.execute_command("KEYS", "memtier-*"):
+            value = conn.execute_command("GET", key)
+            env.assertEqual(len(value), 4096)
+            values.add(value)
+    env.assertTrue(len(values) > 1)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        env.assertEqual(results_dict['configuration']['zero_copy_threshold'], 1024)
+
+
+def test_source_address(env):
+    if env.isUnixSocket() or not sys.platform.startswith('linux'):
+        env.skip()
+    # connections are bound round-robin to two loopback addresses of their own
+    benchmark_specs = {"name": env.testName, "args": ['--source-address=127.0.0.2,127.0.0.3', '--rate-limiting=100']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=2, requests=None, test_time=3)
+    master_nodes_list = env.getMasterNodesList()
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # collect the addresses the clients connect from while the benchmark runs
+    master_nodes_connections = env.getOSSMasterNodesConnectionList()
+    result = {}
+    runner = threading.Thread(target=lambda: result.update(ok=benchmark.run()))
+    runner.start()
+    source_ips = set()
+    while runner.is_alive():
+        time.sleep(0.5)
+        for conn in master_nodes_connections:
+            clients = conn.execute_command("CLIENT", "LIST")
+            if isinstance(clients, bytes):
+                clients = clients.decode('utf-8')
+            for client_line in clients.split("\n"):
+                for part in client_line.split(' '):
+                    if part.startswith('addr='):
+                        source_ips.add(part[len('addr='):].rsplit(':', 1)[0])
+    runner.join()
+    env.assertTrue(result['ok'])
+
+    env.assertTrue('127.0.0.2' in source_ips)
+    env.assertTrue('127.0.0.3' in source_ips)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        env.assertEqual(results_dict['configuration']['source_address'], '127.0.0.2,127.0.0.3')
+
+
+def test_memcache_binary_multi_key_get(env):
+    if env.isCluster() or env.isUnixSocket() or env.useTLS:
+        env.skip()
+    # every GET turn is a batch of quiet GETKQ requests ended by a NOOP
+    server = FakeMemcached('binary')
+    benchmark_specs = {"name": env.testName, "args": ['--protocol=memcache_binary', '--ratio=1:4',
+                                                      '--multi-key-get=5', '--key-maximum=200']}
+    config = get_default_memtier_config(threads=2, clients=2, requests=500)
+    config['redis_process_port'] = server.port
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    server.stop()
+    env.assertTrue(memtier_ok)
+
+    counts = server.counts
+    env.assertEqual(counts['set'] + counts['batches'], 2 * 2 * 500)
+    env.assertTrue(counts['hits'] + counts['misses'] > counts['batches'])
+    env.assertTrue(counts['hits'] > 0)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        gets = results_dict['ALL STATS']['Gets']
+        env.assertEqual(gets['Count'], counts['batches'])
+        # every key of a batch is a hit or a miss
+        hit_ratio = gets['Hits/sec'] / (gets['Hits/sec'] + gets['Misses/sec'])
+        env.assertAlmostEqual(hit_ratio, counts['hits'] / (counts['hits'] + counts['misses']), 0.01)
+
+
+def test_memcache_meta_multi_key_get_error(env):
+    if env.isCluster() or env.isUnixSocket() or env.useTLS:
+        env.skip()
+    # an error in the middle of a batch of quiet mg fails that request only,
+    # the pipelined requests after it still get their own answers
+    server = FakeMemcached('meta', error_keys=[b'memtier-7'])
+    benchmark_specs = {"name": env.testName, "args": ['--protocol=memcache_meta', '--ratio=1:1', '--pipeline=4',
+                                                      '--multi-key-get=10', '--key-maximum=100']}
+    config = get_default_memtier_config(threads=2, clients=2, requests=1000)
+    config['redis_process_port'] = server.port
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    server.stop()
+    env.assertTrue(memtier_ok)
+
+    counts = server.counts
+    env.assertTrue(counts['failed_batches'] > 0)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        all_stats = results_dict['ALL STATS']
+        env.assertEqual(all_stats['Sets']['Count'], counts['set'])
+        # every batch is opened and closed by an mn
+        env.assertEqual(all_stats['Gets']['Count'] * 2, counts['batches'])
+        env.assertEqual(all_stats['Sets']['Count'] + all_stats['Gets']['Count'], 2 * 2 * 1000)
+        env.assertEqual(all_stats['Availability']['Requests Failed'], counts['failed_batches'])
+
+
+def test_shared_connections(env):
+    # the 5 clients of each thread send over 2 connections to every shard
+    benchmark_specs = {"name": env.testName, "args": ['--shared-connections=2', '--pipeline=4', '--first-byte-stats']}
+    addTLSArgs(benchmark_specs, env)
+    config = get_default_memtier_config(threads=2, clients=5)
+    master_nodes_list = env.getMasterNodesList()
+    overall_expected_request_count = get_expected_request_count(config)
+
+    add_required_env_arguments(benchmark_specs, config, env, master_nodes_list)
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    master_nodes_connections = env.getOSSMasterNodesConnectionList()
+    connections_before = [conn.execute_command("INFO", "STATS")['total_connections_received']
+                          for conn in master_nodes_connections]
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+
+    merged_command_stats = {'cmdstat_set': {'calls': 0}, 'cmdstat_get': {'calls': 0}}
+    overall_request_count = agg_info_commandstats(master_nodes_connections, merged_command_stats)
+    assert_minimum_memtier_outcomes(config, env, memtier_ok, overall_expected_request_count, overall_request_count)
+
+    for conn, before in zip(master_nodes_connections, connections_before):
+        received = conn.execute_command("INFO", "STATS")['total_connections_received'] - before
+        env.assertTrue(received <= 2 * 2)
+
+    # a reply starts to arrive once the replies to the other clients before it are read
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        first_byte = results_dict['ALL STATS']['Time To First Byte']
+        for command in ['Sets', 'Gets']:
+            ttfb = first_byte['{} TTFB'.format(command)]
+            ttlb = first_byte['{} TTLB'.format(command)]
+            env.assertEqual(ttfb['Count'], ttlb['Count'])
+            env.assertTrue(ttfb['Average Latency'] <= ttlb['Average Latency'])
+
+
+def test_servers_sharding(env):
+    if env.isCluster() or env.isUnixSocket() or env.useTLS:
+        env.skip()
+
+    # two standalone servers, each answering the keys distributed to it
+    fakes = [FakeMemcached('binary'), FakeMemcached('binary')]
+    servers = ','.join('127.0.0.1:{}'.format(fake.port) for fake in fakes)
+    benchmark_specs = {"name": env.testName,
+                       "args": ['--servers={}'.format(servers), '--sharding=jump', '--protocol=memcache_binary',
+                                '--ratio=1:1', '--key-maximum=1000']}
+    config = get_default_memtier_config(threads=2, clients=2, requests=1000)
+    config["memtier_benchmark"]['explicit_connect_args'] = True
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    for fake in fakes:
+        fake.stop()
+    debugPrintMemtierOnError(config, env)
+    env.assertTrue(memtier_ok)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        env.assertEqual(results_dict['configuration']['server'], servers)
+        env.assertEqual(results_dict['configuration']['servers'], servers)
+        env.assertEqual(results_dict['configuration']['sharding'], 'jump')
+
+        # every server gets its share, as accounted in its shard stats
+        shards = results_dict['ALL STATS']['Shards']
+        for fake in fakes:
+            count = fake.counts['set'] + fake.counts['get']
+            env.assertTrue(count > 0)
+            env.assertEqual(shards['127.0.0.1:{}'.format(fake.port)]['Count'], count)
+        env.assertEqual(sum(fake.counts['set'] + fake.counts['get'] for fake in fakes), 2 * 2 * 1000)
+
+
+def test_availability_run_count(env):
+    if env.isCluster() or env.isUnixSocket() or env.useTLS:
+        env.skip()
+    # the timelines of the runs can't be averaged, but the average still
+    # reports the failed requests of all the runs
+    run_count = 2
+    server = FakeMemcached('meta', error_keys=[b'memtier-7'])
+    benchmark_specs = {"name": env.testName, "args": ['--protocol=memcache_meta', '--ratio=1:1', '--pipeline=4',
+                                                      '--multi-key-get=10', '--key-maximum=100',
+                                                      '--run-count={}'.format(run_count)]}
+    config = get_default_memtier_config(threads=2, clients=2, requests=1000)
+    config['redis_process_port'] = server.port
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() returns True if the return code of memtier_benchmark was 0
+    memtier_ok = benchmark.run()
+    server.stop()
+    env.assertTrue(memtier_ok)
+
+    failed = server.counts['failed_batches']
+    env.assertTrue(failed > 0)
+
+    json_filename = '{0}/mb.json'.format(config.results_dir)
+    with open(json_filename) as results_json:
+        results_dict = json.load(results_json)
+        average = results_dict['AGGREGATED AVERAGE RESULTS ({} runs)'.format(run_count)]
+        env.assertEqual(average['Availability']['Requests Failed'], failed // run_count)
+        env.assertTrue('Timeline' not in average['Availability'])
+
+
+def test_memcache_meta_arbitrary_command_quiet(env):
+    if env.isCluster() or env.isUnixSocket() or env.useTLS:
+        env.skip()
+    # a quiet command gets no answer when it succeeds, which would leave
+    # the pipeline waiting for it
+    server = FakeMemcached('meta')
+    benchmark_specs = {"name": env.testName, "args": ['--protocol=memcache_meta']}
+    benchmark_specs["args"].append('--command=mg __key__ v q')
+    config = get_default_memtier_config(threads=1, clients=1, requests=10)
+    config['redis_process_port'] = server.port
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() should return False for a quiet command
+    memtier_ok = benchmark.run()
+    server.stop()
+    env.assertFalse(memtier_ok)
+    env.assertEqual(server.counts['get'], 0)
+
+
+def test_servers_multi_key_command(env):
+    if env.isCluster() or env.isUnixSocket() or env.useTLS:
+        env.skip()
+    # the keys of a command may belong to different servers
+    fakes = [FakeMemcached('binary'), FakeMemcached('binary')]
+    servers = ','.join('127.0.0.1:{}'.format(fake.port) for fake in fakes)
+    benchmark_specs = {"name": env.testName, "args": ['--servers={}'.format(servers)]}
+    benchmark_specs["args"].append('--command=MSET __key__ __data__ __key__ __data__')
+    config = get_default_memtier_config(threads=1, clients=1, requests=10)
+    config["memtier_benchmark"]['explicit_connect_args'] = True
+
+    # Create a temporary directory
+    test_dir = tempfile.mkdtemp()
+    config = RunConfig(test_dir, env.testName, config, {})
+    ensure_clean_benchmark_folder(config.results_dir)
+
+    benchmark = Benchmark.from_json(config, benchmark_specs)
+
+    # benchmark.run() should return False for a multi key command
+    memtier_ok = benchmark.run()
+    for fake in fakes:
+        fake.stop()
+    env.assertFalse(memtier_ok)
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2011-2026 Redis Labs Ltd.
+ *
+ * This file is part of memtier_benchmark.
+ *
+ * memtier_benchmark is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * memtier_benchmark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with memtier_benchmark.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "thread_overhead.h"
+
+#define TIMEVAL_USEC(tv) ((unsigned long long) (tv).tv_sec * 1000000 + (tv).tv_usec)
+
+// Returns the calling thread's user/system CPU time.  Falls back to
+// process-wide usage where per-thread accounting is not available.
+static void get_thread_cpu_usec(unsigned long long *user_usec, unsigned long long *sys_usec)
+{
+    struct rusage ru;
+#ifdef RUSAGE_THREAD
+    int who = RUSAGE_THREAD;
+#else
+    int who = RUSAGE_SELF;
+#endif
+
+    if (getrusage(who, &ru) != 0) {
+        *user_usec = *sys_usec = 0;
+        return;
+    }
+    *user_usec = TIMEVAL_USEC(ru.ru_utime);
+    *sys_usec = TIMEVAL_USEC(ru.ru_stime);
+}
+
+thread_overhead_stats::thread_overhead_stats() : m_thread_id(0), m_wall_usec(0), m_user_usec(0), m_sys_usec(0)
+{
+    memset(m_phase_usec, 0, sizeof(m_phase_usec));
+}
+
+double thread_overhead_stats::cpu_utilization(void) const
+{
+    if (m_wall_usec == 0) return 0;
+    return 100.0 * (m_user_usec + m_sys_usec) / m_wall_usec;
+}
+
+unsigned long long thread_overhead_stats::idle_usec(void) const
+{
+    unsigned long long busy = m_user_usec + m_sys_usec;
+    return m_wall_usec > busy ? m_wall_usec - busy : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+thread_overhead::thread_overhead(bool phase_timing) :
+        m_phase_timing(phase_timing),
+        m_started(false),
+        m_start_user_usec(0),
+        m_start_sys_usec(0),
+        m_wall_usec(0),
+        m_user_usec(0),
+        m_sys_usec(0)
+{
+    memset(&m_start_time, 0, sizeof(m_start_time));
+    memset(&m_last_sample, 0, sizeof(m_last_sample));
+    for (int i = 0; i < overhead_phase_max; i++) {
+        m_phase_nsec[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+// Must be called from the worker thread itself, before it starts dispatching
+void thread_overhead::start(void)
+{
+    gettimeofday(&m_start_time, NULL);
+    m_last_sample = m_start_time;
+    get_thread_cpu_usec(&m_start_user_usec, &m_start_sys_usec);
+    m_started = true;
+}
+
+void thread_overhead::sample(const struct timeval *now)
+{
+    if (!m_started) return;
+    if (TIMEVAL_USEC(*now) - TIMEVAL_USEC(m_last_sample) < 1000000) return;
+
+    m_last_sample = *now;
+
+    unsigned long long user_usec, sys_usec;
+    get_thread_cpu_usec(&user_usec, &sys_usec);
+
+    m_wall_usec.store(TIMEVAL_USEC(*now) - TIMEVAL_USEC(m_start_time), std::memory_order_relaxed);
+    m_user_usec.store(user_usec - m_start_user_usec, std::memory_order_relaxed);
+    m_sys_usec.store(sys_usec - m_start_sys_usec, std::memory_order_relaxed);
+}
+
+void thread_overhead::sample_now(void)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    m_last_sample.tv_sec = 0;
+    m_last_sample.tv_usec = 0;
+    sample(&now);
+}
+
+thread_overhead_stats thread_overhead::get_stats(unsigned int thread_id) const
+{
+    thread_overhead_stats stats;
+
+    stats.m_thread_id = thread_id;
+    stats.m_wall_usec = m_wall_usec.load(std::memory_order_relaxed);
+    stats.m_user_usec = m_user_usec.load(std::memory_order_relaxed);
+    stats.m_sys_usec = m_sys_usec.load(std::memory_order_relaxed);
+    for (int i = 0; i < overhead_phase_max; i++) {
+        stats.m_phase_usec[i] = m_phase_nsec[i].load(std::memory_order_relaxed) / 1000;
+    }
+
+    return stats;
+}
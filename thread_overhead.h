@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2011-2026 Redis Labs Ltd.
+ *
+ * This file is part of memtier_benchmark.
+ *
+ * memtier_benchmark is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * memtier_benchmark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with memtier_benchmark.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THREAD_OVERHEAD_H
+#define _THREAD_OVERHEAD_H
+
+#include <sys/time.h>
+#include <time.h>
+#include <atomic>
+
+enum overhead_phase
+{
+    overhead_create_request,
+    overhead_parse_response,
+    overhead_stats_update,
+    overhead_phase_max
+};
+
+/**
+ * Snapshot of a worker thread's self-overhead, in microseconds.
+ * User and system CPU time come from getrusage(RUSAGE_THREAD); system
+ * time is the time spent inside syscalls (socket I/O, epoll).  Idle time
+ * is whatever is left of the wall clock, i.e. time blocked waiting for
+ * the server.
+ */
+struct thread_overhead_stats
+{
+    unsigned int m_thread_id;
+    unsigned long long m_wall_usec;
+    unsigned long long m_user_usec;
+    unsigned long long m_sys_usec;
+    unsigned long long m_phase_usec[overhead_phase_max];
+
+    thread_overhead_stats();
+    double cpu_utilization(void) const;
+    unsigned long long idle_usec(void) const;
+};
+
+/**
+ * Per-thread self-overhead accounting.
+ *
+ * Written only by the owning worker thread; all counters are atomics so the
+ * main thread can read them for live progress reporting.  CPU usage is
+ * sampled at most once per second from the worker's read path, plus once
+ * more when the thread's event loop exits.  Phase timing is optional since
+ * it costs two clock reads per measured call.
+ */
+class thread_overhead
+{
+public:
+    thread_overhead(bool phase_timing);
+
+    bool phase_timing(void) const { return m_phase_timing; }
+
+    void start(void);
+    void sample(const struct timeval *now);
+    void sample_now(void);
+    void add_phase(enum overhead_phase phase, unsigned long long nsec)
+    {
+        m_phase_nsec[phase].store(m_phase_nsec[phase].load(std::memory_order_relaxed) + nsec,
+                                  std::memory_order_relaxed);
+    }
+
+    thread_overhead_stats get_stats(unsigned int thread_id) const;
+
+    static unsigned long long clock_nsec(void)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+private:
+    bool m_phase_timing;
+    bool m_started;
+    struct timeval m_start_time;
+    struct timeval m_last_sample;
+    unsigned long long m_start_user_usec;
+    unsigned long long m_start_sys_usec;
+
+    std::atomic<unsigned long long> m_wall_usec;
+    std::atomic<unsigned long long> m_user_usec;
+    std::atomic<unsigned long long> m_sys_usec;
+    std::atomic<unsigned long long> m_phase_nsec[overhead_phase_max];
+};
+
+/**
+ * Scoped timer adding its lifetime to one phase of a thread_overhead.
+ * A no-op when overhead is NULL or phase timing is disabled.
+ */
+class overhead_scope
+{
+public:
+    overhead_scope(thread_overhead *overhead, enum overhead_phase phase) :
+            m_overhead(overhead != NULL && overhead->phase_timing() ? overhead : NULL),
+            m_phase(phase),
+            m_start(m_overhead != NULL ? thread_overhead::clock_nsec() : 0)
+    {
+    }
+
+    ~overhead_scope()
+    {
+        if (m_overhead != NULL) m_overhead->add_phase(m_phase, thread_overhead::clock_nsec() - m_start);
+    }
+
+private:
+    thread_overhead *m_overhead;
+    enum overhead_phase m_phase;
+    unsigned long long m_start;
+};
+
+#endif /* _THREAD_OVERHEAD_H */
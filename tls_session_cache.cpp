@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2011-2026 Redis Labs Ltd.
+ *
+ * This file is part of memtier_benchmark.
+ *
+ * memtier_benchmark is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * memtier_benchmark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with memtier_benchmark.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef USE_TLS
+
+#include "tls_session_cache.h"
+
+int tls_session_cache::s_cache_index = -1;
+int tls_session_cache::s_endpoint_index = -1;
+
+tls_session_cache::tls_session_cache() {}
+
+tls_session_cache::~tls_session_cache()
+{
+    for (std::map<std::string, SSL_SESSION *>::iterator i = m_sessions.begin(); i != m_sessions.end(); i++) {
+        SSL_SESSION_free(i->second);
+    }
+    m_sessions.clear();
+}
+
+bool tls_session_cache::setup_ctx(SSL_CTX *ctx)
+{
+    if (s_cache_index < 0) {
+        s_cache_index = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+        s_endpoint_index = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+        if (s_cache_index < 0 || s_endpoint_index < 0) return false;
+    }
+
+    // we keep the sessions ourselves, per thread; OpenSSL's internal store
+    // is only used by servers anyway and would need locking across threads
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, new_session_cb);
+
+    return true;
+}
+
+void tls_session_cache::attach(SSL *ssl, const char *endpoint)
+{
+    std::map<std::string, SSL_SESSION *>::iterator i = m_sessions.find(endpoint);
+    if (i != m_sessions.end()) {
+        SSL_set_session(ssl, i->second);
+    }
+
+    SSL_set_ex_data(ssl, s_cache_index, this);
+    SSL_set_ex_data(ssl, s_endpoint_index, (void *) endpoint);
+}
+
+int tls_session_cache::new_session_cb(SSL *ssl, SSL_SESSION *session)
+{
+    tls_session_cache *cache = (tls_session_cache *) SSL_get_ex_data(ssl, s_cache_index);
+    const char *endpoint = (const char *) SSL_get_ex_data(ssl, s_endpoint_index);
+
+    if (cache == NULL || endpoint == NULL) return 0;
+
+    cache->store(endpoint, session);
+    return 1; // we now own the reference
+}
+
+void tls_session_cache::store(const char *endpoint, SSL_SESSION *session)
+{
+    SSL_SESSION *&slot = m_sessions[endpoint];
+    if (slot != NULL) {
+        SSL_SESSION_free(slot);
+    }
+    slot = session;
+}
+
+#endif /* USE_TLS */
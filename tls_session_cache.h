@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2011-2026 Redis Labs Ltd.
+ *
+ * This file is part of memtier_benchmark.
+ *
+ * memtier_benchmark is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * memtier_benchmark is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with memtier_benchmark.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TLS_SESSION_CACHE_H
+#define _TLS_SESSION_CACHE_H
+
+#ifdef USE_TLS
+
+#include <map>
+#include <string>
+#include <openssl/ssl.h>
+
+/**
+ * Client-side TLS session cache, one per worker thread.
+ *
+ * Sessions (TLS 1.2 session IDs/tickets and TLS 1.3 tickets alike) are
+ * delivered through the SSL_CTX new-session callback and kept per server
+ * endpoint, so every connection of the thread to the same endpoint can
+ * offer the most recent one and skip the full handshake.  Only the owning
+ * worker thread touches a cache, hence no locking.
+ */
+class tls_session_cache
+{
+public:
+    tls_session_cache();
+    ~tls_session_cache();
+
+    // Enables client session caching on ctx; called once before any thread starts.
+    static bool setup_ctx(SSL_CTX *ctx);
+
+    // Offers the cached session for endpoint (if any) and registers ssl so
+    // that sessions it receives are stored back under endpoint.  endpoint
+    // must outlive ssl.
+    void attach(SSL *ssl, const char *endpoint);
+
+private:
+    static int new_session_cb(SSL *ssl, SSL_SESSION *session);
+    void store(const char *endpoint, SSL_SESSION *session);
+
+    static int s_cache_index;
+    static int s_endpoint_index;
+
+    std::map<std::string, SSL_SESSION *> m_sessions;
+};
+
+#endif /* USE_TLS */
+
+#endif /* _TLS_SESSION_CACHE_H */